@@ -0,0 +1,18 @@
+TEMPLATE = app
+CONFIG += c++11
+CONFIG -= app_bundle
+CONFIG += release
+QT += testlib
+
+QMAKE_CXXFLAGS += -std=c++11
+QMAKE_CXXFLAGS += -Wpedantic
+QMAKE_CXXFLAGS += -fno-rtti
+
+include($$PWD/src/src.pri)
+include($$PWD/benchmarks/benchmarks.pri)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+
+HEADERS += \
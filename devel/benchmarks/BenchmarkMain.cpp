@@ -0,0 +1,14 @@
+// Benchmark program, see tools/runBenchmarks.py for running it on all compilers
+
+#include "InstanceBenchmark.h"
+
+#include <QCoreApplication>
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    InstanceBenchmark tc;
+    return QTest::qExec(&tc, argc, argv);
+}
@@ -0,0 +1,137 @@
+#include "InstanceBenchmark.h"
+#include <src/globalInstances.h>
+
+namespace {
+
+struct A{
+    int value = 0;
+    int foo(){ return ++value; }
+};
+
+struct Unregistered{};
+
+A rawInstance;
+A* rawPointer = &rawInstance;
+
+A& meyersSingleton(){
+    static A a;
+    return a;
+}
+
+//keeps the compiler from hoisting loads out of the benchmark loop
+inline void clobberMemory(){ asm volatile("" : : : "memory"); }
+
+template<typename T>
+inline void use(T const& t){ asm volatile("" : : "r"(&t) : "memory"); }
+
+//operations per QBENCHMARK iteration so its own loop and bookkeeping do not hide the measured
+//operation, runBenchmarks.py divides the results by it
+constexpr int operationsPerIteration = 1000;
+
+template<typename Operation>
+inline void repeat(Operation op){ for(int i = 0; i<operationsPerIteration; ++i) op(); }
+
+}
+
+InstanceBenchmark::InstanceBenchmark(QObject *parent) : QObject(parent)
+{
+
+}
+
+void InstanceBenchmark::accessRawPointer()
+{
+    QBENCHMARK { repeat([]{ use(rawPointer->foo()); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::accessMeyersSingleton()
+{
+    QBENCHMARK { repeat([]{ use(meyersSingleton().foo()); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::accessInstance()
+{
+    global::Instance<A> a;
+    QBENCHMARK { repeat([]{ use(global::instance<A>()->foo()); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::refRawPointer()
+{
+    QBENCHMARK { repeat([]{ use(*rawPointer); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::refMeyersSingleton()
+{
+    QBENCHMARK { repeat([]{ use(meyersSingleton()); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::refInstance()
+{
+    global::Instance<A> a;
+    QBENCHMARK { repeat([]{ use(global::instanceRef<A>()); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::checkRawPointer()
+{
+    QBENCHMARK { repeat([]{ use(rawPointer!=nullptr); clobberMemory(); }); }
+}
+
+//a meyers singleton is always available, so checking it is just taking it including the guard check
+void InstanceBenchmark::checkMeyersSingleton()
+{
+    QBENCHMARK { repeat([]{ use(&meyersSingleton()!=nullptr); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::checkInstance()
+{
+    global::Instance<A> a;
+    QBENCHMARK { repeat([]{ use(static_cast<bool>(global::instance<A>())); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::ifAvailableRawPointer()
+{
+    QBENCHMARK { repeat([]{ if (rawPointer!=nullptr) use(rawPointer->foo()); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::ifAvailableMeyersSingleton()
+{
+    QBENCHMARK { repeat([]{ use(meyersSingleton().foo()); clobberMemory(); }); }
+}
+
+void InstanceBenchmark::ifAvailableInstanceAvailable()
+{
+    global::Instance<A> a;
+    QBENCHMARK { repeat([]{ global::instance<A>().ifAvailable([](A& r){ use(r.foo()); }); clobberMemory(); }); }
+}
+
+//one operation queues 4 calls and runs them by registering and deregistering the instance,
+//a meyers singleton has no equivalent since it is constructed by the access
+void InstanceBenchmark::ifAvailableInstanceUnavailable()
+{
+    Unregistered u;
+    QBENCHMARK {
+        repeat([&]{
+            for (int i = 0; i<4; ++i) global::instance<Unregistered>().ifAvailable([](Unregistered& r){ use(r); });
+            global::detail::ReplacingInstanceRegistration<Unregistered> reg(&u);
+        });
+    }
+}
+
+void InstanceBenchmark::replaceRawPointer()
+{
+    QBENCHMARK {
+        repeat([]{
+            A mock;
+            A* replaced = rawPointer;
+            rawPointer = &mock;
+            clobberMemory();
+            rawPointer = replaced;
+        });
+    }
+}
+
+//a meyers singleton cannot be replaced, so there is no baseline for it
+void InstanceBenchmark::replaceTestInstance()
+{
+    global::Instance<A> a;
+    QBENCHMARK { repeat([]{ global::TestInstance<A> mock; use(mock); }); }
+}
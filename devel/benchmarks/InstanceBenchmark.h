@@ -0,0 +1,39 @@
+#ifndef INSTANCEBENCHMARK_H
+#define INSTANCEBENCHMARK_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class InstanceBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InstanceBenchmark(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void accessRawPointer();
+    void accessMeyersSingleton();
+    void accessInstance();
+
+    void refRawPointer();
+    void refMeyersSingleton();
+    void refInstance();
+
+    void checkRawPointer();
+    void checkMeyersSingleton();
+    void checkInstance();
+
+    void ifAvailableRawPointer();
+    void ifAvailableMeyersSingleton();
+    void ifAvailableInstanceAvailable();
+    void ifAvailableInstanceUnavailable();
+
+    void replaceRawPointer();
+    void replaceTestInstance();
+
+};
+
+#endif // INSTANCEBENCHMARK_H
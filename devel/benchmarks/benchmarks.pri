@@ -0,0 +1,7 @@
+
+HEADERS += \
+    $$PWD/InstanceBenchmark.h
+
+SOURCES += \
+    $$PWD/BenchmarkMain.cpp \
+    $$PWD/InstanceBenchmark.cpp
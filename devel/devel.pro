@@ -1,10 +1,15 @@
 TEMPLATE = app
-CONFIG += c++11
 CONFIG -= app_bundle
 QT += testlib
 CONFIG += testcase
 
-QMAKE_CXXFLAGS += -std=c++11
+#the standard and additional macros can be set on the command line, e.g.
+#'qmake CXX_STD=c++20' builds the coroutine tests and
+#'qmake GLOBAL_DEFINES=GLOBAL_TRACE' enables the tests of that configuration
+isEmpty(CXX_STD): CXX_STD = c++11
+equals(CXX_STD, c++11): CONFIG += c++11
+QMAKE_CXXFLAGS += -std=$$CXX_STD
+DEFINES += $$GLOBAL_DEFINES
 QMAKE_CXXFLAGS += -Wpedantic
 QMAKE_CXXFLAGS += -fno-rtti
 #QMAKE_CXXFLAGS += -fno-exceptions
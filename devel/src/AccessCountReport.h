@@ -0,0 +1,63 @@
+#pragma once
+
+#include "AccessCounters.h"
+#include "InstanceRegistry.h"
+#include "ThreadRecords.h"
+#include "TypeName.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace global {
+
+
+struct AccessCount{
+    TypeName name;
+    std::size_t id;
+    std::uint64_t accesses;
+    std::uint64_t nullAccesses;
+};
+
+
+namespace detail {
+
+#ifdef GLOBAL_COUNT_ACCESSES
+
+inline AccessCount accessCount(InstanceType const& t){
+    AccessCount c{t.name(),t.id(),0,0};
+    for(AccessCounterShard* s = ThreadRecords<AccessCounterShard>::first(); s!=nullptr; s = s->next) {
+        std::atomic<std::uint64_t> const* accesses = s->accesses.find(c.id);
+        std::atomic<std::uint64_t> const* nullAccesses = s->nullAccesses.find(c.id);
+        if (accesses!=nullptr) c.accesses += accesses->load(std::memory_order_relaxed);
+        if (nullAccesses!=nullptr) c.nullAccesses += nullAccesses->load(std::memory_order_relaxed);
+    }
+    return c;
+}
+
+#endif // GLOBAL_COUNT_ACCESSES
+
+}
+
+
+//totals over all threads of each type accessed by instance<T>(), most accessed first,
+//empty if GLOBAL_COUNT_ACCESSES is not defined
+inline std::vector<AccessCount> accessCounts(){
+    std::vector<AccessCount> counts;
+#ifdef GLOBAL_COUNT_ACCESSES
+    forEachInstanceType([&counts](InstanceType const& t){ counts.push_back(detail::accessCount(t)); });
+    std::stable_sort(counts.begin(),counts.end(),[](AccessCount const& a, AccessCount const& b){ return a.accesses>b.accesses; });
+#endif
+    return counts;
+}
+
+//writes one line "<accesses> <null accesses> <type name>" per type, most accessed first
+template<typename Stream>
+void writeAccessCounts(Stream& out){
+    for(auto const& c:accessCounts()) out << c.accesses << ' ' << c.nullAccesses << ' ' << c.name.str() << '\n';
+}
+
+
+
+} //global
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "InstanceRegistry.h"
+#include "ThreadRecords.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//define GLOBAL_COUNT_ACCESSES for the whole program to count the accesses of each type
+//by operator-> and operator*, otherwise the counting compiles to nothing
+
+namespace global {
+namespace detail {
+
+#ifdef GLOBAL_COUNT_ACCESSES
+
+//counters of one thread indexed by type id, only written by their thread
+struct alignas(64) AccessCounterShard {
+    TypeIdTable<std::atomic<std::uint64_t>> accesses;
+    TypeIdTable<std::atomic<std::uint64_t>> nullAccesses;
+    std::atomic<bool> used{true};
+    AccessCounterShard* next = nullptr;
+};
+
+//no read-modify-write is needed since there is a single writer
+inline void incrementCounter(std::atomic<std::uint64_t>& c){ c.store(c.load(std::memory_order_relaxed)+1,std::memory_order_relaxed); }
+
+template<typename T>
+void countAccess(bool isNull){
+    AccessCounterShard& shard = ThreadRecords<AccessCounterShard>::local();
+    const std::size_t id = typeId<T>();
+    incrementCounter(shard.accesses.at(id));
+    if (isNull) incrementCounter(shard.nullAccesses.at(id));
+}
+
+#else
+
+template<typename T>
+void countAccess(bool){}
+
+#endif // GLOBAL_COUNT_ACCESSES
+
+}
+} //global
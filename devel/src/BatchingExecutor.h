@@ -0,0 +1,53 @@
+#pragma once
+
+#include "SmallFunction.h"
+#include "Executor.h"
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace global {
+
+
+//collects the calls until run() is called, e.g. by an event loop
+class BatchingExecutor {
+
+public:
+
+    BatchingExecutor(){}
+
+    template<typename F>
+    void execute(F&& f){
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace_back(bindTestContext(std::forward<F>(f)));
+    }
+
+    //calls the collected calls on the calling thread, returns their number
+    std::size_t run(){
+        std::vector<Task> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batch.swap(tasks);
+        }
+        for(auto& t:batch) t();
+        return batch.size();
+    }
+
+    std::size_t pending(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return tasks.size();
+    }
+
+private:
+
+    BatchingExecutor(BatchingExecutor const&) = delete;
+    BatchingExecutor& operator=(BatchingExecutor const&) = delete;
+
+    using Task = detail::SmallFunction<void()>;
+
+    std::mutex mutex;
+    std::vector<Task> tasks;
+};
+
+} //global
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "TestContext.h"
+#include <type_traits>
+#include <utility>
+
+namespace global {
+
+//an executor is any type with a member execute(f) which calls f() eventually, e.g. global::ThreadPool
+
+//calls f() directly on the calling thread
+struct InlineExecutor{
+    template<typename F>
+    void execute(F&& f){ f(); }
+};
+
+
+#ifdef GLOBAL_TEST_CONTEXTS
+
+namespace detail {
+
+template<typename Func>
+class BoundToTestContext {
+
+public:
+
+    BoundToTestContext(Func f, TestContext* c):func(std::move(f)),context(c){}
+
+    void operator()(){
+        TestContextBinding binding(context);
+        func();
+    }
+
+private:
+
+    Func func;
+    TestContext* context;
+};
+
+}
+
+//binds f() to the test context of the calling thread, so it sees the same overrides on whatever thread
+//it is called, ThreadPool and BatchingExecutor bind the calls they execute by themselves
+template<typename Func>
+detail::BoundToTestContext<typename std::decay<Func>::type> bindTestContext(Func&& f){
+    return {std::forward<Func>(f),TestContext::current()};
+}
+
+#else
+
+template<typename Func>
+typename std::decay<Func>::type bindTestContext(Func&& f){ return std::forward<Func>(f); }
+
+#endif // GLOBAL_TEST_CONTEXTS
+
+} //global
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "InstancePointer.h"
+#include "InstanceRegistry.h"
+#include "SpinLock.h"
+#include "staticValue.h"
+#include "throwImpl.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <thread>
+
+namespace global {
+
+
+class InstanceMissingOnFreeze : public std::exception {};
+class RegistrationWhileFrozen : public std::exception {};
+
+
+namespace detail {
+
+//frozenFlag() is kept with the instance pointer, which reads it
+struct FrozenState{
+    constexpr FrozenState():freezing(false),changing(0){}
+    std::atomic<bool> freezing; //set by freeze() while it checks the registrations
+    std::atomic<std::size_t> changing; //(de)registrations in progress which found neither flag set
+    SpinLock lock; //held by freeze() and by (de)registrations only while a flag is set
+};
+
+inline FrozenState& frozenState(){ return constantStaticValue<FrozenState>(); }
+
+//spans a (de)registration, so no change completes after freeze() succeeded; unless a freeze is in
+//progress or active this only counts the change, so registrations of different types do not
+//wait for each other
+class FreezeCheck {
+
+public:
+
+    //throws RegistrationWhileFrozen if frozen, destructing registrations only report it since
+    //destructors cannot throw
+    explicit FreezeCheck(bool destructing):locked(false),report(false){
+        FrozenState& s = frozenState();
+        s.changing.fetch_add(1,std::memory_order_seq_cst); //pairs with the flags set by freeze()
+        if (!frozenFlag().load(std::memory_order_seq_cst) && !s.freezing.load(std::memory_order_seq_cst)) return;
+        s.changing.fetch_sub(1,std::memory_order_release);
+
+        s.lock.lock(); //waits for a freeze in progress
+        if (!isFrozen()) { locked = true; return; }
+        if (!destructing) {
+            s.lock.unlock();
+            throwImpl(RegistrationWhileFrozen{});
+        }
+        locked = true;
+        report = true;
+    }
+
+    ~FreezeCheck(){
+        if (locked) frozenState().lock.unlock();
+        else frozenState().changing.fetch_sub(1,std::memory_order_release);
+    }
+
+    //true if the change is to be reported by onDeregistrationWhileFrozen()
+    bool changeWhileFrozen() const{ return report; }
+
+private:
+
+    FreezeCheck(FreezeCheck const&) = delete;
+    FreezeCheck& operator=(FreezeCheck const&) = delete;
+
+    bool locked;
+    bool report;
+};
+
+}
+
+
+//called instead of throwing RegistrationWhileFrozen if a registration of T is destructed
+//while frozen, the instance is deregistered anyway
+template<typename T>
+void onDeregistrationWhileFrozen(){ assert(!"registration destructed while frozen, call thaw() before"); }
+
+//override by spcializing
+//template<> void onDeregistrationWhileFrozen<A>(){ exit(1); }
+
+
+namespace detail {
+
+//freezes if complete() holds once no (de)registration is in progress
+inline void freezeIf(bool (*complete)()){
+    FrozenState& s = frozenState();
+    SpinLockGuard guard(s.lock); //(de)registrations starting from now on wait for the outcome
+    s.freezing.store(true,std::memory_order_seq_cst);
+    while (s.changing.load(std::memory_order_seq_cst)!=0) std::this_thread::yield(); //the ones started before
+
+    const bool registered = complete();
+    if (registered) frozenFlag().store(true,std::memory_order_release); //before freezing is cleared
+    s.freezing.store(false,std::memory_order_release);
+    if (!registered) throwImpl(InstanceMissingOnFreeze{});
+}
+
+}
+
+
+//declares the registrations complete, expects an instance to be registered for all types accessed
+//by instance<T>() except lazy and thread local ones, afterwards (de)registering is an error until
+//thaw() is called
+inline void freeze(){ detail::freezeIf(&allInstancesRegistered); }
+
+//like freeze(), but only expects instances of Ts to be registered
+template<typename... Ts>
+void freeze(){ detail::freezeIf(&instancesRegistered<Ts...>); }
+
+//allows registrations again, e.g. before shutdown
+inline void thaw(){ detail::frozenFlag().store(false,std::memory_order_release); }
+
+inline bool frozen(){ return detail::isFrozen(); }
+
+
+} //global
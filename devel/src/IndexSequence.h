@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+namespace global {
+namespace detail {
+
+//std::index_sequence is not available in c++11
+template<std::size_t...>
+struct IndexSequence{};
+
+template<std::size_t N, std::size_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N-1, N-1, I...>{};
+
+template<std::size_t... I>
+struct MakeIndexSequence<0, I...>{ using type = IndexSequence<I...>; };
+
+}
+} //global
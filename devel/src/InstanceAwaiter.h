@@ -0,0 +1,95 @@
+#pragma once
+
+#include "coroutinesAvailableDetection.h"
+#include "Executor.h"
+
+#ifdef COROUTINES_AVAILABLE
+#include <coroutine>
+#endif
+
+namespace global {
+namespace detail {
+
+#ifdef COROUTINES_AVAILABLE
+
+template<typename T>
+class InstancePointer;
+
+template<typename T>
+class InstanceSlot;
+
+
+//co_await instance<T>().available() suspends until an instance is registered and returns it,
+//the coroutine is resumed by the executor, by default on the registering thread
+template<typename T, typename Executor>
+class AvailableAwaiter {
+
+public:
+
+    AvailableAwaiter(InstancePointer<T>& p, Executor& e):pointer(p),executor(e){}
+
+    bool await_ready(){
+        t = pointer.get();
+        return t!=nullptr;
+    }
+
+    //does not suspend if the instance was registered meanwhile; once queued, Resume may already
+    //run on another thread and destroy the frame, so t must not be written here afterwards
+    bool await_suspend(std::coroutine_handle<> h){
+        Resume resume{this,h};
+        T* available = InstanceSlot<T>::availableOrQueue(resume);
+        if (available==nullptr) return true;
+        t = available;
+        return false;
+    }
+
+    T& await_resume(){ return *t; }
+
+private:
+
+    //small enough to be queued without allocation
+    struct Resume{
+        AvailableAwaiter* awaiter;
+        std::coroutine_handle<> handle;
+
+        void operator()(T& t){
+            awaiter->t = &t;
+            std::coroutine_handle<> h = handle;
+            awaiter->executor.execute([h]{ h.resume(); });
+        }
+    };
+
+    InstancePointer<T>& pointer;
+    Executor& executor;
+    T* t = nullptr;
+};
+
+
+//co_await instance<T>().unavailable() suspends until the instance is deregistered,
+//the coroutine is resumed by the executor, by default on the deregistering thread
+template<typename T, typename Executor>
+class UnavailableAwaiter {
+
+public:
+
+    UnavailableAwaiter(InstancePointer<T>& p, Executor& e):pointer(p),executor(e){}
+
+    bool await_ready(){ return false; }
+
+    void await_suspend(std::coroutine_handle<> h){
+        Executor& e = executor;
+        pointer.becomesUnavailable([&e,h](T&){ e.execute([h]{ h.resume(); }); });
+    }
+
+    void await_resume(){}
+
+private:
+
+    InstancePointer<T>& pointer;
+    Executor& executor;
+};
+
+#endif // COROUTINES_AVAILABLE
+
+}
+} //global
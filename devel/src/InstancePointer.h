@@ -1,66 +1,223 @@
 #pragma once
 
+#include "AccessCounters.h"
+#include "coroutinesAvailableDetection.h"
+#include "InstanceRegistry.h"
+#include "LazyAccess.h"
 #include "NullptrAccessHandler.h"
-#include <functional>
-#include <list>
+#include "SpinLock.h"
+#include "staticValue.h"
+#include "PerCpuAccess.h"
+#include "TestContext.h"
+#include "ThreadLocalAccess.h"
+#include "throwImpl.h"
+#include <atomic>
+#include <exception>
+#include <type_traits>
+
+//keeps rarely taken paths out of the accessing functions
+#ifdef __GNUC__
+#define GLOBAL_COLD __attribute__((noinline,cold))
+#else
+#define GLOBAL_COLD
+#endif
 
 namespace global {
+
+class RegistryNotFrozen : public std::exception {};
+
+template<typename T>
+class Pinned;
+
+struct InlineExecutor;
+
+template<typename, typename>
+class LazyInstance;
+
 namespace detail {
 
+class InstanceRegistry;
+
+//registrations, deferred calls and pins of instance<T>(), defined by globalInstances.h only
+template<typename T>
+class InstanceSlot;
+
+template<typename Func, typename... Ts>
+class WhenAll;
+
+#ifdef COROUTINES_AVAILABLE
+template<typename, typename>
+class AvailableAwaiter;
+
+template<typename, typename>
+class UnavailableAwaiter;
+#endif
+
+//set by freeze(), kept apart from the other freeze state since unchecked() reads it
+struct FrozenFlag{
+    constexpr FrozenFlag():value(false){}
+    std::atomic<bool> value;
+};
+
+inline std::atomic<bool>& frozenFlag(){ return constantStaticValue<FrozenFlag>().value; }
+
+inline bool isFrozen(){ return frozenFlag().load(std::memory_order_acquire); }
+
 
 template<typename T>
 class InstancePointer {
 
 public:
 
-    explicit InstancePointer(){}
+    constexpr explicit InstancePointer():instancePtr(nullptr){}
 
-    operator bool() const{ return instancePtr!=nullptr; }
+    operator bool() const{ return get()!=nullptr; }
 
-    bool operator==(T const* t) const{  return instancePtr==t;}
-    bool operator!=(T const* t) const{  return instancePtr!=t;}
+    bool operator==(T const* t) const{  return get()==t;}
+    bool operator!=(T const* t) const{  return get()!=t;}
 
     explicit operator T*() const{  return operator ->(); }
 
-    T& operator*() const& { return *instancePtr;}
-    T* operator->() const{ if (instancePtr==nullptr) global::onNullPtrAccess<>(); return instancePtr; }
+    T& operator*() const& { T* t = get(); if (t==nullptr) t = constructLazily(LazyAccess<T>{}); countAccess<T>(t==nullptr); return *t;}
+    T* operator->() const{
+        T* t = get();
+        if (t==nullptr) t = constructLazily(LazyAccess<T>{});
+        countAccess<T>(t==nullptr);
+        if (t==nullptr) global::onNullPtrAccess<>();
+        return t;
+    }
 
-    template<typename Func >
-    void ifAvailable(Func func){
-        if (instancePtr!=nullptr) { func(*instancePtr); return; }
-        ifAvailableOps.emplace_back(func);
+    //the returned guard keeps the instance from being deregistered until it is destructed, pinning
+    //and unpinning only write to memory of the calling thread; does not construct lazy instances
+    Pinned<T> pin() const{ return InstanceSlot<T>::pin(); }
+
+    //for hot paths after freeze(), the instance is not checked if NDEBUG is defined
+    T& unchecked() const{
+#ifdef NDEBUG
+        return *get();
+#else
+        if (!isFrozen()) throwImpl(RegistryNotFrozen{});
+        return *operator->();
+#endif
     }
 
     template<typename Func >
-    void becomesUnavailable(Func func){
-        becomesUnavailableOps.emplace_back(func); //never directly
-    }
+    void ifAvailable(Func func){ InstanceSlot<T>::ifAvailable(static_cast<Func&&>(func)); }
+
+    template<typename Func >
+    void becomesUnavailable(Func func){ InstanceSlot<T>::becomesUnavailable(static_cast<Func&&>(func)); }
+
+    //func is passed to executor.execute(), it is skipped if no instance
+    //is registered anymore when the executor runs it
+    template<typename Executor, typename Func >
+    void ifAvailable(Executor& executor, Func func){ InstanceSlot<T>::ifAvailable(executor,static_cast<Func&&>(func)); }
+
+    //func is passed to executor.execute(), the deregistration waits until it is finished and calls
+    //it itself if the executor has not started it yet
+    template<typename Executor, typename Func >
+    void becomesUnavailable(Executor& executor, Func func){ InstanceSlot<T>::becomesUnavailable(executor,static_cast<Func&&>(func)); }
+
+#ifdef COROUTINES_AVAILABLE
+
+    AvailableAwaiter<T,InlineExecutor> available(){ return available(InstanceSlot<T>::inlineExecutor()); }
+
+    template<typename Executor>
+    AvailableAwaiter<T,Executor> available(Executor& e){ return {*this,e}; }
+
+    UnavailableAwaiter<T,InlineExecutor> unavailable(){ return unavailable(InstanceSlot<T>::inlineExecutor()); }
+
+    template<typename Executor>
+    UnavailableAwaiter<T,Executor> unavailable(Executor& e){ return {*this,e}; }
+
+#endif // COROUTINES_AVAILABLE
 
 private:
 
-    InstancePointer& operator=(T* t){
-        if (instancePtr == t) return *this; //nothing changed
-        auto before = instancePtr;
-        instancePtr = t;
+#ifdef GLOBAL_TEST_CONTEXTS
+    //an override of the test context bound to the calling thread comes first
+    T* get() const{
+        void* o = testContextOverride(typeId<T>());
+        if (o!=nullptr) return o!=noInstanceOverride() ? static_cast<T*>(o) : nullptr;
+        return get(ThreadLocalAccess<T>{});
+    }
+#else
+    T* get() const{ return get(ThreadLocalAccess<T>{}); }
+#endif
+
+    T* get(std::false_type /*thread local*/) const{ return local(static_cast<T*>(instancePtr.load(std::memory_order_acquire))); }
+
+    //touches only thread local memory if a thread local instance is registered
+    T* get(std::true_type /*thread local*/) const{
+        T* t = ThreadLocalPointer<T>::value;
+        return t!=nullptr ? t : get(std::false_type{});
+    }
 
-        if (instancePtr!=nullptr) { for(auto const& op:ifAvailableOps) op(*instancePtr); ifAvailableOps.clear();}
-        if (before!=nullptr && instancePtr==nullptr ) { for(auto const& op:becomesUnavailableOps) op(*before); becomesUnavailableOps.clear(); }
-        return *this;
+    //the replica of the calling cpu if T is replicated per cpu, otherwise t
+    static T* local(T* t){ return local(t,PerCpuAccess<T>{}); }
+    static T* local(T* t, std::false_type /*per cpu*/){ return t; }
+    static T* local(T* t, std::true_type /*per cpu*/){ return t!=nullptr ? localReplica(t) : nullptr; }
+
+    //folded away, so the null branch of types without lazy access is unchanged
+    static T* constructLazily(std::false_type /*lazy*/){ return nullptr; }
+
+    //only called if no instance is registered, returns the lazily constructed one if a LazyInstance
+    //is declared; kept out of line since it runs at most a few times
+    GLOBAL_COLD T* constructLazily(std::true_type /*lazy*/) const{
+        LazySlot& l = lazySlot();
+        LazyConstructor lazy;
+        {
+            SpinLockGuard guard(l.lock);
+            lazy = l.constructor;
+            if (lazy.construct==nullptr) return nullptr;
+            l.constructing.fetch_add(1,std::memory_order_relaxed); //keeps the owner alive, see ~LazyInstance
+        }
+        struct Finished{
+            std::atomic<unsigned>& constructing;
+            ~Finished(){ constructing.fetch_sub(1,std::memory_order_release); }
+        } finished{l.constructing};
+        return lazy.construct(lazy.owner);
     }
 
+    friend class InstanceSlot<T>;
+
+    template<typename, typename>
+    friend class ::global::LazyInstance;
+
+    friend class InstanceRegistry;
+
+    template<typename Func, typename... Ts>
+    friend class WhenAll;
+
     template<typename>
-    friend class ReplacingInstanceRegistration;
+    friend struct PerCpuReplicas;
+
+#ifdef COROUTINES_AVAILABLE
+    template<typename, typename>
+    friend class AvailableAwaiter;
+#endif
 
     using ClassType = InstancePointer<T>;
 
     InstancePointer(ClassType const&) = delete;
     ClassType const& operator=(ClassType const&) = delete;
 
-    using DeferredOperation = std::list<std::function<void(T&)>>;
-    DeferredOperation ifAvailableOps;
-    DeferredOperation becomesUnavailableOps;
+    struct LazyConstructor{
+        T* (*construct)(void* owner);
+        void* owner;
+    };
+
+    //constant-initialized so the inlined null path of operator-> needs no guard
+    struct LazySlot{
+        constexpr LazySlot():constructor{nullptr,nullptr},constructing(0){}
+        LazyConstructor constructor;
+        std::atomic<unsigned> constructing; //number of calls of constructor.construct in progress
+        SpinLock lock;
+    };
+
+    static LazySlot& lazySlot(){ return constantStaticValue<LazySlot>(); }
 
-    T* instancePtr = nullptr;
+    //type erased so the registry can check all slots without knowing their types
+    std::atomic<void*> instancePtr;
 };
 
 
@@ -1,8 +1,12 @@
 #pragma once
 
-#include "OptionalValue.h"
 #include "instance.h"
+#include "InstanceSlot.h"
+#include "PerCpuAccess.h"
+#include "staticValue.h"
+#include "TestContext.h"
 #include "throwImpl.h"
+#include "Trace.h"
 #include <utility>
 
 namespace global {
@@ -15,80 +19,166 @@ class RegisteringNullNotAllowed: public std::exception {};
 
 namespace detail {
 
-//replaces existing for the time it exised
-template<typename T>
-class ReplacingInstanceRegistration {
+//the registered instance is replaced for the lifetime of the registration
+struct ReplaceExisting{};
+
+//expects nullptr to be registered beforehand
+//expects registration-target not to be null
+struct RejectExisting{};
+
+
+//selects the behaviour by Policy at compile time, so it needs no vtable
+//and stores only its link in the stack of active registrations
+template<typename T, typename Policy>
+class BasicInstanceRegistration {
 
 public:
 
-    ReplacingInstanceRegistration(){}
-    ReplacingInstanceRegistration(T* t){registerInstance(t);}
+    BasicInstanceRegistration(){}
+    BasicInstanceRegistration(T* t){registerInstance(t);}
     void operator()(T* t){registerInstance(t);}
-    virtual ~ReplacingInstanceRegistration(){deregisterInstance();}
+    ~BasicInstanceRegistration(){deregisterInstance(true);}
+
+    void registerInstance(T* t){ registerInstance(t,Policy{}); }
 
-    virtual void registerInstance(T* t){
+    //like registerInstance() but returns false instead of throwing if another instance is registered
+    bool tryRegisterInstance(T* t){ return tryRegisterInstance(t,Policy{}); }
+
+    //destructing reports deregistering while frozen by onDeregistrationWhileFrozen() instead of throwing
+    void deregisterInstance(bool destructing = false){
+        if (!link.active()) return; //noting to do
+        TraceSpan<T> span("deregister");
+        InstanceSlot<T>::endRegistration(link,destructing); //possibly registers again
+    }
+
+private:
+
+    void registerInstance(T* t, ReplaceExisting){
         deregisterInstance();
-        replacedInstance = instance<T>().instancePtr;
-        instance<T>() = t; //possibly deregisters again
+        TraceSpan<T> span("register");
+        InstanceSlot<T>::beginRegistration(link,t); //possibly deregisters again
     }
 
-    virtual void deregisterInstance(){
-        if (replacedInstance.has_value()==false) return; //noting to do
-        T *tmp = static_cast<T*>(replacedInstance);
-        replacedInstance.reset();
-        instance<T>() = tmp; //possibly registers again
+    //registers t only if no other instance is registered, in one step
+    void registerInstance(T* t, RejectExisting){
+        if (!tryRegisterInstance(t,RejectExisting{})) throwImpl(InstanceReplacementNotAllowed{});
     }
 
-private:
+    bool tryRegisterInstance(T* t, RejectExisting){
+        TraceSpan<T> span("register");
+        if (t==nullptr) throwImpl(RegisteringNullNotAllowed{});
+        if (link.active()) throwImpl(InstanceReplacementNotAllowed{});
+        return InstanceSlot<T>::beginRegistrationIfUnset(link,t);
+    }
 
-    ReplacingInstanceRegistration(ReplacingInstanceRegistration const&) = delete; //no copy
+    BasicInstanceRegistration(BasicInstanceRegistration const&) = delete; //no copy
 
-    detail::optional<T*> replacedInstance;
+    RegistrationLink link;
 
 };
 
 
+template<typename T>
+using ReplacingInstanceRegistration = BasicInstanceRegistration<T, ReplaceExisting>;
 
+template<typename T>
+using InstanceRegistration = BasicInstanceRegistration<T, RejectExisting>;
 
 
+//replaces existing for the registering thread only, expects
+//to be destructed on the same thread
+template<typename T>
+class ThreadLocalInstanceRegistration {
 
+    static_assert(ThreadLocalAccess<T>::value, "thread local instances need to be allowed by specializing global::ThreadLocalAccess<T>");
 
-//expects nullptr to be registered beforehand
-//expects registration-target not to be null
-template<typename T>
-class InstanceRegistration : ReplacingInstanceRegistration<T> {
 public:
 
-    using Superclass = ReplacingInstanceRegistration<T>;
-    using Superclass::operator();
+    ThreadLocalInstanceRegistration(){}
+    ThreadLocalInstanceRegistration(T* t){registerInstance(t);}
+    void operator()(T* t){registerInstance(t);}
+    ~ThreadLocalInstanceRegistration(){deregisterInstance();}
 
-    InstanceRegistration(): Superclass(){}
-    InstanceRegistration(T* t): Superclass(){registerInstance(t);}
+    void registerInstance(T* t){
+        deregisterInstance();
+        replacedInstance = ThreadLocalPointer<T>::value;
+        ThreadLocalPointer<T>::value = t;
+    }
 
-    void registerInstance(T* t) override{
+    void deregisterInstance(){
+        if (replacedInstance==unregistered()) return; //noting to do
+        ThreadLocalPointer<T>::value = static_cast<T*>(replacedInstance);
+        replacedInstance = unregistered();
+    }
 
-        if (instance<T>()!=nullptr) throwImpl(InstanceReplacementNotAllowed{});
-        if (t==nullptr) throwImpl(RegisteringNullNotAllowed{});
+private:
+
+    ThreadLocalInstanceRegistration(ThreadLocalInstanceRegistration const&) = delete; //no copy
+
+    void* replacedInstance = unregistered();
+
+};
+
+
+#ifdef GLOBAL_TEST_CONTEXTS
+
+//replaces existing only within the test context bound to the registering thread, replaces
+//existing for all threads if none is bound, expects to be destructed on the same thread
+//as the context; deferred calls are not triggered by overrides
+template<typename T>
+class TestContextRegistration {
+
+public:
+
+    TestContextRegistration(){}
+    TestContextRegistration(T* t){registerInstance(t);}
+    void operator()(T* t){registerInstance(t);}
+    ~TestContextRegistration(){deregisterInstance(true);}
 
-        Superclass::registerInstance(t);
+    void registerInstance(T* t){
+        deregisterInstance();
+        context = TestContext::current();
+        if (context==nullptr) { processWide.registerInstance(t); return; }
+        TraceSpan<T> span("register");
+        replacedOverride = context->exchange(typeId<T>(),t!=nullptr ? static_cast<void*>(t) : noInstanceOverride());
+    }
+
+    void deregisterInstance(bool destructing = false){
+        if (context==nullptr) { processWide.deregisterInstance(destructing); return; }
+        TraceSpan<T> span("deregister");
+        context->exchange(typeId<T>(),replacedOverride);
+        context = nullptr;
     }
 
+private:
+
+    TestContextRegistration(TestContextRegistration const&) = delete; //no copy
+
+    TestContext* context = nullptr;
+    void* replacedOverride = nullptr;
+    ReplacingInstanceRegistration<T> processWide;
 
 };
 
+#endif // GLOBAL_TEST_CONTEXTS
+
 
 template<
     template<typename> class RegistrationType,
     typename AccessType,
     typename InstanceType>
-class RegisterdInstanceT {
+class RegisterdInstanceT : InstanceTrace<AccessType> {
+
+    static_assert(!PerCpuAccess<AccessType>::value, "per cpu instances have to be registered by global::PerCpuInstance<T>");
 
     InstanceType t;
     RegistrationType<AccessType> reg;
 
 public:
     template<typename... Args>
-    RegisterdInstanceT(Args&&... args):t(std::forward<Args>(args)...),reg(&t){}
+    RegisterdInstanceT(Args&&... args):t(std::forward<Args>(args)...),reg(this->constructed(&t)){}
+
+    ~RegisterdInstanceT(){ this->destructing(); }
 
 };
 
@@ -97,11 +187,20 @@ public:
 template<typename AccessType, typename InstanceType = AccessType>
 using Instance = detail::RegisterdInstanceT<detail::InstanceRegistration, AccessType, InstanceType>;
 
+#ifdef GLOBAL_TEST_CONTEXTS
+template<typename AccessType, typename InstanceType = AccessType>
+using TestInstance = detail::RegisterdInstanceT<detail::TestContextRegistration, AccessType, InstanceType>;
+#else
 template<typename AccessType, typename InstanceType = AccessType>
 using TestInstance = detail::RegisterdInstanceT<detail::ReplacingInstanceRegistration, AccessType, InstanceType>;
+#endif
+
+
+template<typename AccessType, typename InstanceType = AccessType>
+using ThreadLocalInstance = detail::RegisterdInstanceT<detail::ThreadLocalInstanceRegistration, AccessType, InstanceType>;
 
 
-#define GLOBAL_INSTANCE_IS_FRIEND template< template<typename, typename> class, typename , typename > friend class ::global::detail::RegisterdInstanceT
+#define GLOBAL_INSTANCE_IS_FRIEND template< template<typename> class, typename , typename > friend class ::global::detail::RegisterdInstanceT
 
 
 }//global
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "LazyAccess.h"
+#include "SpinLock.h"
+#include "ThreadLocalAccess.h"
+#include "staticValue.h"
+#include "throwImpl.h"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+
+//number of distinct types accessed by instance<T>() which fit into the statically allocated table,
+//more types get heap allocated chunks of the same size unless GLOBAL_NO_HEAP is defined
+#ifndef GLOBAL_INSTANCE_TYPE_CAPACITY
+#define GLOBAL_INSTANCE_TYPE_CAPACITY 1024
+#endif
+
+namespace global {
+
+namespace detail {
+
+class InstanceRegistry;
+
+template<typename T>
+class InstancePointer;
+
+//the signature of this function names T, typeName<T>() trims it to the name
+template<typename T>
+char const* signature(){
+#if defined(_MSC_VER) && !defined(__clang__)
+    return __FUNCSIG__;
+#else
+    return __PRETTY_FUNCTION__;
+#endif
+}
+
+}
+
+
+class TooManyInstanceTypes : public std::exception {};
+
+
+//the most deferred calls queued at once for a type and how many fit without allocation
+struct DeferredCallUsage{
+    std::size_t highWatermark;
+    std::size_t capacity;
+};
+
+
+//instance pointer and queued deferred calls of one type, taken by a RegistrySnapshot
+struct CapturedInstance{
+    void* instance;
+    void* parkedCalls; //owned, nullptr if no calls were queued
+    std::size_t endedRegistrations; //at the time of the capture
+};
+
+
+//the deferred calls of a type, installed by the first of them since the translation units
+//which only access instances do not compile them
+struct DeferredCallHooks{
+    DeferredCallUsage (*usage)();
+    CapturedInstance (*capture)();
+    void (*restore)(CapturedInstance);
+};
+
+
+struct TypeName;
+class RegistrySnapshot;
+
+//entry of the registry, describes one type accessed by instance<T>()
+class InstanceType {
+
+public:
+
+    constexpr InstanceType():index(0),slot(nullptr),required(false),signatureOf(nullptr),hooks(nullptr){}
+
+    std::size_t id() const{ return index; }
+    TypeName name() const; //defined in TypeName.h
+    bool registered() const{ return slot->load(std::memory_order_acquire)!=nullptr; }
+    bool requiredOnFreeze() const{ return required; } //false for lazy and thread local types
+
+    //zero if no deferred call of the type was made
+    DeferredCallUsage deferredCalls() const{
+        DeferredCallHooks const* h = hooks.load(std::memory_order_acquire);
+        return h!=nullptr ? h->usage() : DeferredCallUsage{0,0};
+    }
+
+private:
+
+    friend class detail::InstanceRegistry;
+    friend class RegistrySnapshot;
+
+    //without hooks no instance was registered and no call queued yet, so there is nothing to park
+    CapturedInstance capture() const{
+        DeferredCallHooks const* h = hooks.load(std::memory_order_acquire);
+        if (h!=nullptr) return h->capture();
+        return CapturedInstance{slot->load(std::memory_order_acquire),nullptr,0};
+    }
+
+    void restore(CapturedInstance c) const{
+        DeferredCallHooks const* h = hooks.load(std::memory_order_acquire);
+        if (h!=nullptr) h->restore(c);
+    }
+
+    std::size_t index;
+    std::atomic<void*> const* slot;
+    bool required;
+    char const* (*signatureOf)();
+    std::atomic<DeferredCallHooks const*> hooks;
+};
+
+
+namespace detail {
+
+constexpr std::size_t unassignedTypeId = static_cast<std::size_t>(-1);
+
+template<typename T>
+struct TypeId{
+    static std::atomic<std::size_t> value;
+};
+
+template<typename T>
+std::atomic<std::size_t> TypeId<T>::value{unassignedTypeId};
+
+
+//array indexed by type id, the first chunk is part of the table so it can be constant-initialized,
+//the chunks for more types are allocated on first use and stay valid until freeChunks()
+template<typename Item>
+class TypeIdTable {
+
+public:
+
+    static constexpr std::size_t chunkSize = GLOBAL_INSTANCE_TYPE_CAPACITY;
+
+    constexpr TypeIdTable():first{},more(nullptr){}
+
+    //nullptr if no item for the id was allocated yet, lock-free
+    Item* find(std::size_t id){
+        if (id<chunkSize) return &first[id];
+        Chunk* c = more.load(std::memory_order_acquire);
+        for(std::size_t i = id/chunkSize - 1; i>0 && c!=nullptr; --i) c = c->next.load(std::memory_order_acquire);
+        return c!=nullptr ? &c->items[id%chunkSize] : nullptr;
+    }
+
+    Item const* find(std::size_t id) const{ return const_cast<TypeIdTable*>(this)->find(id); }
+
+    //allocates the chunk of the id if needed
+    Item& at(std::size_t id){
+        if (id<chunkSize) return first[id];
+        std::atomic<Chunk*>* link = &more;
+        for(std::size_t i = id/chunkSize; i>0; --i) {
+            Chunk* c = link->load(std::memory_order_acquire);
+            if (c==nullptr) c = allocate(*link);
+            if (i==1) return c->items[id%chunkSize];
+            link = &c->next;
+        }
+        return first[id]; //not reached
+    }
+
+    //expects no concurrent access
+    void freeChunks(){
+        Chunk* c = more.exchange(nullptr,std::memory_order_relaxed);
+        while (c!=nullptr) {
+            Chunk* next = c->next.load(std::memory_order_relaxed);
+            delete c;
+            c = next;
+        }
+    }
+
+private:
+
+    struct Chunk{
+        Item items[chunkSize];
+        std::atomic<Chunk*> next;
+    };
+
+    static Chunk* allocate(std::atomic<Chunk*>& link){
+#ifdef GLOBAL_NO_HEAP
+        (void)link;
+        detail::throwImpl(TooManyInstanceTypes{});
+        return nullptr;
+#else
+        Chunk* c = new Chunk(); //value-initialized, so the items start zeroed
+        Chunk* expected = nullptr;
+        if (link.compare_exchange_strong(expected,c,std::memory_order_acq_rel)) return c;
+        delete c; //allocated by another thread meanwhile
+        return expected;
+#endif
+    }
+
+    TypeIdTable(TypeIdTable const&) = delete;
+    TypeIdTable& operator=(TypeIdTable const&) = delete;
+
+    Item first[chunkSize];
+    std::atomic<Chunk*> more;
+};
+
+
+//table of all types accessed by instance<T>(), ids are the indices into it and entries are never removed
+class InstanceRegistry {
+
+public:
+
+    constexpr InstanceRegistry():count(0){}
+
+    //returns the id of T, assigns the next free one on the first call
+    template<typename T>
+    std::size_t add(){
+
+        SpinLockGuard guard(lock);
+
+        std::atomic<std::size_t>& id = TypeId<T>::value;
+        if (id.load(std::memory_order_relaxed)!=unassignedTypeId) return id.load(std::memory_order_relaxed);
+
+        const std::size_t next = count.load(std::memory_order_relaxed);
+        InstanceType& e = entries.at(next); //throws TooManyInstanceTypes if GLOBAL_NO_HEAP is defined
+
+        e.index = next;
+        e.slot = &constantStaticValue<InstancePointer<T>>().instancePtr;
+        e.required = !LazyAccess<T>::value && !ThreadLocalAccess<T>::value;
+        e.signatureOf = &signature<T>;
+        count.store(next+1,std::memory_order_release); //publishes the entry
+        id.store(next,std::memory_order_release);
+        return next;
+    }
+
+    std::size_t size() const{ return count.load(std::memory_order_acquire); }
+
+    //expects id<size()
+    void installHooks(std::size_t id, DeferredCallHooks const* hooks){ entries.find(id)->hooks.store(hooks,std::memory_order_release); }
+
+    //expects id<size()
+    InstanceType const& operator[](std::size_t id) const{ return *entries.find(id); }
+
+private:
+
+    InstanceRegistry(InstanceRegistry const&) = delete;
+    InstanceRegistry& operator=(InstanceRegistry const&) = delete;
+
+    TypeIdTable<InstanceType> entries;
+    std::atomic<std::size_t> count;
+    SpinLock lock;
+};
+
+inline InstanceRegistry& instanceRegistry(){ return constantStaticValue<InstanceRegistry>(); }
+
+
+//its dynamic initialization enters T into the registry before main, instance<T>() odr-uses it
+template<typename T>
+struct TypeIdRegistrar{
+    static const std::size_t value;
+};
+
+template<typename T>
+const std::size_t TypeIdRegistrar<T>::value = instanceRegistry().add<T>();
+
+}
+
+
+//dense id of T starting at 0, types accessed by instance<T>() get theirs during static initialization
+template<typename T>
+std::size_t typeId(){
+    const std::size_t id = detail::TypeId<T>::value.load(std::memory_order_acquire);
+    return id!=detail::unassignedTypeId ? id : detail::instanceRegistry().add<T>();
+}
+
+//number of types accessed by instance<T>()
+inline std::size_t instanceTypeCount(){ return detail::instanceRegistry().size(); }
+
+//calls f(InstanceType const&) for all types accessed by instance<T>() in the order of their ids
+template<typename Func>
+void forEachInstanceType(Func f){
+    detail::InstanceRegistry const& r = detail::instanceRegistry();
+    for(std::size_t id = 0, size = r.size(); id<size; ++id) f(r[id]);
+}
+
+//true if an instance is registered for all types accessed by instance<T>(), except for the
+//ones with LazyAccess or ThreadLocalAccess which might legitimately have none
+inline bool allInstancesRegistered(){
+    detail::InstanceRegistry const& r = detail::instanceRegistry();
+    for(std::size_t id = 0, size = r.size(); id<size; ++id) if (r[id].requiredOnFreeze() && !r[id].registered()) return false;
+    return true;
+}
+
+//true if an instance is registered for each of Ts
+template<typename... Ts>
+bool instancesRegistered(){
+    const bool registered[] = {true, detail::instanceRegistry()[typeId<Ts>()].registered()...};
+    for(bool r:registered) if (!r) return false;
+    return true;
+}
+
+
+} //global
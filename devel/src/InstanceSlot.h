@@ -0,0 +1,423 @@
+#pragma once
+
+#include "Executor.h"
+#include "Freeze.h"
+#include "InstanceAwaiter.h"
+#include "InstancePointer.h"
+#include "instance.h"
+#include "InstanceRegistry.h"
+#include "Pin.h"
+#include "SmallFunction.h"
+#include "SmallVector.h"
+#include "SpinLock.h"
+#include "staticValue.h"
+#include "TestContext.h"
+#include "ThreadLocalAccess.h"
+#include "Trace.h"
+#include "TypeName.h"
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+//number of deferred calls per type which are queued without allocation,
+//more are an error if GLOBAL_NO_HEAP is defined
+#ifndef GLOBAL_DEFERRED_CALL_CAPACITY
+#define GLOBAL_DEFERRED_CALL_CAPACITY 4
+#endif
+
+namespace global {
+
+//can be specialized to change the capacity for a single type
+template<typename T>
+struct DeferredCallCapacity : std::integral_constant<std::size_t, GLOBAL_DEFERRED_CALL_CAPACITY> {};
+
+template<typename, typename>
+class SwappableInstance;
+
+namespace detail {
+
+//marks a registration without registered instance, nullptr is a valid replaced instance
+struct Unregistered{ constexpr Unregistered(){} };
+
+inline void* unregistered(){ return &constantStaticValue<Unregistered>(); }
+
+//an active registration; they form a stack per type, so a registration ending while replaced by a
+//later one hands the instance it replaced over to that one instead of registering it again
+struct RegistrationLink{
+    RegistrationLink():replaced(unregistered()),below(nullptr){}
+
+    //changed when the registration below ends, but never to or from unregistered()
+    std::atomic<void*> replaced;
+    RegistrationLink* below;
+
+    bool active() const{ return replaced.load(std::memory_order_relaxed)!=unregistered(); }
+
+    void push(RegistrationLink*& top, void* r){
+        replaced.store(r,std::memory_order_relaxed);
+        below = top;
+        top = this;
+    }
+
+    //the registrations are rarely nested deeply, so the one above is searched from the top
+    void unlink(RegistrationLink*& top){
+        RegistrationLink* above = nullptr;
+        for(RegistrationLink* l = top; l!=this; l = l->below) above = l;
+        if (above!=nullptr) {
+            above->replaced.store(replaced.load(std::memory_order_relaxed),std::memory_order_relaxed);
+            above->below = below;
+        }
+        else top = below;
+        replaced.store(unregistered(),std::memory_order_relaxed);
+    }
+};
+
+
+//the slow paths of instance<T>(): registrations, deferred calls and pins, kept apart from
+//InstancePointer<T> so that accessing instances does not need to parse them
+template<typename T>
+class InstanceSlot {
+
+public:
+
+    static Pinned<T> pin(){
+#ifdef GLOBAL_TEST_CONTEXTS
+        void* o = testContextOverride(typeId<T>());
+        if (o!=nullptr) return Pinned<T>(o!=noInstanceOverride() ? static_cast<T*>(o) : nullptr,nullptr); //owned by the test
+#endif
+        return pin(ThreadLocalAccess<T>{});
+    }
+
+    template<typename Func >
+    static void ifAvailable(Func func){
+        T* t = availableOrQueue(func);
+        if (t!=nullptr) func(*t);
+    }
+
+    template<typename Func >
+    static void becomesUnavailable(Func func){
+        Deferred& d = deferred();
+        SpinLockGuard guard(d.lock);
+        d.becomesUnavailableOps.emplace_back(std::move(func)); //never directly
+        d.updateHighWatermark();
+    }
+
+    template<typename Executor, typename Func >
+    static void ifAvailable(Executor& executor, Func func){
+        ExecuteIfAvailable<Executor,Func> op{&executor,std::move(func)};
+        T* t = availableOrQueue(op);
+        if (t!=nullptr) op(*t);
+    }
+
+    template<typename Executor, typename Func >
+    static void becomesUnavailable(Executor& executor, Func func){
+        becomesUnavailable(ExecuteUnavailable<Executor,Func>{&executor,std::move(func)});
+    }
+
+    static InlineExecutor& inlineExecutor(){ return constantStaticValue<InlineExecutor>(); }
+
+    //returns the instance if available, otherwise func is queued and nullptr returned
+    template<typename Func>
+    static T* availableOrQueue(Func& func){
+        T* t = pointer().get();
+        if (t!=nullptr) return t;
+
+        Deferred& d = deferred();
+        SpinLockGuard guard(d.lock);
+        t = pointer().get(); //might have been registered meanwhile
+        if (t==nullptr) {
+            d.ifAvailableOps.emplace_back(std::move(func));
+            d.updateHighWatermark();
+        }
+        return t;
+    }
+
+private:
+
+    static InstancePointer<T>& pointer(){ return instance<T>(); }
+
+    static T* local(T* t){ return InstancePointer<T>::local(t); }
+
+    static Pinned<T> pin(std::false_type /*thread local*/){
+        std::atomic<void*>* slot;
+        T* t = static_cast<T*>(pinRegistered(pointer().instancePtr,slot));
+        return Pinned<T>(local(t),slot);
+    }
+
+    //a thread local instance cannot be deregistered by other threads
+    static Pinned<T> pin(std::true_type /*thread local*/){
+        T* t = ThreadLocalPointer<T>::value;
+        return t!=nullptr ? Pinned<T>(t,nullptr) : pin(std::false_type{});
+    }
+
+    //registers t on top of the active registrations, link stores the replaced instance
+    static void beginRegistration(RegistrationLink& link, T* t){
+        T* before = nullptr;
+        assign(t,before,false,false,&link);
+    }
+
+    //like beginRegistration() but only if no instance is registered
+    static bool beginRegistrationIfUnset(RegistrationLink& link, T* t){
+        T* before = nullptr;
+        return assign(t,before,true,false,&link);
+    }
+
+    //puts back the instance replaced by link if it is the last active registration, otherwise the one
+    //above takes it over; destructing is set by the destructors of registrations, which cannot throw
+    static void endRegistration(RegistrationLink& link, bool destructing){
+        T* before = nullptr;
+        assign(nullptr,before,false,destructing,nullptr,&link);
+    }
+
+    //replaces 'expected' without running deferred operations since the instance stays available
+    static bool exchangeIfEqual(T* expected, T* t){
+        std::atomic<void*>& instancePtr = pointer().instancePtr;
+        {
+            SpinLockGuard guard(deferred().lock);
+            if (instancePtr.load(std::memory_order_relaxed)!=expected) return false;
+            checkNotPinnedByCallingThread(expected,false);
+            instancePtr.store(t,std::memory_order_release);
+            ++deferred().endedRegistrations; //expected is retired
+        }
+        waitForExecutedOperations(deferred());
+        waitForPins(expected);
+        return true;
+    }
+
+    static bool assign(T* t, T*& before, bool onlyIfUnset, bool destructing = false,
+                       RegistrationLink* registering = nullptr, RegistrationLink* ending = nullptr){
+
+        std::atomic<void*>& instancePtr = pointer().instancePtr;
+        Deferred& d = deferred();
+        DeferredOperation available;
+        DeferredOperation unavailable;
+        bool reportFrozen;
+        {
+            FreezeCheck freezeCheck(destructing);
+            reportFrozen = freezeCheck.changeWhileFrozen();
+
+            SpinLockGuard guard(d.lock);
+            before = static_cast<T*>(instancePtr.load(std::memory_order_relaxed));
+            if (onlyIfUnset && before!=nullptr) return false;
+            if (ending!=nullptr) {
+                ++d.endedRegistrations;
+                if (ending!=d.topRegistration) { //replaced by a later registration, which now puts back the instance
+                    ending->unlink(d.topRegistration);
+                    return true;
+                }
+                t = static_cast<T*>(ending->replaced.load(std::memory_order_relaxed));
+            }
+            if (before!=t && before!=nullptr) checkNotPinnedByCallingThread(before,destructing);
+            if (ending!=nullptr) ending->unlink(d.topRegistration);
+            if (registering!=nullptr) registering->push(d.topRegistration,before);
+            if (before == t) return true; //nothing changed
+            instancePtr.store(t,std::memory_order_release);
+
+            if (t!=nullptr) available.swap(d.ifAvailableOps);
+            if (before!=nullptr && t==nullptr) unavailable.swap(d.becomesUnavailableOps);
+        }
+
+        if (reportFrozen) onDeregistrationWhileFrozen<T>();
+        for(auto& op:available) { TraceSpan<T> span("ifAvailable"); op(*local(t)); }
+        for(auto& op:unavailable) { TraceSpan<T> span("becomesUnavailable"); op(*local(before)); }
+        if (before!=nullptr) waitForExecutedOperations(d); //also when replaced, e.g. by restoring after a mock
+        if (before!=nullptr) waitForPins(before); //before might be destructed next
+        return true;
+    }
+
+    template<typename, typename>
+    friend class BasicInstanceRegistration;
+
+    template<typename, typename>
+    friend class ::global::SwappableInstance;
+
+    //queued calls up to this count and typical capture sizes do not allocate
+    static constexpr std::size_t inlineOperationCount = DeferredCallCapacity<T>::value;
+    using DeferredOperation = SmallVector<SmallFunction<void(T&)>, inlineOperationCount>;
+
+    struct HandedOverCall{
+        SmallFunction<void(T&)> func; //empty once the executor started it
+        T* t;
+    };
+
+    using HandedOverCalls = SmallVector<HandedOverCall, inlineOperationCount>;
+
+    //constructed by the first deferred call or registration, which installs the hooks
+    //through which the registry reaches it
+    struct Deferred{
+        Deferred(){ instanceRegistry().installHooks(typeId<T>(),hooks()); }
+
+        DeferredOperation ifAvailableOps;
+        DeferredOperation becomesUnavailableOps;
+        SpinLock lock;
+        std::atomic<std::size_t> running{0}; //ifAvailable calls being executed by an executor
+        std::atomic<std::size_t> runningUnavailable{0}; //becomesUnavailable calls being executed by an executor
+        HandedOverCalls handedOver; //becomesUnavailable calls passed to an executor but not started yet
+        std::size_t handedOverGeneration = 0; //incremented whenever handedOver is taken by the deregistration
+        std::size_t endedRegistrations = 0; //the instances of ended registrations might be destructed
+        RegistrationLink* topRegistration = nullptr; //the last active registration
+        std::size_t highWatermark = 0; //most calls queued in one of the lists
+
+        void updateHighWatermark(){
+            const std::size_t n = ifAvailableOps.size()>becomesUnavailableOps.size() ? ifAvailableOps.size() : becomesUnavailableOps.size();
+            if (n>highWatermark) highWatermark = n;
+        }
+    };
+
+    static Deferred& deferred(){ return staticValue<Deferred>(); }
+
+    static DeferredCallHooks const* hooks(){
+        static const DeferredCallHooks h{&deferredCallUsage,&capture,&restore};
+        return &h;
+    }
+
+    static DeferredCallUsage deferredCallUsage(){
+        Deferred& d = deferred();
+        SpinLockGuard guard(d.lock);
+        return DeferredCallUsage{d.highWatermark,inlineOperationCount};
+    }
+
+    struct ParkedCalls{
+        DeferredOperation ifAvailableOps;
+        DeferredOperation becomesUnavailableOps;
+    };
+
+    //moves the queued deferred calls out, so they are neither executed nor dropped until restored
+    static CapturedInstance capture(){
+        Deferred& d = deferred();
+        SpinLockGuard guard(d.lock);
+        CapturedInstance c{pointer().instancePtr.load(std::memory_order_relaxed),nullptr,d.endedRegistrations};
+        if (d.ifAvailableOps.empty() && d.becomesUnavailableOps.empty()) return c;
+
+        ParkedCalls* parked = new ParkedCalls;
+        parked->ifAvailableOps.swap(d.ifAvailableOps);
+        parked->becomesUnavailableOps.swap(d.becomesUnavailableOps);
+        c.parkedCalls = parked;
+        return c;
+    }
+
+    //sets the captured instance pointer without executing deferred calls, the calls queued
+    //meanwhile are replaced by the parked ones; if a registration ended since the capture the
+    //captured instance might be destructed, so unless it is still registered the pointer is kept
+    static void restore(CapturedInstance c){
+        ParkedCalls* parked = static_cast<ParkedCalls*>(c.parkedCalls);
+        DeferredOperation dropped;
+        DeferredOperation droppedUnavailable;
+        {
+            Deferred& d = deferred();
+            SpinLockGuard guard(d.lock);
+            std::atomic<void*>& ptr = pointer().instancePtr;
+            if (c.endedRegistrations==d.endedRegistrations || c.instance==nullptr) ptr.store(c.instance,std::memory_order_release);
+            dropped.swap(d.ifAvailableOps);
+            droppedUnavailable.swap(d.becomesUnavailableOps);
+            if (parked!=nullptr) {
+                d.ifAvailableOps.swap(parked->ifAvailableOps);
+                d.becomesUnavailableOps.swap(parked->becomesUnavailableOps);
+            }
+        }
+        delete parked; //destructs the calls outside of the lock
+    }
+
+    //after deregistration or replacement no call passed to an executor may access the replaced instance
+    //anymore; the becomesUnavailable calls the executor has not started are called here, so an executor
+    //run later by the deregistering thread, e.g. a BatchingExecutor, does not make this wait forever
+    static void waitForExecutedOperations(Deferred& d){
+        HandedOverCalls notStarted;
+        {
+            SpinLockGuard guard(d.lock);
+            notStarted.swap(d.handedOver);
+            ++d.handedOverGeneration; //the tickets of the taken calls do nothing anymore
+        }
+        for(auto& c:notStarted) if (c.func) c.func(*c.t);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the one in Executed::operator()
+        while (d.running.load(std::memory_order_acquire)!=0 || d.runningUnavailable.load(std::memory_order_acquire)!=0)
+            std::this_thread::yield();
+    }
+
+    struct Running{
+        explicit Running(std::atomic<std::size_t>& c):count(c){}
+        ~Running(){ count.fetch_sub(1,std::memory_order_release); }
+        std::atomic<std::size_t>& count;
+    };
+
+    //the ifAvailable call handed to an executor, runs only if an instance is still registered
+    template<typename Func>
+    struct Executed{
+        Func func;
+
+        void operator()(){
+            deferred().running.fetch_add(1,std::memory_order_relaxed);
+            Running running(deferred().running);
+            std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the one in waitForExecutedOperations()
+            T* registered = static_cast<T*>(pointer().instancePtr.load(std::memory_order_acquire));
+            if (registered!=nullptr) func(*local(registered));
+        }
+    };
+
+    //handed to an executor instead of a becomesUnavailable call, which is kept in Deferred::handedOver
+    //so the deregistration can call it itself if the executor has not started it yet
+    struct UnavailableTicket{
+        std::size_t generation;
+        std::size_t index;
+
+        void operator()() const{
+            Deferred& d = deferred();
+            SmallFunction<void(T&)> func;
+            T* t;
+            {
+                SpinLockGuard guard(d.lock);
+                if (generation!=d.handedOverGeneration) return; //called by the deregistration
+                HandedOverCall& c = *(d.handedOver.begin()+index);
+                func = std::move(c.func);
+                t = c.t;
+                d.runningUnavailable.fetch_add(1,std::memory_order_relaxed); //the deregistration waits for it from here
+            }
+            Running running(d.runningUnavailable);
+            func(*t);
+        }
+    };
+
+    template<typename Executor, typename Func>
+    struct ExecuteIfAvailable{
+        Executor* executor;
+        Func func;
+        void operator()(T&){ executor->execute(Executed<Func>{std::move(func)}); }
+    };
+
+    template<typename Executor, typename Func>
+    struct ExecuteUnavailable{
+        Executor* executor;
+        Func func;
+        void operator()(T& t){
+            Deferred& d = deferred();
+            UnavailableTicket ticket;
+            {
+                SpinLockGuard guard(d.lock);
+                ticket = UnavailableTicket{d.handedOverGeneration,d.handedOver.size()};
+                d.handedOver.emplace_back(HandedOverCall{std::move(func),&t});
+            }
+            executor->execute(ticket);
+        }
+    };
+};
+
+}
+
+
+//writes one line "<high watermark> <capacity> <type name>" per type with queued deferred calls,
+//the capacities can be sized by it before defining GLOBAL_NO_HEAP
+template<typename Stream>
+void writeDeferredCallHighWatermarks(Stream& out){
+    forEachInstanceType([&out](InstanceType const& t){
+        DeferredCallUsage u = t.deferredCalls();
+        if (u.highWatermark==0) return;
+        TypeName n = t.name();
+        out << u.highWatermark << ' ' << u.capacity << ' ';
+        out.write(n.data,static_cast<std::ptrdiff_t>(n.size)) << '\n';
+    });
+}
+
+
+} //global
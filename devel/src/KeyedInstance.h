@@ -0,0 +1,387 @@
+#pragma once
+
+#include "Freeze.h"
+#include "InstanceRegistration.h"
+#include "InstanceSlot.h"
+#include "NullptrAccessHandler.h"
+#include "SmallFunction.h"
+#include "SmallVector.h"
+#include "SpinLock.h"
+#include "staticValue.h"
+#include "throwImpl.h"
+#include "Trace.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace global {
+
+
+//key of a KeyedInstance, an integer or a string which is only referenced, the hash is computed once
+class InstanceKey {
+
+public:
+
+    template<typename Integer, typename = typename std::enable_if<std::is_integral<Integer>::value>::type>
+    InstanceKey(Integer i):integer(static_cast<std::uint64_t>(i)),data(nullptr),size(0),hashValue(mix(integer)){}
+
+    InstanceKey(char const* s):InstanceKey(s,std::strlen(s)){}
+    InstanceKey(std::string const& s):InstanceKey(s.data(),s.size()){}
+    InstanceKey(char const* s, std::size_t n):integer(0),data(s),size(n),hashValue(fnv1a(s,n)){}
+
+    std::uint64_t hash() const{ return hashValue; }
+    bool isString() const{ return data!=nullptr; }
+    std::string str() const{ return isString() ? std::string(data,size) : std::to_string(integer); }
+
+    std::uint64_t integerValue() const{ return integer; }
+    char const* chars() const{ return data; }
+    std::size_t length() const{ return size; }
+
+    //an integer never equals a string
+    bool operator==(InstanceKey const& o) const{
+        if (hashValue!=o.hashValue || isString()!=o.isString()) return false;
+        return isString() ? size==o.size && std::memcmp(data,o.data,size)==0 : integer==o.integer;
+    }
+
+private:
+
+    static std::uint64_t mix(std::uint64_t x){
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    static std::uint64_t fnv1a(char const* s, std::size_t n){
+        std::uint64_t h = 0xcbf29ce484222325ULL;
+        for(std::size_t i = 0; i<n; ++i) h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001b3ULL;
+        return h;
+    }
+
+    std::uint64_t integer;
+    char const* data;
+    std::size_t size;
+    std::uint64_t hashValue;
+};
+
+
+namespace detail {
+
+template<typename T> class KeyedSlots;
+template<typename T> KeyedSlots<T>& keyedSlots();
+
+
+//the instance registered for one key together with its deferred calls, never freed
+template<typename T>
+class KeyedSlot {
+
+public:
+
+    explicit KeyedSlot(InstanceKey const& k)
+        :keyCopy(k.isString() ? k.str() : std::string()),
+         slotKey(k.isString() ? InstanceKey(keyCopy) : k){}
+
+    T* get() const{ return instancePtr.load(std::memory_order_acquire); }
+    InstanceKey const& key() const{ return slotKey; }
+
+    template<typename Func>
+    void ifAvailable(Func func){
+        T* t = get();
+        if (t==nullptr) {
+            SpinLockGuard guard(lock);
+            t = get(); //might have been registered meanwhile
+            if (t==nullptr) ifAvailableOps.emplace_back(std::move(func));
+        }
+        if (t!=nullptr) func(*t);
+    }
+
+    template<typename Func>
+    void becomesUnavailable(Func func){
+        SpinLockGuard guard(lock);
+        becomesUnavailableOps.emplace_back(std::move(func)); //never directly
+    }
+
+    //expects no instance to be registered for the key and t not to be null
+    void registerInstance(T* t){
+        TraceSpan<T> span("register");
+        if (t==nullptr) throwImpl(RegisteringNullNotAllowed{});
+
+        DeferredOperation available;
+        {
+            FreezeCheck freezeCheck(false);
+            SpinLockGuard guard(lock);
+            if (instancePtr.load(std::memory_order_relaxed)!=nullptr) throwImpl(InstanceReplacementNotAllowed{});
+            instancePtr.store(t,std::memory_order_release);
+            available.swap(ifAvailableOps);
+        }
+        keyedSlots<T>().publish(*this); //before the calls, so they can look the key up
+        for(auto& op:available) op(*t);
+    }
+
+    //only called on destruction, so deregistering while frozen is reported instead of thrown
+    void deregisterInstance(){
+        TraceSpan<T> span("deregister");
+
+        T* before;
+        DeferredOperation unavailable;
+        bool reportFrozen;
+        {
+            FreezeCheck freezeCheck(true);
+            reportFrozen = freezeCheck.changeWhileFrozen();
+            SpinLockGuard guard(lock);
+            before = instancePtr.exchange(nullptr,std::memory_order_release);
+            unavailable.swap(becomesUnavailableOps);
+        }
+        keyedSlots<T>().publish(*this);
+        if (reportFrozen) onDeregistrationWhileFrozen<T>();
+        for(auto& op:unavailable) op(*before);
+    }
+
+private:
+
+    KeyedSlot(KeyedSlot const&) = delete;
+    KeyedSlot& operator=(KeyedSlot const&) = delete;
+
+    using DeferredOperation = SmallVector<SmallFunction<void(T&)>, DeferredCallCapacity<T>::value>;
+
+    std::atomic<T*> instancePtr{nullptr};
+    std::string keyCopy; //owns the characters of a string key
+    InstanceKey slotKey;
+    DeferredOperation ifAvailableOps;
+    DeferredOperation becomesUnavailableOps;
+    SpinLock lock;
+};
+
+
+//one entry of the index, holds the key and a copy of the instance pointer so a lookup of
+//an integer key or a string key of up to inlineKeyCapacity characters reads only this cache line
+template<typename T>
+struct alignas(64) KeyedCell {
+
+    static constexpr std::size_t inlineKeyCapacity = 24;
+
+    bool holds(InstanceKey const& k) const{
+        if (hash!=k.hash() || isString!=k.isString()) return false;
+        if (!isString) return integer==k.integerValue();
+        if (size!=k.length()) return false;
+        if (size<=inlineKeyCapacity) return std::memcmp(chars,k.chars(),size)==0;
+        return slot.load(std::memory_order_relaxed)->key()==k; //longer keys are compared on the slot
+    }
+
+    std::atomic<KeyedSlot<T>*> slot{nullptr}; //published after the key, which is not changed afterwards
+    std::atomic<T*> instance{nullptr}; //the instance of the slot, updated by KeyedSlots::publish
+    std::uint64_t hash = 0;
+    std::uint64_t integer = 0;
+    std::uint32_t size = 0;
+    bool isString = false;
+    char chars[inlineKeyCapacity];
+};
+
+
+//flat open-addressing index from the keys to the cells of T, filled at most half so a lookup
+//mostly reads a single cell, replaced by a twice as large copy on growth
+template<typename T>
+class KeyedSlots {
+
+public:
+
+    using Cell = KeyedCell<T>;
+
+    constexpr KeyedSlots():current(nullptr),count(0){}
+
+    //lock-free and allocation-free
+    Cell const* find(InstanceKey const& key) const{
+        Index const* index = current.load(std::memory_order_acquire);
+        if (index==nullptr) return nullptr;
+
+        for(std::size_t i = key.hash() & index->mask;; i = (i+1) & index->mask) {
+            Cell const& c = index->cells[i];
+            if (c.slot.load(std::memory_order_acquire)==nullptr) return nullptr;
+            if (c.holds(key)) return &c;
+        }
+    }
+
+    Cell const& findOrCreate(InstanceKey const& key){
+
+        Cell const* c = find(key);
+        if (c!=nullptr) return *c;
+
+        SpinLockGuard guard(lock);
+        c = find(key); //might have been created meanwhile
+        if (c!=nullptr) return *c;
+
+        KeyedSlot<T>* s = new KeyedSlot<T>(key);
+        Index* index = current.load(std::memory_order_relaxed);
+        if (index==nullptr || 2*(count+1) > index->mask+1) index = grow(index);
+        ++count;
+        return insert(*index,s);
+    }
+
+    //copies the instance pointer of s to its cells, also to the ones of replaced indices
+    //since handles might still point to them
+    void publish(KeyedSlot<T>& s){
+        SpinLockGuard guard(lock);
+        for(Index* index = current.load(std::memory_order_relaxed); index!=nullptr; index = index->replaced) {
+            Cell* c = cellOf(*index,&s);
+            if (c==nullptr) break; //s was created after this index was replaced
+            c->instance.store(s.get(),std::memory_order_release);
+        }
+    }
+
+private:
+
+    //replaced indices are kept since lookups and handles might still read them
+    struct Index{
+        std::size_t mask;
+        Cell* cells;
+        Index* replaced;
+    };
+
+    static Cell& insert(Index& index, KeyedSlot<T>* s){
+        InstanceKey const& key = s->key();
+        std::size_t i = key.hash() & index.mask;
+        while (index.cells[i].slot.load(std::memory_order_relaxed)!=nullptr) i = (i+1) & index.mask;
+
+        Cell& c = index.cells[i];
+        c.hash = key.hash();
+        c.isString = key.isString();
+        if (key.isString()) {
+            c.size = static_cast<std::uint32_t>(key.length());
+            if (key.length()<=Cell::inlineKeyCapacity) std::memcpy(c.chars,key.chars(),key.length());
+        }
+        else c.integer = key.integerValue();
+        c.instance.store(s->get(),std::memory_order_relaxed);
+        c.slot.store(s,std::memory_order_release);
+        return c;
+    }
+
+    static Cell* cellOf(Index& index, KeyedSlot<T>* s){
+        for(std::size_t i = s->key().hash() & index.mask;; i = (i+1) & index.mask) {
+            KeyedSlot<T>* found = index.cells[i].slot.load(std::memory_order_relaxed);
+            if (found==s) return &index.cells[i];
+            if (found==nullptr) return nullptr;
+        }
+    }
+
+    static Cell* allocateCells(std::size_t size){
+        //operator new does not respect the alignment before c++17
+        auto raw = reinterpret_cast<std::uintptr_t>(::operator new(size*sizeof(Cell)+alignof(Cell)));
+        auto aligned = (raw + alignof(Cell)-1) & ~std::uintptr_t(alignof(Cell)-1);
+        Cell* cells = reinterpret_cast<Cell*>(aligned);
+        for(std::size_t i = 0; i<size; ++i) new (&cells[i]) Cell();
+        return cells;
+    }
+
+    Index* grow(Index* old){
+        const std::size_t size = old==nullptr ? 8 : 2*(old->mask+1);
+        Index* index = new Index{size-1,allocateCells(size),old};
+        if (old!=nullptr)
+            for(std::size_t i = 0; i<=old->mask; ++i) {
+                KeyedSlot<T>* s = old->cells[i].slot.load(std::memory_order_relaxed);
+                if (s!=nullptr) insert(*index,s);
+            }
+        current.store(index,std::memory_order_release);
+        return index;
+    }
+
+    KeyedSlots(KeyedSlots const&) = delete;
+    KeyedSlots& operator=(KeyedSlots const&) = delete;
+
+    std::atomic<Index*> current;
+    std::size_t count;
+    SpinLock lock;
+};
+
+template<typename T>
+KeyedSlots<T>& keyedSlots(){
+#ifdef GLOBAL_NO_HEAP
+    static_assert(sizeof(T)==0, "GLOBAL_NO_HEAP: keyed instances allocate their slots and index");
+#endif
+    return constantStaticValue<KeyedSlots<T>>();
+}
+
+
+//returned by instance<T>(key), looks the key up once on construction
+template<typename T>
+class KeyedInstancePointer {
+
+public:
+
+    explicit KeyedInstancePointer(InstanceKey const& k):key(k),cell(keyedSlots<T>().find(k)){
+        if (cell==nullptr && k.isString()) keyCopy.assign(k.chars(),k.length()); //the characters of k might be gone before the slot is created
+    }
+
+    operator bool() const{ return get()!=nullptr; }
+
+    bool operator==(T const* t) const{  return get()==t;}
+    bool operator!=(T const* t) const{  return get()!=t;}
+
+    explicit operator T*() const{  return operator ->(); }
+
+    T& operator*() const{ return *operator->(); }
+    T* operator->() const{
+        T* t = get();
+        if (t==nullptr) global::onNullPtrAccess<>();
+        return t;
+    }
+
+    template<typename Func >
+    void ifAvailable(Func func){ createdSlot().ifAvailable(std::move(func)); }
+
+    template<typename Func >
+    void becomesUnavailable(Func func){ createdSlot().becomesUnavailable(std::move(func)); }
+
+private:
+
+    T* get() const{ return cell!=nullptr ? cell->instance.load(std::memory_order_acquire) : nullptr; }
+
+    //the slot holds the deferred calls of a key not registered yet
+    KeyedSlot<T>& createdSlot(){
+        if (cell==nullptr) cell = &keyedSlots<T>().findOrCreate(key.isString() ? InstanceKey(keyCopy) : key);
+        return *cell->slot.load(std::memory_order_acquire);
+    }
+
+    InstanceKey key; //the characters of a string key are only read through keyCopy
+    std::string keyCopy;
+    typename KeyedSlots<T>::Cell const* cell;
+};
+
+}
+
+
+//the instance registered as KeyedInstance<T> for key, deferred calls behave like the ones of instance<T>()
+template<typename T>
+detail::KeyedInstancePointer<T> instance(InstanceKey const& key){ return detail::KeyedInstancePointer<T>(key); }
+
+
+//constructs an instance of InstanceType and registers it for the key, more than one instance per key is an error
+template<typename AccessType, typename InstanceType = AccessType>
+class KeyedInstance {
+
+public:
+
+    template<typename... Args>
+    explicit KeyedInstance(InstanceKey const& key, Args&&... args)
+        :t(std::forward<Args>(args)...),reg(detail::keyedSlots<AccessType>().findOrCreate(key).slot.load(std::memory_order_acquire),&t){}
+
+private:
+
+    struct Registration{
+        Registration(detail::KeyedSlot<AccessType>* s, AccessType* t):slot(s){ slot->registerInstance(t); }
+        ~Registration(){ slot->deregisterInstance(); }
+        detail::KeyedSlot<AccessType>* slot;
+    };
+
+    KeyedInstance(KeyedInstance const&) = delete;
+    KeyedInstance& operator=(KeyedInstance const&) = delete;
+
+    InstanceType t;
+    Registration reg;
+};
+
+
+} //global
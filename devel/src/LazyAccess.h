@@ -0,0 +1,15 @@
+#pragma once
+
+#include <type_traits>
+
+namespace global {
+
+//allows lazy instances of T if specialized to be true, only then instance<T>() looks for
+//a LazyInstance<T> to construct if no instance is registered
+template<typename T>
+struct LazyAccess : std::false_type {};
+
+//override by spcializing
+//template<> struct LazyAccess<A> : std::true_type {};
+
+} //global
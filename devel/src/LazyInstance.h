@@ -0,0 +1,123 @@
+#pragma once
+
+#include "IndexSequence.h"
+#include "InstanceRegistration.h"
+#include "LazyAccess.h"
+#include "SmallFunction.h"
+#include "SpinLock.h"
+#include "throwImpl.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace global {
+
+
+class LazyInstanceAlreadyDeclared : public std::exception {};
+
+
+namespace detail {
+
+template<typename InstanceType, typename... Args>
+struct LazyConstruction{
+
+    std::tuple<Args...> args;
+
+    void operator()(void* at){ construct(at,typename MakeIndexSequence<sizeof...(Args)>::type{}); }
+
+    template<std::size_t... I>
+    void construct(void* at, IndexSequence<I...>){ new (at) InstanceType(argument(std::get<I>(args))...); }
+
+    //copies are passed so the arguments are still there if construction throws and is retried,
+    //arguments which cannot be copied are moved
+    template<typename A>
+    static typename std::enable_if<std::is_copy_constructible<A>::value, A>::type argument(A& a){ return a; }
+
+    template<typename A>
+    static typename std::enable_if<!std::is_copy_constructible<A>::value, A&&>::type argument(A& a){ return std::move(a); }
+};
+
+}
+
+
+//constructs an instance of InstanceType on the first access by instance<AccessType>() and registers it,
+//the accesses after that are not affected; the constructor arguments are copied on declaration
+//and kept until a construction succeeds; needs LazyAccess<AccessType> to be specialized
+template<typename AccessType, typename InstanceType = AccessType>
+class LazyInstance {
+
+    static_assert(LazyAccess<AccessType>::value, "lazy instances need to be allowed by specializing global::LazyAccess<T>");
+
+public:
+
+    template<typename... Args>
+    explicit LazyInstance(Args&&... args)
+        :construction(detail::LazyConstruction<InstanceType, typename std::decay<Args>::type...>{
+                          std::tuple<typename std::decay<Args>::type...>(std::forward<Args>(args)...)}){
+
+        auto& l = Pointer::lazySlot();
+        detail::SpinLockGuard guard(l.lock);
+        if (l.constructor.construct!=nullptr) detail::throwImpl(LazyInstanceAlreadyDeclared{});
+        l.constructor.construct = &constructFor;
+        l.constructor.owner = this;
+    }
+
+    ~LazyInstance(){
+        {
+            auto& l = Pointer::lazySlot();
+            detail::SpinLockGuard guard(l.lock);
+            l.constructor.construct = nullptr;
+            l.constructor.owner = nullptr;
+        }
+        while (Pointer::lazySlot().constructing.load(std::memory_order_acquire)!=0) std::this_thread::yield(); //accesses which already found this
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!built.load(std::memory_order_relaxed)) return;
+        reg.deregisterInstance(true);
+        object()->~InstanceType();
+    }
+
+    bool constructed() const{ return built.load(std::memory_order_acquire); }
+
+private:
+
+    using Pointer = detail::InstancePointer<AccessType>;
+
+    InstanceType* object(){ return reinterpret_cast<InstanceType*>(&storage); }
+
+    //called by each thread that finds no instance, the first one constructs it
+    static AccessType* constructFor(void* owner){
+
+        LazyInstance& self = *static_cast<LazyInstance*>(owner);
+        std::lock_guard<std::mutex> lock(self.mutex);
+
+        if (self.built.load(std::memory_order_relaxed)) return self.object();
+
+        AccessType* registered = instance<AccessType>().get();
+        if (registered!=nullptr) return registered; //registered by someone else meanwhile
+
+        self.construction(&self.storage);
+        if (!self.reg.tryRegisterInstance(self.object())) { //lost the race against another registration
+            self.object()->~InstanceType();
+            return instance<AccessType>().get();
+        }
+        self.construction.reset(); //the arguments are not needed anymore
+        self.built.store(true,std::memory_order_release);
+        return self.object();
+    }
+
+    LazyInstance(LazyInstance const&) = delete;
+    LazyInstance& operator=(LazyInstance const&) = delete;
+
+    detail::SmallFunction<void(void*)> construction;
+    std::mutex mutex;
+    std::atomic<bool> built{false};
+    typename std::aligned_storage<sizeof(InstanceType), std::alignment_of<InstanceType>::value>::type storage;
+    detail::InstanceRegistration<AccessType> reg;
+};
+
+
+}//global
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <exception>
+
+//define GLOBAL_NO_HEAP for the whole program to never allocate, SmallVector and SmallFunction
+//then fail instead of using the heap and thread records are taken from a static pool
+
+namespace global {
+
+
+class CapacityExceeded : public std::exception {};
+
+
+} //global
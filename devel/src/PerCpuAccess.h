@@ -0,0 +1,51 @@
+#pragma once
+
+#include "staticValue.h"
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+namespace global {
+
+//replicates T per cpu if specialized to be true, in that case instance<T>() returns the
+//replica of the calling cpu and T has to be registered by a PerCpuInstance<T>
+template<typename T>
+struct PerCpuAccess : std::false_type {};
+
+//override by spcializing
+//template<> struct PerCpuAccess<A> : std::true_type {};
+
+
+namespace detail {
+
+//cache line aligned so cpus never write to the same line
+template<typename T>
+struct alignas(64) Replica{
+    template<typename... Args>
+    explicit Replica(Args&&... args):value(static_cast<Args&&>(args)...){}
+    T value;
+};
+
+//set by cpuCount() before the first PerCpuInstance is registered, so querying the cpu
+//stays out of the translation units which only access instances
+struct Cpus{
+    constexpr Cpus():count(0),current(nullptr){}
+    std::atomic<std::size_t> count; //number of replicas
+    std::atomic<std::size_t(*)()> current; //the cpu of the calling thread
+};
+
+inline Cpus& cpus(){ return constantStaticValue<Cpus>(); }
+
+template<typename T>
+T* replica(T* first, std::size_t cpu){
+    const std::size_t n = cpus().count.load(std::memory_order_relaxed);
+    if (cpu>=n) cpu %= n; //cpus added after counting, or thread indices
+    return &(reinterpret_cast<Replica<T>*>(first)+cpu)->value;
+}
+
+//expects a PerCpuInstance to be registered
+template<typename T>
+T* localReplica(T* first){ return replica(first,cpus().current.load(std::memory_order_relaxed)()); }
+
+}
+} //global
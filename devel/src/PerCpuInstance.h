@@ -0,0 +1,138 @@
+#pragma once
+
+#include "InstanceRegistration.h"
+#include "PerCpuAccess.h"
+#include "ThreadLocalAccess.h"
+#include "instance.h"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace global {
+
+namespace detail {
+
+//configured cpus, so cpus which are offline or not in the affinity mask yet get a replica as well
+inline std::size_t possibleCpuCount(){
+#ifdef __linux__
+    const long n = sysconf(_SC_NPROCESSORS_CONF);
+    if (n>0) return static_cast<std::size_t>(n);
+#endif
+    return std::thread::hardware_concurrency();
+}
+
+//used if the cpu cannot be queried, spreads the threads over the replicas
+inline std::size_t threadIndex(){
+    static std::atomic<std::size_t> next{0};
+    thread_local std::size_t index = next.fetch_add(1,std::memory_order_relaxed);
+    return index;
+}
+
+//glibc reads it from the rseq area registered for each thread if available
+inline std::size_t currentCpu(){
+#ifdef __linux__
+    const int cpu = sched_getcpu();
+    if (cpu>=0) return static_cast<std::size_t>(cpu);
+#endif
+    return threadIndex();
+}
+
+//number of replicas, set before the first PerCpuInstance is registered
+inline std::size_t cpuCount(){
+    Cpus& c = cpus();
+    std::size_t n = c.count.load(std::memory_order_acquire);
+    if (n!=0) return n;
+    n = possibleCpuCount();
+    if (n==0) n = 1;
+    c.current.store(&currentCpu,std::memory_order_relaxed);
+    c.count.store(n,std::memory_order_release); //publishes current as well
+    return n;
+}
+
+template<typename T>
+struct PerCpuReplicas{
+
+    //replica of cpu 0, the others follow at the distance of a Replica<T>
+    static T* first(){ return static_cast<T*>(instance<T>().instancePtr.load(std::memory_order_acquire)); }
+};
+
+}
+
+
+//constructs one replica of T per cpu and registers them, instance<T>() then returns the replica
+//of the calling cpu; needs PerCpuAccess<T> to be specialized
+template<typename T>
+class PerCpuInstance {
+
+    static_assert(PerCpuAccess<T>::value, "per cpu instances need to be allowed by specializing global::PerCpuAccess<T>");
+    static_assert(!ThreadLocalAccess<T>::value, "a type cannot be accessed both thread local and per cpu");
+
+public:
+
+    //each replica is constructed from the same arguments
+    template<typename... Args>
+    explicit PerCpuInstance(Args const&... args){
+        for(std::size_t i = 0; i<replicas.size; ++i) {
+            new (replicas.at(i)) detail::Replica<T>(args...);
+            ++replicas.constructed;
+        }
+        reg.registerInstance(&replicas.at(0)->value);
+    }
+
+    std::size_t size() const{ return replicas.size; }
+
+private:
+
+    //operator new does not respect the alignment before c++17
+    struct Replicas{
+        using ReplicaType = detail::Replica<T>;
+
+        Replicas():size(detail::cpuCount()),memory(::operator new(size*sizeof(detail::Replica<T>)+alignof(detail::Replica<T>))){}
+
+        ~Replicas(){
+            for(std::size_t i = 0; i<constructed; ++i) at(i)->~ReplicaType();
+            ::operator delete(memory);
+        }
+
+        detail::Replica<T>* at(std::size_t i){
+            auto aligned = (reinterpret_cast<std::uintptr_t>(memory) + alignof(detail::Replica<T>)-1) & ~std::uintptr_t(alignof(detail::Replica<T>)-1);
+            return reinterpret_cast<detail::Replica<T>*>(aligned) + i;
+        }
+
+        std::size_t size;
+        void* memory;
+        std::size_t constructed = 0;
+    };
+
+    PerCpuInstance(PerCpuInstance const&) = delete;
+    PerCpuInstance& operator=(PerCpuInstance const&) = delete;
+
+    Replicas replicas;
+    detail::InstanceRegistration<T> reg; //deregisters before the replicas are destructed
+};
+
+
+//calls f(T&) for every replica of the registered PerCpuInstance<T>, if any
+template<typename T, typename Func>
+void forEachReplica(Func f){
+    T* first = detail::PerCpuReplicas<T>::first();
+    if (first==nullptr) return;
+    for(std::size_t i = 0, n = detail::cpuCount(); i<n; ++i) f(*detail::replica(first,i));
+}
+
+//combines the replicas of the registered PerCpuInstance<T> by result = f(result, replica), starting with init
+template<typename T, typename R, typename Func>
+R reduce(R init, Func f){
+    forEachReplica<T>([&init,&f](T& t){ init = f(std::move(init),t); });
+    return init;
+}
+
+
+} //global
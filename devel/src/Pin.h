@@ -0,0 +1,137 @@
+#pragma once
+
+#include "NullptrAccessHandler.h"
+#include "ThreadRecords.h"
+#include "throwImpl.h"
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <thread>
+
+//maximum number of instances one thread can pin at once
+#ifndef GLOBAL_PINS_PER_THREAD
+#define GLOBAL_PINS_PER_THREAD 4
+#endif
+
+namespace global {
+
+class TooManyPins : public std::exception {};
+class DeregisteringPinnedInstance : public std::exception {};
+
+
+namespace detail {
+
+template<typename T>
+class InstanceSlot;
+
+//hazard pointers of one thread, only written by their thread and on their own cache line
+struct alignas(64) PinRecord {
+    std::atomic<void*> pinned[GLOBAL_PINS_PER_THREAD];
+    std::atomic<bool> used{true};
+    PinRecord* next = nullptr;
+};
+
+//publishes the registered pointer in a free slot of the calling thread and checks that it is
+//still registered afterwards, returns it or nullptr if none is registered
+inline void* pinRegistered(std::atomic<void*> const& registered, std::atomic<void*>*& slot){
+
+    PinRecord& r = ThreadRecords<PinRecord>::local();
+    slot = nullptr;
+    for(auto& s:r.pinned) if (s.load(std::memory_order_relaxed)==nullptr) { slot = &s; break; }
+    if (slot==nullptr) throwImpl(TooManyPins{});
+
+    void* p = registered.load(std::memory_order_acquire);
+    while (p!=nullptr) {
+        slot->store(p,std::memory_order_seq_cst);
+        void* again = registered.load(std::memory_order_seq_cst);
+        if (again==p) return p;
+        p = again;
+    }
+
+    slot->store(nullptr,std::memory_order_relaxed);
+    slot = nullptr;
+    return nullptr;
+}
+
+//called before replacing p in the registry since waiting for the own pin would never return,
+//destructors cannot throw and only assert
+inline void checkNotPinnedByCallingThread(void const* p, bool destructing){
+    PinRecord* own = ThreadRecords<PinRecord>::localIfCreated();
+    if (own==nullptr) return; //the calling thread never pinned
+
+    for(auto const& s:own->pinned) {
+        if (s.load(std::memory_order_relaxed)!=p) continue;
+        if (!destructing) throwImpl(DeregisteringPinnedInstance{});
+        assert(!"registration destructed while the destructing thread pins its instance");
+    }
+}
+
+//expects p to be replaced in the registry already, returns once no other thread has it pinned
+inline void waitForPins(void const* p){
+
+    std::atomic_thread_fence(std::memory_order_seq_cst); //orders the replacement before reading the pins
+
+    PinRecord const* own = ThreadRecords<PinRecord>::localIfCreated(); //see checkNotPinnedByCallingThread()
+    for(PinRecord* r = ThreadRecords<PinRecord>::first(); r!=nullptr; r = r->next)
+        for(auto const& s:r->pinned)
+            while (r!=own && s.load(std::memory_order_acquire)==p) std::this_thread::yield();
+}
+
+}
+
+
+//returned by instance<T>().pin(), the instance is not deregistered before the guard is destructed
+//or unpinned, expects to be destructed on the pinning thread
+template<typename T>
+class Pinned {
+
+public:
+
+    Pinned():t(nullptr),slot(nullptr){}
+
+    Pinned(Pinned&& o) noexcept :t(o.t),slot(o.slot){ o.t = nullptr; o.slot = nullptr; }
+
+    Pinned& operator=(Pinned&& o) noexcept{
+        if (this==&o) return *this;
+        unpin();
+        t = o.t;
+        slot = o.slot;
+        o.t = nullptr;
+        o.slot = nullptr;
+        return *this;
+    }
+
+    ~Pinned(){ unpin(); }
+
+    explicit operator bool() const{ return t!=nullptr; }
+
+    T* get() const{ return t; }
+
+    T& operator*() const{ return *operator->(); }
+    T* operator->() const{
+        if (t==nullptr) global::onNullPtrAccess<>();
+        return t;
+    }
+
+    void unpin(){
+        if (slot!=nullptr) slot->store(nullptr,std::memory_order_release);
+        slot = nullptr;
+        t = nullptr;
+    }
+
+private:
+
+    template<typename>
+    friend class detail::InstanceSlot;
+
+    Pinned(T* t_, std::atomic<void*>* s):t(t_),slot(s){}
+
+    Pinned(Pinned const&) = delete;
+    Pinned& operator=(Pinned const&) = delete;
+
+    T* t;
+    std::atomic<void*>* slot; //nullptr if nothing needs to be pinned
+};
+
+
+} //global
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "InstanceRegistry.h"
+#include <cstddef>
+#include <vector>
+
+namespace global {
+
+#ifndef GLOBAL_NO_HEAP
+
+//captures the instance pointers of all types accessed by instance<T>() together with their queued
+//deferred calls and restores them on destruction, e.g. to reset a test fixture without
+//constructing or destructing instances; thread local, keyed and lazy instances are not captured
+class RegistrySnapshot {
+
+public:
+
+    //the queued deferred calls are parked in the snapshot, so the following code starts without any
+    RegistrySnapshot(){
+        forEachInstanceType([this](InstanceType const& t){ captured.push_back(t.capture()); });
+    }
+
+    ~RegistrySnapshot(){ restore(); }
+
+    //sets all instance pointers back without executing deferred calls, drops the calls queued since
+    //the capture and queues the parked ones again; types added since then are left untouched, as are
+    //the pointers of types with a registration ended since then, since the captured instance might be
+    //destructed; expects no executor to run deferred calls meanwhile and the registrations not to be frozen
+    void restore(){
+        if (restored) return;
+        restored = true;
+
+        detail::InstanceRegistry const& types = detail::instanceRegistry();
+        for(std::size_t i = 0; i<captured.size(); ++i) types[i].restore(captured[i]);
+    }
+
+    std::size_t size() const{ return captured.size(); }
+
+private:
+
+    RegistrySnapshot(RegistrySnapshot const&) = delete;
+    RegistrySnapshot& operator=(RegistrySnapshot const&) = delete;
+
+    std::vector<CapturedInstance> captured; //indexed by the type id
+    bool restored = false;
+};
+
+#endif // GLOBAL_NO_HEAP
+
+} //global
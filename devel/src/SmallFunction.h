@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace global {
+namespace detail {
+
+//move-only replacement for std::function, callables up to 'Size' bytes are stored inline
+template<typename Signature, std::size_t Size = 4*sizeof(void*)>
+class SmallFunction;
+
+template<typename R, typename... Args, std::size_t Size>
+class SmallFunction<R(Args...), Size> {
+
+    using Storage = typename std::aligned_storage<Size>::type;
+
+    struct Operations{
+        R (*invoke)(Storage& s, Args... args);
+        void (*move)(Storage& from, Storage& to); //leaves 'from' destroyed
+        void (*destroy)(Storage& s);
+    };
+
+    template<typename F>
+    struct Inline{
+        static F& get(Storage& s){ return *reinterpret_cast<F*>(&s); }
+        static R invoke(Storage& s, Args... args){ return get(s)(std::forward<Args>(args)...); }
+        static void move(Storage& from, Storage& to){ new (&to) F(std::move(get(from))); get(from).~F(); }
+        static void destroy(Storage& s){ get(s).~F(); }
+    };
+
+    template<typename F>
+    struct Allocated{
+        static F*& get(Storage& s){ return *reinterpret_cast<F**>(&s); }
+        static R invoke(Storage& s, Args... args){ return (*get(s))(std::forward<Args>(args)...); }
+        static void move(Storage& from, Storage& to){ new (&to) F*(get(from)); }
+        static void destroy(Storage& s){ delete get(s); }
+    };
+
+    template<typename F>
+    using fitsInline = std::integral_constant<bool,
+        sizeof(F)<=Size &&
+        std::alignment_of<Storage>::value % std::alignment_of<F>::value == 0 &&
+        std::is_nothrow_move_constructible<F>::value>;
+
+    template<typename Handler>
+    static Operations const* operations(){
+        static constexpr Operations ops{&Handler::invoke, &Handler::move, &Handler::destroy};
+        return &ops;
+    }
+
+public:
+
+    template<typename F>
+    using storedInline = fitsInline<typename std::decay<F>::type>;
+
+    SmallFunction(){}
+
+    template<typename F,
+             typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, SmallFunction>::value>::type>
+    SmallFunction(F&& f){
+        using Func = typename std::decay<F>::type;
+        construct<Func>(std::forward<F>(f), fitsInline<Func>{});
+    }
+
+    SmallFunction(SmallFunction&& other) noexcept { takeFrom(other); }
+
+    SmallFunction& operator=(SmallFunction&& other) noexcept {
+        if (this == &other) return *this;
+        reset();
+        takeFrom(other);
+        return *this;
+    }
+
+    ~SmallFunction(){ reset(); }
+
+    explicit operator bool() const{ return ops!=nullptr; }
+
+    R operator()(Args... args){ return ops->invoke(storage,std::forward<Args>(args)...); }
+
+    void reset(){
+        if (ops==nullptr) return;
+        ops->destroy(storage);
+        ops = nullptr;
+    }
+
+private:
+
+    template<typename Func, typename F>
+    void construct(F&& f, std::true_type /*inline*/){
+        new (&storage) Func(std::forward<F>(f));
+        ops = operations<Inline<Func>>();
+    }
+
+    template<typename Func, typename F>
+    void construct(F&& f, std::false_type /*inline*/){
+#ifdef GLOBAL_NO_HEAP
+        static_assert(sizeof(Func)==0, "GLOBAL_NO_HEAP: the callable has to fit into the inline storage and be nothrow movable");
+#endif
+        new (&storage) Func*(new Func(std::forward<F>(f)));
+        ops = operations<Allocated<Func>>();
+    }
+
+    void takeFrom(SmallFunction& other){
+        if (other.ops==nullptr) return;
+        other.ops->move(other.storage,storage);
+        ops = other.ops;
+        other.ops = nullptr;
+    }
+
+    SmallFunction(SmallFunction const&) = delete;
+    SmallFunction& operator=(SmallFunction const&) = delete;
+
+    Storage storage;
+    Operations const* ops = nullptr;
+};
+
+}
+} //global
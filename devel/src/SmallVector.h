@@ -0,0 +1,121 @@
+#pragma once
+
+#include "NoHeap.h"
+#include "throwImpl.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace global {
+namespace detail {
+
+//contiguous storage for move-only elements, the first N elements are stored inline,
+//more than N elements are an error if GLOBAL_NO_HEAP is defined
+template<typename T, std::size_t N>
+class SmallVector {
+
+#ifdef GLOBAL_NO_HEAP
+    static_assert(N>0, "GLOBAL_NO_HEAP: a capacity of 0 could never hold an element");
+#endif
+
+public:
+
+    SmallVector(){}
+
+    SmallVector(SmallVector&& other) noexcept { takeFrom(other); }
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this == &other) return *this;
+        clear();
+        releaseHeap();
+        takeFrom(other);
+        return *this;
+    }
+
+    ~SmallVector(){
+        clear();
+        releaseHeap();
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args){
+        if (count==capacity) grow();
+        new (data()+count) T(std::forward<Args>(args)...);
+        ++count;
+    }
+
+    void clear(){
+        for(std::size_t i = 0; i<count; ++i) data()[i].~T();
+        count = 0;
+    }
+
+    void swap(SmallVector& other){
+        SmallVector tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    T* begin(){ return data(); }
+    T* end(){ return data()+count; }
+
+    std::size_t size() const{ return count; }
+    bool empty() const{ return count==0; }
+
+private:
+
+    T* inlineData(){ return reinterpret_cast<T*>(&inlineStorage); }
+    T* data(){ return heap!=nullptr ? heap : inlineData(); }
+
+    void grow(){
+#ifdef GLOBAL_NO_HEAP
+        detail::throwImpl(CapacityExceeded{});
+#endif
+        const std::size_t newCapacity = capacity!=0 ? capacity*2 : 1;
+        T* newHeap = static_cast<T*>(::operator new(newCapacity*sizeof(T)));
+        moveElements(data(),newHeap,count);
+        releaseHeap();
+        heap = newHeap;
+        capacity = newCapacity;
+    }
+
+    static void moveElements(T* from, T* to, std::size_t n){
+        for(std::size_t i = 0; i<n; ++i) {
+            new (to+i) T(std::move(from[i]));
+            from[i].~T();
+        }
+    }
+
+    void releaseHeap(){
+        if (heap==nullptr) return;
+        ::operator delete(heap);
+        heap = nullptr;
+        capacity = N;
+    }
+
+    //expects this to be empty
+    void takeFrom(SmallVector& other){
+        if (other.heap!=nullptr) {
+            heap = other.heap;
+            capacity = other.capacity;
+            other.heap = nullptr;
+            other.capacity = N;
+        }
+        else {
+            moveElements(other.inlineData(),inlineData(),other.count);
+        }
+        count = other.count;
+        other.count = 0;
+    }
+
+    SmallVector(SmallVector const&) = delete;
+    SmallVector& operator=(SmallVector const&) = delete;
+
+    typename std::aligned_storage<sizeof(T)*(N!=0 ? N : 1), std::alignment_of<T>::value>::type inlineStorage; //unused if N is 0
+    T* heap = nullptr;
+    std::size_t count = 0;
+    std::size_t capacity = N;
+};
+
+}
+} //global
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+namespace global {
+namespace detail {
+
+//minimal lock for the rarely taken registration paths, usable without
+//thread support from the standard library (e.g. on embedded targets)
+class SpinLock {
+
+public:
+
+    void lock(){ while (flag.test_and_set(std::memory_order_acquire)) {} }
+    void unlock(){ flag.clear(std::memory_order_release); }
+
+private:
+
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+
+class SpinLockGuard {
+
+public:
+
+    explicit SpinLockGuard(SpinLock& l):spinLock(l){ spinLock.lock(); }
+    ~SpinLockGuard(){ spinLock.unlock(); }
+
+private:
+
+    SpinLockGuard(SpinLockGuard const&) = delete;
+    SpinLockGuard& operator=(SpinLockGuard const&) = delete;
+
+    SpinLock& spinLock;
+};
+
+}
+} //global
@@ -0,0 +1,345 @@
+#pragma once
+
+#include "IndexSequence.h"
+#include "InstanceRegistration.h"
+#include "SmallFunction.h"
+#include "ThreadPool.h"
+#include "exceptionsAvailableDetection.h"
+#include "throwImpl.h"
+#include "TypeName.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace global {
+
+
+template<typename... AccessTypes>
+struct DependsOn{};
+
+class CyclicDependency : public std::exception {};
+class UnresolvedDependency : public std::exception {};
+
+
+//destruction time of one instance during a parallel shutdown
+struct ShutdownTime{
+    TypeName name;
+    std::chrono::nanoseconds duration;
+    bool deadlineExceeded;
+};
+
+struct ShutdownReport{
+    std::vector<ShutdownTime> instances; //longest destruction first
+    std::chrono::nanoseconds total{0};
+
+    bool deadlineExceeded() const{
+        for(auto const& i:instances) if (i.deadlineExceeded) return true;
+        return false;
+    }
+};
+
+//writes one line "<duration in us> <type name>" per instance, marked if its deadline was exceeded
+template<typename Stream>
+void writeShutdownReport(Stream& out, ShutdownReport const& report){
+    for(auto const& i:report.instances) {
+        out << std::chrono::duration_cast<std::chrono::microseconds>(i.duration).count() << ' ';
+        out.write(i.name.data,static_cast<std::ptrdiff_t>(i.name.size));
+        if (i.deadlineExceeded) out << " deadline exceeded";
+        out << '\n';
+    }
+}
+
+
+namespace detail {
+
+template<typename Registered>
+struct RegisteredAccessType;
+
+template<template<typename> class RegistrationType, typename AccessType, typename InstanceType>
+struct RegisteredAccessType<RegisterdInstanceT<RegistrationType, AccessType, InstanceType>>{ using type = AccessType; };
+
+
+//identifies an access type by the address of its instance pointer
+struct StartupDependency{
+    void const* key;
+    bool (*registered)();
+    TypeName (*name)();
+};
+
+template<typename T>
+bool isRegistered(){ return static_cast<bool>(instance<T>()); }
+
+template<typename T>
+StartupDependency startupDependency(){ return StartupDependency{&instance<T>(), &isRegistered<T>, &typeName<T>}; }
+
+template<typename... AccessTypes>
+std::vector<StartupDependency> startupDependencies(DependsOn<AccessTypes...>){ return {startupDependency<AccessTypes>()...}; }
+
+
+template<typename Registered, typename... Args>
+struct StartupConstruction{
+
+    std::tuple<Args...> args;
+
+    std::shared_ptr<void> operator()(){ return construct(typename MakeIndexSequence<sizeof...(Args)>::type{}); }
+
+    template<std::size_t... I>
+    std::shared_ptr<void> construct(IndexSequence<I...>){ return std::make_shared<Registered>(argument(std::get<I>(args))...); }
+
+    //copies are passed so the arguments are still there if construction throws and run() is called again,
+    //arguments which cannot be copied are moved
+    template<typename A>
+    static typename std::enable_if<std::is_copy_constructible<A>::value, A>::type argument(A& a){ return a; }
+
+    template<typename A>
+    static typename std::enable_if<!std::is_copy_constructible<A>::value, A&&>::type argument(A& a){ return std::move(a); }
+};
+
+
+struct StartupNode{
+    StartupDependency provides;
+    std::vector<StartupDependency> dependencies;
+    SmallFunction<std::shared_ptr<void>()> construct;
+
+    std::shared_ptr<void> instance;
+    std::vector<std::size_t> dependents;
+    std::size_t missing = 0;
+};
+
+}
+
+
+//constructs registered instances concurrently, each one as soon as the instances it
+//depends on are registered; destructs them in the reverse order of their construction
+//or concurrently, each one as soon as the instances depending on it are destructed
+class Startup {
+
+public:
+
+    explicit Startup(){}
+
+    ~Startup(){ shutdown(); }
+
+    //eg. add<Instance<B>, DependsOn<A>>(args...)
+    template<typename Registered, typename Dependencies = DependsOn<>, typename... Args>
+    void add(Args&&... args){
+        using AccessType = typename detail::RegisteredAccessType<Registered>::type;
+        using Construction = detail::StartupConstruction<Registered, typename std::decay<Args>::type...>;
+
+        detail::StartupNode node;
+        node.provides = detail::startupDependency<AccessType>();
+        node.dependencies = detail::startupDependencies(Dependencies{});
+        node.construct = Construction{std::tuple<typename std::decay<Args>::type...>(std::forward<Args>(args)...)};
+        nodes.push_back(std::move(node));
+    }
+
+    //returns after all added instances are constructed
+    void run(unsigned threadCount = ThreadPool::defaultThreadCount()){
+
+        const std::size_t pending = resolve();
+        if (pending==0) return;
+
+        State state;
+        ThreadPool pool(threadCount);
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            for(std::size_t i = 0; i<nodes.size(); ++i)
+                if (!nodes[i].instance && nodes[i].missing==0) schedule(i,pool,state);
+
+            state.idle.wait(lock,[&state]{ return state.running==0; });
+        }
+
+#ifndef EXCEPTIONS_DISABLED
+        if (state.error) std::rethrow_exception(state.error);
+#endif
+    }
+
+    //destructs the instances in the reverse order of their construction and removes all added ones
+    void shutdown(){
+        for(auto i = constructionOrder.rbegin(); i!=constructionOrder.rend(); ++i) nodes[*i].instance.reset();
+        constructionOrder.clear();
+        nodes.clear();
+    }
+
+    //destructs the instances concurrently, each one after all constructed instances depending on it,
+    //and removes all added ones; returns the time each destruction took, which also includes the
+    //deregistration and the becomesUnavailable calls executed on the threads of the pool
+    ShutdownReport shutdown(unsigned threadCount, std::chrono::nanoseconds deadline = std::chrono::nanoseconds::max()){
+
+        const auto begin = std::chrono::steady_clock::now();
+        ShutdownState state;
+        state.deadline = deadline;
+        if (!constructionOrder.empty()) {
+
+            for(auto& n:nodes) n.missing = 0;
+            for(std::size_t i:constructionOrder) forEachConstructedProvider(i,[this](std::size_t p){ ++nodes[p].missing; });
+
+            ThreadPool pool(threadCount);
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                for(std::size_t i:constructionOrder) if (nodes[i].missing==0) scheduleDestruction(i,pool,state);
+
+                state.idle.wait(lock,[&state]{ return state.running==0; });
+            }
+        }
+
+        constructionOrder.clear();
+        nodes.clear();
+
+        ShutdownReport& report = state.report;
+        std::sort(report.instances.begin(),report.instances.end(),[](ShutdownTime const& a, ShutdownTime const& b){ return a.duration>b.duration; });
+        report.total = std::chrono::steady_clock::now() - begin;
+        return std::move(report);
+    }
+
+private:
+
+    struct State{
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::size_t running = 0;
+#ifndef EXCEPTIONS_DISABLED
+        std::exception_ptr error;
+#endif
+    };
+
+    struct ShutdownState : State{
+        std::chrono::nanoseconds deadline;
+        ShutdownReport report;
+    };
+
+    //links the unconstructed nodes, returns their count
+    std::size_t resolve(){
+
+        std::vector<std::size_t> unconstructed;
+        for(std::size_t i = 0; i<nodes.size(); ++i) {
+            nodes[i].dependents.clear();
+            nodes[i].missing = 0;
+            if (!nodes[i].instance) unconstructed.push_back(i);
+        }
+
+        for(std::size_t i:unconstructed) {
+            for(auto const& d:nodes[i].dependencies) {
+                const std::size_t provider = providerOf(d.key);
+                if (provider!=nodes.size() && !nodes[provider].instance) {
+                    nodes[provider].dependents.push_back(i);
+                    ++nodes[i].missing;
+                }
+                else if (provider==nodes.size() && !d.registered()) detail::throwImpl(UnresolvedDependency{});
+            }
+        }
+
+        if (hasCycle(unconstructed)) detail::throwImpl(CyclicDependency{});
+        return unconstructed.size();
+    }
+
+    std::size_t providerOf(void const* key) const{
+        for(std::size_t i = 0; i<nodes.size(); ++i) if (nodes[i].provides.key==key) return i;
+        return nodes.size();
+    }
+
+    bool hasCycle(std::vector<std::size_t> const& unconstructed) const{
+        std::vector<std::size_t> missing(nodes.size());
+        std::vector<std::size_t> ready;
+        for(std::size_t i:unconstructed) {
+            missing[i] = nodes[i].missing;
+            if (missing[i]==0) ready.push_back(i);
+        }
+
+        std::size_t visited = 0;
+        while (!ready.empty()) {
+            const std::size_t i = ready.back();
+            ready.pop_back();
+            ++visited;
+            for(std::size_t d:nodes[i].dependents) if (--missing[d]==0) ready.push_back(d);
+        }
+        return visited!=unconstructed.size();
+    }
+
+    //expects state.mutex to be locked
+    void schedule(std::size_t i, ThreadPool& pool, State& state){
+        ++state.running;
+        pool.execute([this,i,&pool,&state]{ construct(i,pool,state); });
+    }
+
+    void construct(std::size_t i, ThreadPool& pool, State& state){
+
+        std::shared_ptr<void> instance;
+#ifndef EXCEPTIONS_DISABLED
+        std::exception_ptr error;
+        try { instance = nodes[i].construct(); }
+        catch(...) { error = std::current_exception(); }
+#else
+        instance = nodes[i].construct();
+#endif
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        --state.running;
+
+#ifndef EXCEPTIONS_DISABLED
+        if (error && !state.error) state.error = error;
+        if (state.error) { if (instance) finished(i,std::move(instance)); state.idle.notify_all(); return; }
+#endif
+
+        finished(i,std::move(instance));
+        for(std::size_t d:nodes[i].dependents) if (--nodes[d].missing==0) schedule(d,pool,state);
+        if (state.running==0) state.idle.notify_all();
+    }
+
+    //calls f(provider) for the constructed nodes node i depends on
+    template<typename Func>
+    void forEachConstructedProvider(std::size_t i, Func f){
+        for(auto const& d:nodes[i].dependencies) {
+            const std::size_t provider = providerOf(d.key);
+            if (provider!=nodes.size() && nodes[provider].instance) f(provider);
+        }
+    }
+
+    //expects state.mutex to be locked
+    void scheduleDestruction(std::size_t i, ThreadPool& pool, ShutdownState& state){
+        ++state.running;
+        pool.execute([this,i,&pool,&state]{ destruct(i,pool,state); });
+    }
+
+    void destruct(std::size_t i, ThreadPool& pool, ShutdownState& state){
+
+        std::shared_ptr<void> instance;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            instance.swap(nodes[i].instance);
+        }
+
+        const auto begin = std::chrono::steady_clock::now();
+        instance.reset(); //deregisters before destructing
+        const std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - begin;
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        --state.running;
+        state.report.instances.push_back(ShutdownTime{nodes[i].provides.name(),duration,duration>state.deadline});
+
+        forEachConstructedProvider(i,[&](std::size_t p){ if (--nodes[p].missing==0) scheduleDestruction(p,pool,state); });
+        if (state.running==0) state.idle.notify_all();
+    }
+
+    void finished(std::size_t i, std::shared_ptr<void> instance){
+        nodes[i].instance = std::move(instance);
+        constructionOrder.push_back(i);
+    }
+
+    Startup(Startup const&) = delete;
+    Startup& operator=(Startup const&) = delete;
+
+    std::vector<detail::StartupNode> nodes;
+    std::vector<std::size_t> constructionOrder;
+};
+
+
+}//global
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "ThreadRecords.h"
+#include "InstanceRegistration.h"
+#include "throwImpl.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace global {
+
+
+class SwapOfReplacedInstanceNotAllowed : public std::exception {};
+
+
+namespace detail {
+
+//initial value 1 since 0 marks threads not within a read section
+template<typename = void>
+struct EpochStorage{ static std::atomic<std::uint64_t> value; };
+
+template<typename T>
+std::atomic<std::uint64_t> EpochStorage<T>::value{1};
+
+class Epoch {
+
+public:
+
+    //smallest epoch of all threads within a read section
+    static std::uint64_t oldestReader(){
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::uint64_t oldest = UINT64_MAX;
+        for(ThreadRecord* r = ThreadRecords<>::first(); r!=nullptr; r = r->next) {
+            const std::uint64_t e = r->epoch.load(std::memory_order_acquire);
+            if (e!=0 && e<oldest) oldest = e;
+        }
+        return oldest;
+    }
+
+    //returns the epoch whose readers cannot see anything published before
+    static std::uint64_t advance(){ return EpochStorage<>::value.fetch_add(1)+1; }
+
+    static void waitForReaders(std::uint64_t e){
+        while (oldestReader()<e) std::this_thread::yield();
+    }
+};
+
+}
+
+
+//instances of SwappableInstance which are accessed within the scope of
+//a ReadSection are not destructed until the scope is left
+class ReadSection {
+
+public:
+
+    ReadSection():record(detail::ThreadRecords<>::local()){
+        if (depth()++!=0) return;
+        record.epoch.store(detail::EpochStorage<>::value.load(std::memory_order_acquire),std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    ~ReadSection(){
+        if (--depth()!=0) return;
+        record.epoch.store(0,std::memory_order_release);
+    }
+
+private:
+
+    static unsigned& depth(){
+        static thread_local unsigned d = 0;
+        return d;
+    }
+
+    ReadSection(ReadSection const&) = delete;
+    ReadSection& operator=(ReadSection const&) = delete;
+
+    detail::ThreadRecord& record;
+};
+
+
+//registers an instance of InstanceType which can be replaced by a new version while
+//being accessed; old versions are destructed once no ReadSection can access them anymore
+template<typename AccessType, typename InstanceType = AccessType>
+class SwappableInstance {
+
+public:
+
+    template<typename... Args>
+    SwappableInstance(Args&&... args):current(new InstanceType(std::forward<Args>(args)...)),reg(current.get()){}
+
+    ~SwappableInstance(){
+        reg.deregisterInstance(true);
+        retired.emplace_back(detail::Epoch::advance(),std::move(current));
+        synchronize();
+    }
+
+    //publishes 'next' without triggering deferred calls
+    void replace(std::unique_ptr<InstanceType> next){
+        if (next==nullptr) detail::throwImpl(RegisteringNullNotAllowed{});
+
+        AccessType* expected = current.get();
+        if (detail::InstanceSlot<AccessType>::exchangeIfEqual(expected,next.get())==false)
+            detail::throwImpl(SwapOfReplacedInstanceNotAllowed{});
+
+        retired.emplace_back(detail::Epoch::advance(),std::move(current));
+        current = std::move(next);
+        reclaim();
+    }
+
+    template<typename... Args>
+    void emplace(Args&&... args){ replace(std::unique_ptr<InstanceType>(new InstanceType(std::forward<Args>(args)...))); }
+
+    //destructs the old versions which cannot be accessed anymore, without waiting
+    void reclaim(){
+        const std::uint64_t oldest = detail::Epoch::oldestReader();
+        retired.erase(std::remove_if(retired.begin(),retired.end(),
+            [oldest](Retired const& r){ return r.first<=oldest; }),retired.end());
+    }
+
+    //waits until all old versions can be destructed and destructs them
+    void synchronize(){
+        if (retired.empty()) return;
+        detail::Epoch::waitForReaders(retired.back().first);
+        retired.clear();
+    }
+
+    std::size_t retiredCount() const{ return retired.size(); }
+
+private:
+
+    SwappableInstance(SwappableInstance const&) = delete;
+
+    using Retired = std::pair<std::uint64_t, std::unique_ptr<InstanceType>>;
+
+    std::unique_ptr<InstanceType> current;
+    detail::InstanceRegistration<AccessType> reg;
+    std::vector<Retired> retired;
+};
+
+
+}//global
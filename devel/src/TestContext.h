@@ -0,0 +1,102 @@
+#pragma once
+
+#include "InstanceRegistry.h"
+#include "staticValue.h"
+#include <atomic>
+#include <cstddef>
+
+//define GLOBAL_TEST_CONTEXTS for the whole test program to let TestInstance replace instances only
+//within the test context bound to the registering thread, otherwise contexts compile to nothing
+
+#if defined(GLOBAL_TEST_CONTEXTS) && defined(GLOBAL_NO_HEAP)
+#error GLOBAL_TEST_CONTEXTS enlarges the calls handed to executors and cannot be combined with GLOBAL_NO_HEAP
+#endif
+
+namespace global {
+
+#ifdef GLOBAL_TEST_CONTEXTS
+
+class TestContext;
+
+namespace detail {
+
+template<typename T>
+class TestContextRegistration;
+
+//constant initialized, so the access needs no guard
+inline TestContext*& currentTestContext(){
+    static thread_local TestContext* context = nullptr;
+    return context;
+}
+
+//binds a context to the calling thread for its lifetime, the previous one is restored afterwards
+class TestContextBinding {
+
+public:
+
+    explicit TestContextBinding(TestContext* c):previous(currentTestContext()){ currentTestContext() = c; }
+    ~TestContextBinding(){ currentTestContext() = previous; }
+
+private:
+
+    TestContextBinding(TestContextBinding const&) = delete;
+    TestContextBinding& operator=(TestContextBinding const&) = delete;
+
+    TestContext* previous;
+};
+
+//overrides the registered instance by nullptr within a context
+struct NoInstanceOverride{ constexpr NoInstanceOverride(){} };
+
+inline void* noInstanceOverride(){ return &constantStaticValue<NoInstanceOverride>(); }
+
+}
+
+
+//instances replaced by TestInstance while the context is bound to the registering thread are visible
+//only to the threads the context is bound to, so tests replacing the same type can run concurrently
+class TestContext {
+
+public:
+
+    //binds itself to the constructing thread until destruction, expects to be destructed on the same thread
+    TestContext():binding(this){}
+    ~TestContext(){ overrides.freeChunks(); }
+
+    //the context bound to the calling thread or nullptr
+    static TestContext* current(){ return detail::currentTestContext(); }
+
+    //the override of the type with the id or nullptr, lock-free
+    void* find(std::size_t id) const{
+        std::atomic<void*> const* o = overrides.find(id);
+        return o!=nullptr ? o->load(std::memory_order_acquire) : nullptr;
+    }
+
+private:
+
+    template<typename>
+    friend class detail::TestContextRegistration;
+
+    void* exchange(std::size_t id, void* o){ return overrides.at(id).exchange(o,std::memory_order_acq_rel); }
+
+    TestContext(TestContext const&) = delete;
+    TestContext& operator=(TestContext const&) = delete;
+
+    detail::TypeIdTable<std::atomic<void*>> overrides;
+    detail::TestContextBinding binding; //after the overrides
+};
+
+
+namespace detail {
+
+//the override of the context bound to the calling thread, nullptr if there is none
+inline void* testContextOverride(std::size_t id){
+    TestContext* c = currentTestContext();
+    return c!=nullptr ? c->find(id) : nullptr;
+}
+
+}
+
+#endif // GLOBAL_TEST_CONTEXTS
+
+} //global
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <type_traits>
+
+namespace global {
+
+//allows thread local instances of T if specialized to be true,
+//in that case instance<T>() checks for a thread local instance first
+template<typename T>
+struct ThreadLocalAccess : std::false_type {};
+
+//override by spcializing
+//template<> struct ThreadLocalAccess<A> : std::true_type {};
+
+
+namespace detail {
+
+template<typename T>
+struct ThreadLocalPointer{
+    static thread_local T* value;
+};
+
+template<typename T>
+thread_local T* ThreadLocalPointer<T>::value = nullptr;
+
+}
+} //global
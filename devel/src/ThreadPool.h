@@ -0,0 +1,77 @@
+#pragma once
+
+#include "SmallFunction.h"
+#include "Executor.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace global {
+
+
+//executes tasks on a fixed number of threads, the destructor
+//waits for all queued tasks to be finished
+class ThreadPool {
+
+public:
+
+    explicit ThreadPool(unsigned threadCount = defaultThreadCount()){
+        if (threadCount==0) threadCount = 1;
+        for(unsigned i = 0; i<threadCount; ++i) threads.emplace_back([this]{ work(); });
+    }
+
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for(auto& t:threads) t.join();
+    }
+
+    template<typename Func>
+    void execute(Func&& func){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back(bindTestContext(std::forward<Func>(func)));
+        }
+        condition.notify_one();
+    }
+
+    std::size_t threadCount() const{ return threads.size(); }
+
+    static unsigned defaultThreadCount(){ return std::thread::hardware_concurrency(); }
+
+private:
+
+    void work(){
+        for(;;) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock,[this]{ return stopping || !tasks.empty(); });
+                if (tasks.empty()) return; //stopping
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    using Task = detail::SmallFunction<void()>;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Task> tasks;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+
+}//global
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "NoHeap.h"
+#include "staticValue.h"
+#include "throwImpl.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+//maximum number of records per record type if GLOBAL_NO_HEAP is defined, i.e. of
+//threads at once using e.g. SwappableInstance::ReadSection
+#ifndef GLOBAL_THREAD_RECORD_CAPACITY
+#define GLOBAL_THREAD_RECORD_CAPACITY 16
+#endif
+
+namespace global {
+namespace detail {
+
+//per thread state which other threads need to scan, each record has its
+//own cache line so threads never write to a shared one
+struct alignas(64) ThreadRecord {
+    std::atomic<std::uint64_t> epoch{0}; //0 if not within a read section
+    std::atomic<bool> used{true};
+    ThreadRecord* next = nullptr;
+};
+
+
+//records are never freed but reused after their thread exits, Record needs
+//the members 'used' and 'next' like ThreadRecord
+template<typename Record = ThreadRecord>
+class ThreadRecords {
+
+public:
+
+    static Record* first(){ return head().load(std::memory_order_acquire); }
+
+    //number of records created so far, the highest number of threads using them at once
+    static std::size_t created(){ return pool().count.load(std::memory_order_relaxed); }
+
+    static Record& local(){
+        thread_local Owner owner;
+        return *owner.record;
+    }
+
+    //the record of the calling thread or nullptr if it has none yet, does not create one
+    static Record* localIfCreated(){ return current(); }
+
+private:
+
+    struct Owner{
+        Owner():record(acquire()){ current() = record; }
+        ~Owner(){
+            current() = nullptr;
+            record->used.store(false,std::memory_order_release);
+        }
+        Record* record;
+    };
+
+    //constant-initialized, so reading it does not construct the Owner
+    static Record*& current(){
+        thread_local Record* record = nullptr;
+        return record;
+    }
+
+    static std::atomic<Record*>& head(){ return constantStaticValue<std::atomic<Record*>>(); }
+
+    static Record* acquire(){
+
+        for(Record* r = first(); r!=nullptr; r = r->next) {
+            bool expected = false;
+            if (r->used.compare_exchange_strong(expected,true)) return r;
+        }
+
+        Record* r = new (allocate()) Record(); //zero initializes members without initializer
+        r->next = head().load(std::memory_order_relaxed);
+        while (!head().compare_exchange_weak(r->next,r)) {}
+        return r;
+    }
+
+#ifdef GLOBAL_NO_HEAP
+
+    struct Pool{
+        constexpr Pool():records{},count(0){}
+        typename std::aligned_storage<sizeof(Record), alignof(Record)>::type records[GLOBAL_THREAD_RECORD_CAPACITY];
+        std::atomic<std::size_t> count;
+    };
+
+    static void* allocate(){
+        const std::size_t i = pool().count.fetch_add(1,std::memory_order_relaxed);
+        if (i>=GLOBAL_THREAD_RECORD_CAPACITY) {
+            pool().count.fetch_sub(1,std::memory_order_relaxed);
+            detail::throwImpl(CapacityExceeded{});
+        }
+        return &pool().records[i];
+    }
+
+#else
+
+    struct Pool{
+        constexpr Pool():count(0){}
+        std::atomic<std::size_t> count;
+    };
+
+    static void* allocate(){
+        pool().count.fetch_add(1,std::memory_order_relaxed);
+
+        //operator new does not respect the alignment before c++17
+        auto raw = reinterpret_cast<std::uintptr_t>(::operator new(sizeof(Record)+alignof(Record)));
+        auto aligned = (raw + alignof(Record)-1) & ~std::uintptr_t(alignof(Record)-1);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+#endif // GLOBAL_NO_HEAP
+
+    static Pool& pool(){ return constantStaticValue<Pool>(); }
+};
+
+}
+} //global
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "TypeName.h"
+#include <atomic>
+#include <cstdint>
+
+#ifdef GLOBAL_TRACE
+#include <chrono>
+#include <mutex>
+#include <vector>
+#endif
+
+//define GLOBAL_TRACE for the whole program to record construction, registration, deferred
+//calls and destruction of instances, otherwise the trace points compile to nothing
+
+#if defined(GLOBAL_TRACE) && defined(GLOBAL_NO_HEAP)
+#error GLOBAL_TRACE records the events on the heap and cannot be combined with GLOBAL_NO_HEAP
+#endif
+
+namespace global {
+namespace detail {
+
+#ifdef GLOBAL_TRACE
+
+struct TraceEvent{
+    char const* what;
+    TypeName name;
+    std::uint64_t begin; //ns
+    std::uint64_t duration; //ns
+    unsigned thread;
+};
+
+class TraceLog {
+
+public:
+
+    void record(TraceEvent const& e){
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(e);
+    }
+
+    std::vector<TraceEvent> recorded(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return events;
+    }
+
+    void clear(){
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+    }
+
+private:
+
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+//never destructed, so destructions during static destruction can still be recorded
+inline TraceLog& traceLog(){
+    static TraceLog* log = new TraceLog;
+    return *log;
+}
+
+inline std::uint64_t traceNow(){
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+//small ids starting at 1 in the order threads record their first event
+inline unsigned traceThread(){
+    static std::atomic<unsigned> next{1};
+    thread_local unsigned id = next++;
+    return id;
+}
+
+inline void traceRecord(char const* what, TypeName name, std::uint64_t begin){
+    traceLog().record(TraceEvent{what,name,begin,traceNow()-begin,traceThread()});
+}
+
+//records the time from its construction to its destruction
+template<typename T>
+class TraceSpan {
+
+public:
+
+    explicit TraceSpan(char const* w):what(w),begin(traceNow()){}
+    ~TraceSpan(){ traceRecord(what,typeName<T>(),begin); }
+
+private:
+
+    TraceSpan(TraceSpan const&) = delete;
+    TraceSpan& operator=(TraceSpan const&) = delete;
+
+    char const* what;
+    std::uint64_t begin;
+};
+
+//base of an instance, records its construction and destruction
+template<typename T>
+class InstanceTrace {
+
+protected:
+
+    InstanceTrace():begin(traceNow()){}
+    ~InstanceTrace(){ traceRecord("destruct",typeName<T>(),begin); }
+
+    template<typename U>
+    U* constructed(U* u){ traceRecord("construct",typeName<T>(),begin); return u; }
+
+    void destructing(){ begin = traceNow(); }
+
+private:
+
+    std::uint64_t begin;
+};
+
+template<typename Stream>
+void writeTraceString(Stream& out, TypeName name){
+    for(std::size_t i = 0; i<name.size; ++i) {
+        const char c = name.data[i];
+        if (c=='"' || c=='\\') out << '\\';
+        out << c;
+    }
+}
+
+template<typename Stream>
+void writeTraceEvent(Stream& out, TraceEvent const& e){
+    out << "{\"name\":\"";
+    writeTraceString(out,e.name);
+    out << "\",\"cat\":\"" << e.what << "\",\"ph\":\"X\""
+        << ",\"ts\":" << e.begin/1000 << '.' << (e.begin%1000)/100 << (e.begin%100)/10 << e.begin%10
+        << ",\"dur\":" << e.duration/1000 << '.' << (e.duration%1000)/100 << (e.duration%100)/10 << e.duration%10
+        << ",\"pid\":1,\"tid\":" << e.thread << '}';
+}
+
+#else
+
+template<typename T>
+struct TraceSpan {
+    explicit TraceSpan(char const*){}
+};
+
+template<typename T>
+class InstanceTrace {
+
+protected:
+
+    template<typename U>
+    U* constructed(U* u){ return u; }
+
+    void destructing(){}
+};
+
+#endif // GLOBAL_TRACE
+
+}
+
+
+//writes the recorded events in the chrome trace event format, which can be opened
+//by chrome://tracing or perfetto, the trace is empty if GLOBAL_TRACE is not defined
+template<typename Stream>
+void writeTrace(Stream& out){
+    out << "{\"traceEvents\":[";
+#ifdef GLOBAL_TRACE
+    bool first = true;
+    for(auto const& e:detail::traceLog().recorded()) {
+        if (!first) out << ',';
+        first = false;
+        out << '\n';
+        detail::writeTraceEvent(out,e);
+    }
+#endif
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+inline void clearTrace(){
+#ifdef GLOBAL_TRACE
+    detail::traceLog().clear();
+#endif
+}
+
+
+} //global
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "InstanceRegistry.h"
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace global {
+
+//name of a type as written by the compiler, not null terminated
+struct TypeName{
+    char const* data;
+    std::size_t size;
+
+    std::string str() const{ return std::string(data,size); }
+};
+
+
+namespace detail {
+
+//returns the part of the signature between the first 'begin' and the last 'end'
+inline TypeName trimSignature(char const* signature, char const* begin, char const* end){
+
+    char const* first = std::strstr(signature,begin);
+    if (first==nullptr) return TypeName{signature,std::strlen(signature)};
+    first += std::strlen(begin);
+
+    const std::size_t endSize = std::strlen(end);
+    std::size_t size = std::strlen(first);
+    while (size>=endSize && std::strncmp(first+size-endSize,end,endSize)!=0) --size;
+    if (size<endSize) return TypeName{first,std::strlen(first)};
+
+    return TypeName{first,size-endSize};
+}
+
+//the type name within the signature returned by signature<T>()
+inline TypeName nameInSignature(char const* signature){
+#if defined(_MSC_VER) && !defined(__clang__)
+    return trimSignature(signature,"signature<",">(void)");
+#else
+    return trimSignature(signature,"T = ","]");
+#endif
+}
+
+}
+
+
+//works without rtti, e.g. "A" or "ns::B<int>"
+template<typename T>
+TypeName typeName(){ return detail::nameInSignature(detail::signature<T>()); }
+
+inline TypeName InstanceType::name() const{ return detail::nameInSignature(signatureOf()); }
+
+
+} //global
@@ -0,0 +1,12 @@
+#pragma once
+
+
+//defines COROUTINES_AVAILABLE if the compiler and the standard library support c++20 coroutines,
+//they can be manually disabled by defining 'COROUTINES_DISABLED'
+#ifndef COROUTINES_DISABLED
+    #if defined(__cpp_impl_coroutine) && defined(__has_include)
+        #if __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+            #define COROUTINES_AVAILABLE
+        #endif
+    #endif
+#endif // COROUTINES_DISABLED
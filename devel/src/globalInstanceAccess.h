@@ -0,0 +1,30 @@
+#pragma once
+
+//instance<T>() and the instance pointer only, without registrations, deferred calls, pins, executors
+//and startup
+
+
+#ifdef USE_SINGLE_HEADER
+
+#include "../../include/globalInstanceAccess.h"
+
+#else
+
+#include "exceptionsAvailableDetection.h"
+#include "coroutinesAvailableDetection.h"
+#include "staticValue.h"
+#include "throwImpl.h"
+#include "NullptrAccessHandler.h"
+#include "SpinLock.h"
+#include "NoHeap.h"
+#include "ThreadRecords.h"
+#include "ThreadLocalAccess.h"
+#include "PerCpuAccess.h"
+#include "LazyAccess.h"
+#include "InstanceRegistry.h"
+#include "TestContext.h"
+#include "AccessCounters.h"
+#include "InstancePointer.h"
+#include "instance.h"
+
+#endif // USE_SINGLE_HEADER
@@ -8,13 +8,28 @@
 
 #else
 
-#include "exceptionsAvailableDetection.h"
-#include "staticValue.h"
-#include "throwImpl.h"
-#include "NullptrAccessHandler.h"
+#include "globalInstanceAccess.h"
+#include "TypeName.h"
+#include "SmallFunction.h"
+#include "SmallVector.h"
+#include "Executor.h"
+#include "InstanceAwaiter.h"
+#include "Trace.h"
+#include "Freeze.h"
+#include "Pin.h"
+#include "InstanceSlot.h"
 #include "OptionalValue.h"
-#include "InstancePointer.h"
-#include "instance.h"
+#include "BatchingExecutor.h"
+#include "RegistrySnapshot.h"
+#include "AccessCountReport.h"
 #include "InstanceRegistration.h"
+#include "IndexSequence.h"
+#include "whenAllAvailable.h"
+#include "SwappableInstance.h"
+#include "LazyInstance.h"
+#include "KeyedInstance.h"
+#include "PerCpuInstance.h"
+#include "ThreadPool.h"
+#include "Startup.h"
 
 #endif // USE_SINGLE_HEADER
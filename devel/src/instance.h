@@ -2,19 +2,27 @@
 
 #include "staticValue.h"
 #include "InstancePointer.h"
+#include "InstanceRegistry.h"
 
 
 namespace global {
 
 
 template<typename T>
-detail::InstancePointer<T>& instance(){ return detail::staticValue<detail::InstancePointer<T>>();}
+detail::InstancePointer<T>& instance(){
+    (void)&detail::TypeIdRegistrar<T>::value; //enters T into the registry, generates no code here
+    return detail::constantStaticValue<detail::InstancePointer<T>>();
+}
 
 template<typename T>
-T& instanceRef(){ return *detail::staticValue<detail::InstancePointer<T>>(); }
+T& instanceRef(){ return *instance<T>(); }
 
 template<typename T>
-const T& instanceCRef(){ return *detail::staticValue<detail::InstancePointer<T>>(); }
+const T& instanceCRef(){ return *instance<T>(); }
+
+//expects freeze() to be called, compiles to a single load if NDEBUG is defined
+template<typename T>
+T& frozenInstance(){ return instance<T>().unchecked(); }
 
 
 } //global
@@ -1,12 +1,43 @@
 HEADERS += \
     $$PWD/instance.h \
+    $$PWD/IndexSequence.h \
     $$PWD/InstanceRegistration.h \
+    $$PWD/whenAllAvailable.h \
     $$PWD/staticValue.h \
     $$PWD/NullptrAccessHandler.h \
     $$PWD/OptionalValue.h \
+    $$PWD/SpinLock.h \
+    $$PWD/SmallFunction.h \
+    $$PWD/SmallVector.h \
+    $$PWD/NoHeap.h \
+    $$PWD/ThreadLocalAccess.h \
+    $$PWD/PerCpuAccess.h \
+    $$PWD/LazyAccess.h \
+    $$PWD/Executor.h \
+    $$PWD/BatchingExecutor.h \
+    $$PWD/InstanceAwaiter.h \
+    $$PWD/TypeName.h \
+    $$PWD/Trace.h \
+    $$PWD/InstanceRegistry.h \
+    $$PWD/TestContext.h \
+    $$PWD/Freeze.h \
+    $$PWD/RegistrySnapshot.h \
+    $$PWD/ThreadRecords.h \
+    $$PWD/Pin.h \
+    $$PWD/AccessCounters.h \
+    $$PWD/AccessCountReport.h \
     $$PWD/InstancePointer.h \
+    $$PWD/InstanceSlot.h \
+    $$PWD/SwappableInstance.h \
+    $$PWD/LazyInstance.h \
+    $$PWD/KeyedInstance.h \
+    $$PWD/PerCpuInstance.h \
+    $$PWD/ThreadPool.h \
+    $$PWD/Startup.h \
     $$PWD/globalInstances.h \
+    $$PWD/globalInstanceAccess.h \
     $$PWD/throwImpl.h \
-    $$PWD/exceptionsAvailableDetection.h
+    $$PWD/exceptionsAvailableDetection.h \
+    $$PWD/coroutinesAvailableDetection.h
 
 SOURCES +=
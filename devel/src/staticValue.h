@@ -9,6 +9,20 @@ T& staticValue(){
     return t;
 }
 
+//T needs a constexpr default constructor, then the value is constant-initialized
+//and the access needs no guard for thread-safe static initialization
+template<typename T>
+struct ConstantStaticValue{
+    static T value;
+};
+
+template<typename T>
+T ConstantStaticValue<T>::value;
+
+template<typename T>
+T& constantStaticValue(){
+    return ConstantStaticValue<T>::value;
 }
-} //global
 
+}
+} //global
@@ -1,8 +1,11 @@
 #pragma once
 
-#include <cstdlib> //for exit(1);
 #include "exceptionsAvailableDetection.h"
 
+#ifdef EXCEPTIONS_DISABLED
+#include <cstdlib> //for exit(1);
+#endif
+
 namespace global {
 namespace detail {
 
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "IndexSequence.h"
+#include "SpinLock.h"
+#include "instance.h"
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+namespace global {
+namespace detail {
+
+//shared by the deferred calls of all instances waited for, counts the missing ones
+template<typename Func, typename... Ts>
+class WhenAll : public std::enable_shared_from_this<WhenAll<Func, Ts...>> {
+
+    using Indices = typename MakeIndexSequence<sizeof...(Ts)>::type;
+
+    template<std::size_t I>
+    using Type = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+public:
+
+    explicit WhenAll(Func f):func(std::move(f)){}
+
+    void start(){
+        if (missing==0) { done = true; call(Indices{}); return; }
+        armAll(Indices{});
+    }
+
+private:
+
+    template<std::size_t... I>
+    void armAll(IndexSequence<I...>){
+        int expand[] = {0, (arm<I>(),0)...};
+        (void)expand;
+    }
+
+    template<std::size_t I>
+    void arm(){
+        auto self = this->shared_from_this();
+        instance<Type<I>>().ifAvailable([self](Type<I>& t){ self->template available<I>(t); });
+    }
+
+    //nothing is queued for deregistrations, instead the instances which arrived earlier are
+    //checked to be still registered once the last one arrives, and waited for again if not
+    template<std::size_t I>
+    void available(Type<I>&){
+        bool rearm[sizeof...(Ts)] = {};
+        {
+            SpinLockGuard guard(lock);
+            if (done || --missing!=0) return;
+            collectAll(rearm,Indices{});
+            done = missing==0;
+        }
+
+        if (done) { call(Indices{}); return; }
+        rearmAll(rearm,Indices{});
+    }
+
+    template<std::size_t... I>
+    void collectAll(bool* rearm, IndexSequence<I...>){
+        int expand[] = {0, (collect<I>(rearm[I]),0)...};
+        (void)expand;
+    }
+
+    //takes the instance seen by the calling thread, including thread local and test context overrides,
+    //which is also the one ifAvailable() calls with, so an instance found by it is never waited for again
+    template<std::size_t I>
+    void collect(bool& rearm){
+        Type<I>* t = instance<Type<I>>().get();
+        std::get<I>(instances) = t;
+        rearm = t==nullptr;
+        if (rearm) ++missing;
+    }
+
+    template<std::size_t... I>
+    void rearmAll(bool const* rearm, IndexSequence<I...>){
+        int expand[] = {0, (rearm[I] ? arm<I>() : void(),0)...};
+        (void)expand;
+    }
+
+    template<std::size_t... I>
+    void call(IndexSequence<I...>){ func(*std::get<I>(instances)...); }
+
+    Func func;
+    std::tuple<Ts*...> instances;
+    std::size_t missing = sizeof...(Ts);
+    bool done = false;
+    SpinLock lock;
+};
+
+}
+
+
+//calls func(A&, B&, ...) once when the last of the instances is registered,
+//waits again for an instance which is deregistered before that
+template<typename... Ts, typename Func>
+void whenAllAvailable(Func func){
+#ifdef GLOBAL_NO_HEAP
+    static_assert(sizeof(Func)==0, "GLOBAL_NO_HEAP: whenAllAvailable allocates its shared state");
+#endif
+    std::make_shared<detail::WhenAll<Func, Ts...>>(std::move(func))->start();
+}
+
+
+} //global
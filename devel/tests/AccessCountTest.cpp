@@ -0,0 +1,86 @@
+#include "AccessCountTest.h"
+#include <src/globalInstances.h>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+namespace {
+
+template<typename T>
+AccessCount countOf(){
+    for(auto const& c:accessCounts()) if (c.id==typeId<T>()) return c;
+    return AccessCount{typeName<T>(),typeId<T>(),0,0};
+}
+
+}
+
+AccessCountTest::AccessCountTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void AccessCountTest::accessesAreCountedPerType()
+{
+#ifdef GLOBAL_COUNT_ACCESSES
+    struct A{ int i = 0; };
+    struct B{ int i = 0; };
+
+    Instance<A> a;
+    Instance<B> b;
+
+    for(int i = 0; i<3; ++i) instance<A>()->i++;
+    (*instance<B>()).i++;
+
+    QCOMPARE(countOf<A>().accesses,static_cast<std::uint64_t>(3));
+    QCOMPARE(countOf<B>().accesses,static_cast<std::uint64_t>(1));
+    QCOMPARE(countOf<A>().nullAccesses,static_cast<std::uint64_t>(0));
+#else
+    QSKIP("skipped since GLOBAL_COUNT_ACCESSES is not defined", SkipAll);
+#endif
+}
+
+void AccessCountTest::nullAccessesAreCounted()
+{
+#if defined(GLOBAL_COUNT_ACCESSES) && defined(__cpp_exceptions)
+    struct A{ int i = 0; };
+
+    try { instance<A>()->i++; } catch(NullptrAccess&) {}
+
+    QCOMPARE(countOf<A>().accesses,static_cast<std::uint64_t>(1));
+    QCOMPARE(countOf<A>().nullAccesses,static_cast<std::uint64_t>(1));
+#else
+    QSKIP("skipped since GLOBAL_COUNT_ACCESSES is not defined or exceptions are disabled", SkipAll);
+#endif
+}
+
+void AccessCountTest::accessesOfAllThreadsAreSummed()
+{
+#ifdef GLOBAL_COUNT_ACCESSES
+    struct A{ std::atomic<int> i{0}; };
+
+    Instance<A> a;
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t<4; ++t) threads.emplace_back([]{ for(int i = 0; i<1000; ++i) instance<A>()->i++; });
+    for(auto& t:threads) t.join();
+
+    QCOMPARE(countOf<A>().accesses,static_cast<std::uint64_t>(4000));
+#else
+    QSKIP("skipped since GLOBAL_COUNT_ACCESSES is not defined", SkipAll);
+#endif
+}
+
+void AccessCountTest::countsAreEmptyWithoutCounting()
+{
+#ifndef GLOBAL_COUNT_ACCESSES
+    struct A{ int i = 0; };
+
+    Instance<A> a;
+    instance<A>()->i++;
+
+    QCOMPARE(accessCounts().empty(),true);
+#else
+    QSKIP("skipped since GLOBAL_COUNT_ACCESSES is defined", SkipAll);
+#endif
+}
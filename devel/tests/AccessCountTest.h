@@ -0,0 +1,24 @@
+#ifndef ACCESSCOUNTTEST_H
+#define ACCESSCOUNTTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class AccessCountTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AccessCountTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void accessesAreCountedPerType();
+    void nullAccessesAreCounted();
+    void accessesOfAllThreadsAreSummed();
+    void countsAreEmptyWithoutCounting();
+
+};
+
+#endif // ACCESSCOUNTTEST_H
@@ -0,0 +1,172 @@
+#include "AllocationTest.h"
+#include "operatorNew.h"
+#include <src/globalInstances.h>
+
+//enforces the claims of the readme section "Use on Embedded Devices": after startup neither
+//accesses nor deferred calls with small callables allocate or free
+//
+//GLOBAL_TRACE is exempt, it is a diagnostic build which appends every event to a growing
+//std::vector, so whether a trace point allocates depends on the events recorded before and
+//there is no per-operation budget to check
+
+using namespace global;
+
+namespace {
+struct A{ virtual ~A(){} virtual int foo(){ return 1; } };
+struct MockA : A{ int foo() override{ return 2; } };
+
+struct alignas(64) Overaligned{ char c[64]; };
+
+//keeps the compiler from eliding the allocations
+void* volatile escaped = nullptr;
+
+template<typename T>
+T* escape(T* p){ escaped = p; return static_cast<T*>(escaped); }
+
+#ifndef GLOBAL_TRACE
+bool noAllocation(AllocationCounts const& c){ return c.allocations==0 && c.frees==0 && c.bytes==0; }
+#endif
+}
+
+AllocationTest::AllocationTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void AllocationTest::everyVariantIsRecorded()
+{
+    const AllocationCounts single = countAllocations([]{ delete escape(new int(1)); });
+    QCOMPARE(single.allocations,1);
+    QCOMPARE(single.frees,1);
+    QCOMPARE(single.bytes,sizeof(int));
+
+    const AllocationCounts array = countAllocations([]{ delete[] escape(new char[10]); });
+    QCOMPARE(array.allocations,1);
+    QCOMPARE(array.frees,1);
+    QCOMPARE(array.bytes,static_cast<std::size_t>(10));
+
+    const AllocationCounts nothrow = countAllocations([]{ delete escape(new (std::nothrow) int(1)); });
+    QCOMPARE(nothrow.allocations,1);
+    QCOMPARE(nothrow.nothrow,1);
+
+#ifdef __cpp_aligned_new
+    const AllocationCounts aligned = countAllocations([]{ delete escape(new Overaligned); });
+    QCOMPARE(aligned.allocations,1);
+    QCOMPARE(aligned.aligned,1);
+    QCOMPARE(aligned.frees,1);
+#endif
+}
+
+void AllocationTest::accessDoesNotAllocate()
+{
+#ifdef GLOBAL_TRACE
+    QSKIP("skipped since GLOBAL_TRACE records on the heap", SkipAll);
+#else
+    Instance<A> a;
+    instance<A>()->foo(); //the first access of a thread might create its access counters
+
+    int sum = 0;
+    const AllocationCounts c = countAllocations([&sum]{
+        sum += instance<A>()->foo();
+        sum += (*instance<A>()).foo();
+        sum += instanceRef<A>().foo();
+        sum += instance<A>() ? 1 : 0;
+    });
+
+    QCOMPARE(sum,4);
+    QVERIFY(noAllocation(c));
+#endif
+}
+
+void AllocationTest::ifAvailableOnAvailableDoesNotAllocate()
+{
+#ifdef GLOBAL_TRACE
+    QSKIP("skipped since GLOBAL_TRACE records on the heap", SkipAll);
+#else
+    Instance<A> a;
+
+    int x = 0, y = 0, z = 0;
+    const AllocationCounts c = countAllocations([&]{
+        instance<A>().ifAvailable([&x,&y,&z](A&){ ++x; ++y; ++z; });
+    });
+
+    QCOMPARE(x,1);
+    QVERIFY(noAllocation(c));
+#endif
+}
+
+void AllocationTest::ifAvailableOnUnavailableDoesNotAllocate()
+{
+#ifdef GLOBAL_TRACE
+    QSKIP("skipped since GLOBAL_TRACE records on the heap", SkipAll);
+#else
+    struct B{};
+
+    B b;
+    int x = 0, y = 0, z = 0;
+    const AllocationCounts c = countAllocations([&]{
+        for(std::size_t i = 0; i<DeferredCallCapacity<B>::value; ++i)
+            instance<B>().ifAvailable([&x,&y,&z](B&){ ++x; ++y; ++z; });
+        detail::InstanceRegistration<B> registration(&b); //executes the queued calls
+    });
+
+    QCOMPARE(x,static_cast<int>(DeferredCallCapacity<B>::value));
+    QVERIFY(noAllocation(c));
+#endif
+}
+
+void AllocationTest::becomesUnavailableDoesNotAllocate()
+{
+#ifdef GLOBAL_TRACE
+    QSKIP("skipped since GLOBAL_TRACE records on the heap", SkipAll);
+#else
+    struct C{};
+
+    C c;
+    int x = 0, y = 0, z = 0;
+    const AllocationCounts counts = countAllocations([&]{
+        detail::InstanceRegistration<C> registration(&c);
+        for(std::size_t i = 0; i<DeferredCallCapacity<C>::value; ++i)
+            instance<C>().becomesUnavailable([&x,&y,&z](C&){ ++x; ++y; ++z; });
+    });
+
+    QCOMPARE(x,static_cast<int>(DeferredCallCapacity<C>::value));
+    QVERIFY(noAllocation(counts));
+#endif
+}
+
+void AllocationTest::registrationDoesNotAllocate()
+{
+#ifdef GLOBAL_TRACE
+    QSKIP("skipped since GLOBAL_TRACE records on the heap", SkipAll);
+#else
+    const AllocationCounts c = countAllocations([]{
+        Instance<A> a;
+        detail::ReplacingInstanceRegistration<A> unset(nullptr);
+    });
+
+    QVERIFY(noAllocation(c));
+#endif
+}
+
+void AllocationTest::nestedTestInstancesDoNotAllocate()
+{
+#ifdef GLOBAL_TRACE
+    QSKIP("skipped since GLOBAL_TRACE records on the heap", SkipAll);
+#else
+    Instance<A> a;
+
+    int seen = 0;
+    const AllocationCounts c = countAllocations([&seen]{
+        TestInstance<A,MockA> outer;
+        {
+            TestInstance<A> inner;
+            seen += instance<A>()->foo();
+        }
+        seen += 10*instance<A>()->foo();
+    });
+
+    QCOMPARE(seen,21);
+    QVERIFY(noAllocation(c));
+#endif
+}
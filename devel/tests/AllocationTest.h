@@ -0,0 +1,27 @@
+#ifndef ALLOCATIONTEST_H
+#define ALLOCATIONTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class AllocationTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AllocationTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void everyVariantIsRecorded();
+    void accessDoesNotAllocate();
+    void ifAvailableOnAvailableDoesNotAllocate();
+    void ifAvailableOnUnavailableDoesNotAllocate();
+    void becomesUnavailableDoesNotAllocate();
+    void registrationDoesNotAllocate();
+    void nestedTestInstancesDoNotAllocate();
+
+};
+
+#endif // ALLOCATIONTEST_H
@@ -0,0 +1,155 @@
+#include "CoroutineTest.h"
+#include "operatorNew.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+using namespace global;
+
+#ifdef COROUTINES_AVAILABLE
+
+namespace {
+
+//starts immediately and destroys itself when finished
+struct Task{
+    struct promise_type{
+        Task get_return_object(){ return {}; }
+        std::suspend_never initial_suspend(){ return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void(){}
+        void unhandled_exception(){ std::terminate(); }
+    };
+};
+
+struct A{ int v = 3; };
+
+Task awaitAvailable(int& result){
+    A& a = co_await instance<A>().available();
+    result = a.v;
+}
+
+Task awaitUnavailable(int& count){
+    co_await instance<A>().unavailable();
+    ++count;
+}
+
+Task awaitAvailableCounted(std::atomic<int>& result){
+    A& a = co_await instance<A>().available();
+    result += a.v;
+}
+
+Task awaitAvailableOn(ThreadPool& pool, std::atomic<std::thread::id>& resumedOn){
+    co_await instance<A>().available(pool);
+    resumedOn = std::this_thread::get_id();
+}
+
+}
+
+#endif // COROUTINES_AVAILABLE
+
+CoroutineTest::CoroutineTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void CoroutineTest::awaitingRegisteredInstanceDoesNotSuspend()
+{
+#ifdef COROUTINES_AVAILABLE
+    Instance<A> a;
+
+    int result = 0;
+    awaitAvailable(result);
+    QCOMPARE(result,3);
+#else
+    QSKIP("skipped since coroutines are not available", SkipAll);
+#endif
+}
+
+void CoroutineTest::awaitingResumesOnRegistration()
+{
+#ifdef COROUTINES_AVAILABLE
+    int result = 0;
+    awaitAvailable(result);
+    QCOMPARE(result,0);
+
+    Instance<A> a;
+    QCOMPARE(result,3);
+#else
+    QSKIP("skipped since coroutines are not available", SkipAll);
+#endif
+}
+
+void CoroutineTest::awaitingUnavailableResumesOnDeregistration()
+{
+#ifdef COROUTINES_AVAILABLE
+    int count = 0;
+    {
+        Instance<A> a;
+        awaitUnavailable(count);
+        QCOMPARE(count,0);
+    }
+    QCOMPARE(count,1);
+#else
+    QSKIP("skipped since coroutines are not available", SkipAll);
+#endif
+}
+
+void CoroutineTest::coroutineIsResumedOnExecutor()
+{
+#ifdef COROUTINES_AVAILABLE
+    std::atomic<std::thread::id> resumedOn{std::thread::id()};
+    {
+        ThreadPool pool(1);
+        awaitAvailableOn(pool,resumedOn);
+
+        Instance<A> a;
+        while (resumedOn.load()==std::thread::id()) std::this_thread::yield();
+    }
+    QVERIFY(resumedOn.load()!=std::this_thread::get_id());
+#else
+    QSKIP("skipped since coroutines are not available", SkipAll);
+#endif
+}
+
+void CoroutineTest::suspendedCoroutineDoesNotInvokeOperatorNew()
+{
+#ifdef COROUTINES_AVAILABLE
+    int result = 0;
+    awaitAvailable(result); //allocates the coroutine frame only
+
+    const int newCountBefore = newCallCount();
+    {
+        Instance<A> a;
+    }
+
+    QCOMPARE(newCountBefore,newCallCount());
+    QCOMPARE(result,3);
+#else
+    QSKIP("skipped since coroutines are not available", SkipAll);
+#endif
+}
+
+void CoroutineTest::registrationWhileSuspendingResumesOnce()
+{
+#ifdef COROUTINES_AVAILABLE
+    for(int i = 0; i<200; ++i) {
+        std::atomic<bool> start{false};
+        std::atomic<int> result{0};
+
+        //registers while the coroutine decides whether to suspend, the resume might then run first
+        std::thread registering([&]{
+            while (!start.load()) {}
+            Instance<A> a;
+            while (result.load()==0) std::this_thread::yield();
+        });
+
+        start = true;
+        awaitAvailableCounted(result);
+        registering.join();
+        QCOMPARE(result.load(),3);
+    }
+#else
+    QSKIP("skipped since coroutines are not available", SkipAll);
+#endif
+}
@@ -0,0 +1,26 @@
+#ifndef COROUTINETEST_H
+#define COROUTINETEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class CoroutineTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CoroutineTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void awaitingRegisteredInstanceDoesNotSuspend();
+    void awaitingResumesOnRegistration();
+    void awaitingUnavailableResumesOnDeregistration();
+    void coroutineIsResumedOnExecutor();
+    void suspendedCoroutineDoesNotInvokeOperatorNew();
+    void registrationWhileSuspendingResumesOnce();
+
+};
+
+#endif // COROUTINETEST_H
@@ -0,0 +1,189 @@
+#include "ExecutorTest.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace global;
+
+ExecutorTest::ExecutorTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void ExecutorTest::inlineExecutorCallsDirectly()
+{
+    struct A{};
+
+    InlineExecutor inlineExecutor;
+    int calls = 0;
+    instance<A>().ifAvailable(inlineExecutor,[&calls](A&){ ++calls; });
+
+    Instance<A> a;
+    QCOMPARE(calls,1);
+
+    instance<A>().ifAvailable(inlineExecutor,[&calls](A&){ ++calls; });
+    QCOMPARE(calls,2);
+}
+
+void ExecutorTest::callsArePassedToTheExecutor()
+{
+    struct A{};
+
+    BatchingExecutor batch;
+    int available = 0;
+    std::atomic<int> unavailable{0};
+    instance<A>().ifAvailable(batch,[&available](A&){ ++available; });
+
+    std::atomic<bool> deregistered{false};
+    std::thread runner;
+
+    {
+        Instance<A> a;
+        QCOMPARE(available,0);
+        QCOMPARE(batch.pending(),static_cast<std::size_t>(1));
+
+        QCOMPARE(batch.run(),static_cast<std::size_t>(1));
+        QCOMPARE(available,1);
+
+        instance<A>().becomesUnavailable(batch,[&unavailable](A&){ ++unavailable; });
+
+        //the call is run by this thread or the runner, whichever takes it first
+        runner = std::thread([&]{ while (!deregistered) { batch.run(); std::this_thread::yield(); } });
+    }
+
+    QCOMPARE(unavailable.load(),1);
+    deregistered = true;
+    runner.join();
+}
+
+void ExecutorTest::unavailableCallsNotStartedAreCalledByTheDeregistration()
+{
+    struct A{};
+
+    BatchingExecutor batch; //run by this thread only after the deregistration
+    int unavailable = 0;
+
+    {
+        Instance<A> a;
+        instance<A>().becomesUnavailable(batch,[&unavailable](A&){ ++unavailable; });
+    }
+    QCOMPARE(unavailable,1);
+
+    QCOMPARE(batch.run(),static_cast<std::size_t>(1)); //does not call it again
+    QCOMPARE(unavailable,1);
+}
+
+void ExecutorTest::callIsSkippedIfInstanceIsDeregistered()
+{
+    struct A{};
+
+    BatchingExecutor batch;
+    int calls = 0;
+    instance<A>().ifAvailable(batch,[&calls](A&){ ++calls; });
+
+    {
+        Instance<A> a;
+    }
+
+    QCOMPARE(batch.run(),static_cast<std::size_t>(1));
+    QCOMPARE(calls,0);
+}
+
+void ExecutorTest::deregistrationWaitsForRunningCalls()
+{
+    struct A{ std::atomic<bool> used{false}; };
+
+    ThreadPool pool(1);
+    std::atomic<bool> started{false};
+    std::atomic<bool> finished{false};
+
+    instance<A>().ifAvailable(pool,[&](A& a){
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        a.used = true;
+        finished = true;
+    });
+
+    {
+        Instance<A> a;
+        while (!started) std::this_thread::yield();
+    }
+
+    QCOMPARE(finished.load(),true);
+}
+
+void ExecutorTest::deregistrationWaitsForUnavailableCalls()
+{
+    struct A{};
+
+    ThreadPool pool(1);
+    std::atomic<bool> finished{false};
+
+    {
+        Instance<A> a;
+        instance<A>().becomesUnavailable(pool,[&finished](A&){
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            finished = true;
+        });
+    }
+
+    QCOMPARE(finished.load(),true);
+}
+
+void ExecutorTest::restoringAfterAMockWaitsForRunningCalls()
+{
+    struct A{ virtual ~A(){} std::atomic<bool> used{false}; };
+    struct MockA : A{};
+
+    ThreadPool pool(1);
+    std::atomic<bool> started{false};
+    std::atomic<bool> finished{false};
+
+    Instance<A> real;
+    {
+        TestInstance<A,MockA> mock;
+        instance<A>().ifAvailable(pool,[&](A& a){
+            started = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            a.used = true;
+            finished = true;
+        });
+        while (!started) std::this_thread::yield();
+    } //restores real, the mock must not be destructed during the call
+
+    QCOMPARE(finished.load(),true);
+    QCOMPARE(instance<A>()->used.load(),false);
+}
+
+void ExecutorTest::manyWaitersAreSpreadOverThePool()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+
+    ThreadPool pool(4);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic<int> calls{0};
+
+    for(int i = 0; i<200; ++i)
+        instance<A>().ifAvailable(pool,[&](A&){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                threads.insert(std::this_thread::get_id());
+            }
+            ++calls;
+        });
+
+    Instance<A> a;
+    while (calls<200) std::this_thread::yield();
+
+    QCOMPARE(threads.size()>1,true);
+    QCOMPARE(threads.count(std::this_thread::get_id()),static_cast<std::size_t>(0));
+#endif
+}
@@ -0,0 +1,28 @@
+#ifndef EXECUTORTEST_H
+#define EXECUTORTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class ExecutorTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ExecutorTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void inlineExecutorCallsDirectly();
+    void callsArePassedToTheExecutor();
+    void unavailableCallsNotStartedAreCalledByTheDeregistration();
+    void callIsSkippedIfInstanceIsDeregistered();
+    void deregistrationWaitsForRunningCalls();
+    void deregistrationWaitsForUnavailableCalls();
+    void restoringAfterAMockWaitsForRunningCalls();
+    void manyWaitersAreSpreadOverThePool();
+
+};
+
+#endif // EXECUTORTEST_H
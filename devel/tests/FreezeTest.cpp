@@ -0,0 +1,211 @@
+#include "FreezeTest.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace global;
+
+namespace {
+
+//freeze() checks all types of the test program, most of which are not registered,
+//so only the types of a test are checked
+template<typename... Ts>
+struct FrozenScope{
+    FrozenScope(){ freeze<Ts...>(); }
+    ~FrozenScope(){ thaw(); }
+};
+
+struct DestructedWhileFrozen{};
+struct RegisteredDuringFreeze{};
+struct Lazy{};
+struct PerThread{};
+#ifndef GLOBAL_NO_HEAP
+struct KeyedDestructedWhileFrozen{};
+#endif
+
+int reportedDestructions = 0;
+std::atomic<int> destructionsDuringFreeze{0};
+
+}
+
+namespace global {
+template<> void onDeregistrationWhileFrozen<DestructedWhileFrozen>(){ ++reportedDestructions; }
+template<> void onDeregistrationWhileFrozen<RegisteredDuringFreeze>(){ ++destructionsDuringFreeze; }
+template<> struct LazyAccess<Lazy> : std::true_type {};
+template<> struct ThreadLocalAccess<PerThread> : std::true_type {};
+#ifndef GLOBAL_NO_HEAP
+template<> void onDeregistrationWhileFrozen<KeyedDestructedWhileFrozen>(){ ++reportedDestructions; }
+#endif
+}
+
+FreezeTest::FreezeTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void FreezeTest::frozenInstanceIsAccessible()
+{
+    struct A{ int i = 3; };
+
+    Instance<A> a;
+    {
+        FrozenScope<A> frozen;
+        QCOMPARE(global::frozen(),true);
+        QCOMPARE(frozenInstance<A>().i,3);
+        frozenInstance<A>().i = 4;
+    }
+
+    QCOMPARE(global::frozen(),false);
+    QCOMPARE(instance<A>()->i,4);
+}
+
+void FreezeTest::missingInstanceIsReportedOnFreeze()
+{
+#ifdef __cpp_exceptions
+    struct A{};
+    instance<A>(); //entered into the registry
+
+    try {
+        freeze();
+        QFAIL("");
+    }
+    catch(InstanceMissingOnFreeze&) {}
+
+    QCOMPARE(frozen(),false);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void FreezeTest::registrationWhileFrozenIsAnError()
+{
+#ifdef __cpp_exceptions
+    struct A{};
+
+    A a;
+    {
+        FrozenScope<> frozen;
+        try {
+            Instance<A> registered;
+            QFAIL("");
+        }
+        catch(RegistrationWhileFrozen&) {}
+    }
+
+    detail::InstanceRegistration<A> registration(&a); //allowed again
+    QCOMPARE(instance<A>()==&a,true);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void FreezeTest::destructionWhileFrozenIsReported()
+{
+    reportedDestructions = 0;
+    {
+        Instance<DestructedWhileFrozen> a;
+        freeze<DestructedWhileFrozen>();
+    } //the registration is destructed before thaw() and must not throw
+    thaw();
+
+    QCOMPARE(reportedDestructions,1);
+    QVERIFY(instance<DestructedWhileFrozen>()==nullptr); //deregistered anyway
+
+#ifndef GLOBAL_NO_HEAP
+    {
+        KeyedInstance<KeyedDestructedWhileFrozen> a("key");
+        freeze<>();
+    }
+    thaw();
+
+    QCOMPARE(reportedDestructions,2);
+    QCOMPARE(static_cast<bool>(instance<KeyedDestructedWhileFrozen>("key")),false);
+#endif
+}
+
+void FreezeTest::accessBeforeFreezeIsAnErrorInDebugBuilds()
+{
+#if defined(__cpp_exceptions) && !defined(NDEBUG)
+    struct A{};
+
+    Instance<A> a;
+    try {
+        frozenInstance<A>();
+        QFAIL("");
+    }
+    catch(RegistryNotFrozen&) {}
+#else
+    QSKIP("skipped due to disabled exceptions or NDEBUG", SkipAll);
+#endif
+}
+
+void FreezeTest::registrationWhileThawedDoesNotTakeTheFreezeLock()
+{
+    struct A{};
+
+    std::atomic<bool> registered{false};
+    std::thread registering;
+    {
+        detail::SpinLockGuard held(detail::frozenState().lock); //as if freeze() was running
+        registering = std::thread([&registered]{
+            Instance<A> a;
+            registered = true;
+        });
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!registered && std::chrono::steady_clock::now()<deadline) std::this_thread::yield();
+    }
+    registering.join();
+
+    QCOMPARE(registered.load(),true);
+}
+
+void FreezeTest::freezeSkipsLazyAndThreadLocalTypes()
+{
+    instance<Lazy>(); //entered into the registry without an instance
+    instance<PerThread>();
+
+    int required = 0;
+    forEachInstanceType([&required](InstanceType const& t){
+        if (t.id()==typeId<Lazy>() || t.id()==typeId<PerThread>() || t.id()==typeId<DestructedWhileFrozen>())
+            required += t.requiredOnFreeze() ? 1 : 0;
+    });
+    QCOMPARE(required,1);
+}
+
+void FreezeTest::freezeWaitsForRegistrationsInProgress()
+{
+#ifdef __cpp_exceptions
+    struct A{};
+
+    std::atomic<int> registered{0};
+    std::thread registering([&registered]{
+        for(;;) {
+            try {
+                Instance<RegisteredDuringFreeze> r;
+                ++registered;
+            }
+            catch(RegistrationWhileFrozen&) { return; }
+        }
+    });
+
+    Instance<A> a;
+    while (registered<100) std::this_thread::yield();
+    freeze<A>();
+    const int atFreeze = registered;
+    QCOMPARE(frozen(),true);
+    registering.join(); //stops at the first registration after the freeze
+
+    thaw();
+    QCOMPARE(frozen(),false);
+    QVERIFY(registered.load()<=atFreeze+1); //only a registration completed before the freeze can still count
+    QVERIFY(destructionsDuringFreeze.load()<=1);
+    QVERIFY(instance<RegisteredDuringFreeze>()==nullptr);
+
+    Instance<RegisteredDuringFreeze> again; //allowed after thaw()
+    QVERIFY(instance<RegisteredDuringFreeze>()!=nullptr);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
@@ -0,0 +1,28 @@
+#ifndef FREEZETEST_H
+#define FREEZETEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class FreezeTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FreezeTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void frozenInstanceIsAccessible();
+    void missingInstanceIsReportedOnFreeze();
+    void registrationWhileFrozenIsAnError();
+    void destructionWhileFrozenIsReported();
+    void registrationWhileThawedDoesNotTakeTheFreezeLock();
+    void freezeSkipsLazyAndThreadLocalTypes();
+    void freezeWaitsForRegistrationsInProgress();
+    void accessBeforeFreezeIsAnErrorInDebugBuilds();
+
+};
+
+#endif // FREEZETEST_H
@@ -1,6 +1,10 @@
 #include "InstanceTest.h"
 #include <src/globalInstances.h>
 #include "operatorNew.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 
 using namespace global;
 
@@ -320,7 +324,66 @@ void InstanceTest::operatorNewNotUsedOnFinishedFunctions()
 
     instance<A>().becomesUnavailable(noop);
 
-    QVERIFY(newCallCount()>=(newCountBefore+1));
+    QCOMPARE(newCountBefore,newCallCount());
+}
+
+void InstanceTest::operatorNewNotUsedOnQueuedFunctions()
+{
+    struct A{};
+
+    A a;
+    int x = 0, y = 0, z = 0;
+    auto typicalCapture = [&x,&y,&z](A&){ ++x; ++y; ++z; };
+
+    const int newCountBefore = newCallCount();
+
+    instance<A>().ifAvailable(typicalCapture);
+    instance<A>().becomesUnavailable(typicalCapture);
+    {
+        detail::InstanceRegistration<A> registration(&a);
+    }
+
+    QCOMPARE(newCountBefore,newCallCount());
+    QCOMPARE(x,2);
+}
+
+void InstanceTest::moveOnlyFunctionsCanBeQueued()
+{
+    struct A{};
+
+    A a;
+    int value = 0;
+
+    struct MoveOnly{
+        std::unique_ptr<int> p;
+        int& value;
+        void operator()(A&){ value = *p; }
+    };
+
+    instance<A>().ifAvailable(MoveOnly{std::unique_ptr<int>(new int(5)),value});
+
+    detail::InstanceRegistration<A> registration(&a);
+
+    QCOMPARE(value,5);
+}
+
+void InstanceTest::manyQueuedFunctionsAreCalledInOrder()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+
+    A a;
+    std::vector<int> calls;
+
+    for (int i = 0; i<100; ++i) instance<A>().ifAvailable([&calls,i](A&){ calls.push_back(i); });
+
+    detail::InstanceRegistration<A> registration(&a);
+
+    QCOMPARE(calls.size(),std::size_t{100});
+    for (int i = 0; i<100; ++i) QCOMPARE(calls[i],i);
+#endif
 }
 
 void InstanceTest::registeredInstanceAccessDoesNotInvokeOperatorNew()
@@ -357,3 +420,29 @@ void InstanceTest::unregisteredInstanceAccessDoesNotInvokeOperatorNew()
 #endif
 
 }
+
+void InstanceTest::ifAvailableIsCalledOnceWhenQueuedConcurrently()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+    A a;
+
+    constexpr int threadCount = 4;
+    constexpr int callsPerThread = 500;
+    std::atomic<int> callCount{0};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i<threadCount; ++i) threads.emplace_back([&]{
+        for (int j = 0; j<callsPerThread; ++j) instance<A>().ifAvailable([&](A&){ ++callCount; });
+    });
+
+    {
+        detail::InstanceRegistration<A> registration(&a);
+        for (auto& t:threads) t.join();
+    }
+
+    QCOMPARE(callCount.load(),threadCount*callsPerThread);
+#endif
+}
@@ -41,10 +41,15 @@ private slots:
     void instanceRefWorks();
 
     void operatorNewNotUsedOnFinishedFunctions();
+    void operatorNewNotUsedOnQueuedFunctions();
+    void moveOnlyFunctionsCanBeQueued();
+    void manyQueuedFunctionsAreCalledInOrder();
 
     void registeredInstanceAccessDoesNotInvokeOperatorNew();
     void unregisteredInstanceAccessDoesNotInvokeOperatorNew();
 
+    void ifAvailableIsCalledOnceWhenQueuedConcurrently();
+
 };
 
 #endif // INSTANCETEST_H
@@ -0,0 +1,181 @@
+#include "KeyedInstanceTest.h"
+#include "operatorNew.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+KeyedInstanceTest::KeyedInstanceTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void KeyedInstanceTest::instancesAreAccessibleByKey()
+{
+#ifndef GLOBAL_NO_HEAP
+    struct Tenant{ std::string name; Tenant(std::string n):name(n){} };
+
+    const std::string fromConfig = "blue";
+    {
+        KeyedInstance<Tenant> red("red","Red Ltd");
+        KeyedInstance<Tenant> blue(fromConfig,"Blue Inc");
+
+        QCOMPARE(instance<Tenant>("red")->name,std::string("Red Ltd"));
+        QCOMPARE((*instance<Tenant>(std::string("blue"))).name,std::string("Blue Inc"));
+        QCOMPARE(static_cast<bool>(instance<Tenant>("green")),false);
+        QCOMPARE(static_cast<bool>(instance<Tenant>()),false); //keyed instances are separate
+    }
+
+    QCOMPARE(static_cast<bool>(instance<Tenant>("red")),false);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#endif
+}
+
+void KeyedInstanceTest::integerAndStringKeysAreDistinct()
+{
+#ifndef GLOBAL_NO_HEAP
+    struct Shard{ int id; Shard(int i):id(i){} };
+
+    KeyedInstance<Shard> one(1,1);
+    KeyedInstance<Shard> oneString("1",2);
+    KeyedInstance<Shard> big(std::uint64_t(1) << 40,3);
+
+    QCOMPARE(instance<Shard>(1)->id,1);
+    QCOMPARE(instance<Shard>("1")->id,2);
+    QCOMPARE(instance<Shard>(std::uint64_t(1) << 40)->id,3);
+    QCOMPARE(static_cast<bool>(instance<Shard>(2)),false);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#endif
+}
+
+void KeyedInstanceTest::deferredCallsAreCalledPerKey()
+{
+#ifndef GLOBAL_NO_HEAP
+    struct A{ int id; A(int i):id(i){} };
+
+    int available = 0;
+    int unavailable = 0;
+    instance<A>(7).ifAvailable([&available](A& a){ available += a.id; });
+    instance<A>(8).ifAvailable([&available](A& a){ available += a.id; });
+
+    {
+        KeyedInstance<A> a7(7,7);
+        QCOMPARE(available,7);
+
+        instance<A>(7).ifAvailable([&available](A& a){ available += a.id; }); //called directly
+        QCOMPARE(available,14);
+
+        instance<A>(7).becomesUnavailable([&unavailable](A& a){ unavailable += a.id; });
+        QCOMPARE(unavailable,0);
+    }
+
+    QCOMPARE(unavailable,7);
+    QCOMPARE(available,14);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#endif
+}
+
+void KeyedInstanceTest::temporaryKeysOutliveTheirHandles()
+{
+#ifndef GLOBAL_NO_HEAP
+    struct A{ int id; A(int i):id(i){} };
+
+    int available = 0;
+    for(int id = 1; id<=2; ++id) {
+        auto shortKey = instance<A>(std::string("tenant-") + std::to_string(id));
+        shortKey.ifAvailable([&available](A& a){ available += a.id; });
+        auto longKey = instance<A>(std::string("tenant-with-a-name-longer-than-a-cell-") + std::to_string(id));
+        longKey.ifAvailable([&available](A& a){ available += a.id; });
+    }
+
+    KeyedInstance<A> a1(std::string("tenant-1"),1);
+    KeyedInstance<A> b2(std::string("tenant-with-a-name-longer-than-a-cell-2"),20);
+    QCOMPARE(available,21);
+
+    QCOMPARE(instance<A>("tenant-with-a-name-longer-than-a-cell-2")->id,20);
+    QCOMPARE(static_cast<bool>(instance<A>("tenant-2")),false);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#endif
+}
+
+void KeyedInstanceTest::secondRegistrationOfAKeyIsRejected()
+{
+#if defined(__cpp_exceptions) && !defined(GLOBAL_NO_HEAP)
+    struct A{};
+
+    KeyedInstance<A> a("a");
+    try {
+        KeyedInstance<A> b("a");
+        QFAIL("");
+    }
+    catch(InstanceReplacementNotAllowed&) {}
+
+    KeyedInstance<A> c("c");
+    QCOMPARE(static_cast<bool>(instance<A>("a")),true);
+#else
+    QSKIP("skipped due to disabled exceptions or GLOBAL_NO_HEAP", SkipAll);
+#endif
+}
+
+void KeyedInstanceTest::manyKeysAreFoundWithoutAllocation()
+{
+#ifndef GLOBAL_NO_HEAP
+    struct A{ int id; A(int i):id(i){} };
+
+    constexpr int count = 1000;
+    std::vector<std::unique_ptr<KeyedInstance<A>>> instances;
+    std::vector<std::string> names;
+    for(int i = 0; i<count; ++i) {
+        instances.emplace_back(new KeyedInstance<A>(i,i));
+        names.push_back("tenant" + std::to_string(i));
+    }
+
+    const int newCountBefore = newCallCount();
+    int wrong = 0;
+    for(int i = 0; i<count; ++i) {
+        if (instance<A>(i)->id!=i) ++wrong;
+        if (instance<A>(names[i].c_str())) ++wrong;
+    }
+    QCOMPARE(newCountBefore,newCallCount());
+    QCOMPARE(wrong,0);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#endif
+}
+
+void KeyedInstanceTest::concurrentLookupsSeeRegisteredKeys()
+{
+#ifndef GLOBAL_NO_HEAP
+    struct A{ int id; A(int i):id(i){} };
+
+    constexpr int count = 200;
+    std::atomic<int> registered{0};
+    std::atomic<int> wrong{0};
+
+    std::thread reader([&]{
+        while (registered<count) {
+            const int n = registered;
+            for(int i = 0; i<n; ++i) if (!instance<A>(i) || instance<A>(i)->id!=i) ++wrong;
+        }
+    });
+
+    std::vector<std::unique_ptr<KeyedInstance<A>>> instances;
+    for(int i = 0; i<count; ++i) {
+        instances.emplace_back(new KeyedInstance<A>(i,i));
+        ++registered;
+    }
+    reader.join();
+
+    QCOMPARE(wrong.load(),0);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#endif
+}
@@ -0,0 +1,27 @@
+#ifndef KEYEDINSTANCETEST_H
+#define KEYEDINSTANCETEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class KeyedInstanceTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit KeyedInstanceTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void instancesAreAccessibleByKey();
+    void integerAndStringKeysAreDistinct();
+    void deferredCallsAreCalledPerKey();
+    void temporaryKeysOutliveTheirHandles();
+    void secondRegistrationOfAKeyIsRejected();
+    void manyKeysAreFoundWithoutAllocation();
+    void concurrentLookupsSeeRegisteredKeys();
+
+};
+
+#endif // KEYEDINSTANCETEST_H
@@ -0,0 +1,193 @@
+#include "LazyInstanceTest.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+namespace {
+
+struct Value{ int v; Value(int v_):v(v_){} };
+
+int unusedConstructed = 0;
+struct Unused{ Unused(){ ++unusedConstructed; } };
+
+std::atomic<int> slowConstructed{0};
+struct Slow{
+    Slow(){ ++slowConstructed; std::this_thread::sleep_for(std::chrono::milliseconds(5)); }
+    int get() const{ return 1; }
+};
+
+struct Observed{};
+struct Declared{};
+
+#ifdef __cpp_exceptions
+int failingAttempts = 0;
+struct Failing{
+    std::string s;
+    Failing(std::string s_):s(std::move(s_)){ if (++failingAttempts==1) throw 1; }
+};
+#endif
+
+struct Contested{ virtual ~Contested(){} virtual int foo(){ return 1; } };
+struct Winner : Contested{ int foo() override{ return 2; } };
+
+Winner winner;
+detail::InstanceRegistration<Contested> winnerRegistration;
+int lateDestructed = 0;
+
+//registers another instance before the lazy one is registered, like a concurrent thread could
+struct Late : Contested{
+    Late(){ winnerRegistration.registerInstance(&winner); }
+    ~Late(){ ++lateDestructed; }
+};
+
+std::atomic<bool> blockingEntered{false};
+std::atomic<bool> blockingReleased{false};
+struct Blocking{
+    Blocking(){
+        blockingEntered = true;
+        while (!blockingReleased.load()) std::this_thread::yield();
+    }
+};
+
+}
+
+namespace global {
+template<> struct LazyAccess<Value> : std::true_type {};
+template<> struct LazyAccess<Unused> : std::true_type {};
+template<> struct LazyAccess<Slow> : std::true_type {};
+template<> struct LazyAccess<Observed> : std::true_type {};
+template<> struct LazyAccess<Declared> : std::true_type {};
+#ifdef __cpp_exceptions
+template<> struct LazyAccess<Failing> : std::true_type {};
+#endif
+template<> struct LazyAccess<Contested> : std::true_type {};
+template<> struct LazyAccess<Blocking> : std::true_type {};
+}
+
+LazyInstanceTest::LazyInstanceTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void LazyInstanceTest::instanceIsConstructedOnFirstAccess()
+{
+    LazyInstance<Value> a(5);
+    QCOMPARE(a.constructed(),false);
+    QCOMPARE(instance<Value>() ? true : false,false);
+
+    QCOMPARE(instance<Value>()->v,5);
+    QCOMPARE(a.constructed(),true);
+    QCOMPARE(instance<Value>() ? true : false,true);
+}
+
+void LazyInstanceTest::instanceIsNotConstructedWithoutAccess()
+{
+    {
+        LazyInstance<Unused> a;
+    }
+
+    QCOMPARE(unusedConstructed,0);
+    QCOMPARE(instance<Unused>() ? true : false,false);
+}
+
+void LazyInstanceTest::concurrentFirstAccessesConstructOnce()
+{
+    LazyInstance<Slow> a;
+
+    std::atomic<int> sum{0};
+    std::vector<std::thread> threads;
+    for(int t = 0; t<8; ++t) threads.emplace_back([&sum]{ sum += instance<Slow>()->get(); });
+    for(auto& t:threads) t.join();
+
+    QCOMPARE(slowConstructed.load(),1);
+    QCOMPARE(sum.load(),8);
+}
+
+void LazyInstanceTest::deferredCallsAreTriggered()
+{
+    int available = 0;
+    int unavailable = 0;
+
+    {
+        LazyInstance<Observed> a;
+        instance<Observed>().ifAvailable([&available](Observed&){ ++available; });
+        instance<Observed>().becomesUnavailable([&unavailable](Observed&){ ++unavailable; });
+        QCOMPARE(available,0);
+
+        *instance<Observed>();
+        QCOMPARE(available,1);
+        QCOMPARE(unavailable,0);
+    }
+
+    QCOMPARE(unavailable,1);
+}
+
+void LazyInstanceTest::secondDeclarationIsRejected()
+{
+#ifdef __cpp_exceptions
+    LazyInstance<Declared> a;
+    try {
+        LazyInstance<Declared> b;
+        QFAIL("");
+    }
+    catch(LazyInstanceAlreadyDeclared&) {}
+
+    *instance<Declared>(); //the first declaration is still in effect
+    QCOMPARE(a.constructed(),true);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void LazyInstanceTest::failedConstructionIsRetriedWithTheSameArguments()
+{
+#ifdef __cpp_exceptions
+    LazyInstance<Failing> a(std::string("arg"));
+    try {
+        *instance<Failing>();
+        QFAIL("");
+    }
+    catch(int) {}
+    QCOMPARE(a.constructed(),false);
+
+    QCOMPARE(instance<Failing>()->s,std::string("arg"));
+    QCOMPARE(failingAttempts,2);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void LazyInstanceTest::instanceRegisteredDuringConstructionIsReturned()
+{
+    LazyInstance<Contested,Late> a;
+    QCOMPARE(instance<Contested>()->foo(),2); //no InstanceReplacementNotAllowed
+    QCOMPARE(a.constructed(),false);
+    QCOMPARE(lateDestructed,1);
+
+    winnerRegistration.deregisterInstance();
+}
+
+void LazyInstanceTest::destructionWaitsForConstructionInProgress()
+{
+    std::unique_ptr<LazyInstance<Blocking>> a(new LazyInstance<Blocking>);
+    std::thread accessing([]{ instance<Blocking>().operator->(); });
+    while (!blockingEntered.load()) std::this_thread::yield();
+
+    std::atomic<bool> destructed{false};
+    std::thread destructing([&]{ a.reset(); destructed = true; });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    QCOMPARE(destructed.load(),false); //the construction still uses the LazyInstance
+
+    blockingReleased = true;
+    accessing.join();
+    destructing.join();
+    QCOMPARE(destructed.load(),true);
+    QCOMPARE(instance<Blocking>() ? true : false,false);
+}
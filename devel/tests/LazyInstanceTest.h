@@ -0,0 +1,28 @@
+#ifndef LAZYINSTANCETEST_H
+#define LAZYINSTANCETEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class LazyInstanceTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LazyInstanceTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void instanceIsConstructedOnFirstAccess();
+    void instanceIsNotConstructedWithoutAccess();
+    void concurrentFirstAccessesConstructOnce();
+    void deferredCallsAreTriggered();
+    void secondDeclarationIsRejected();
+    void failedConstructionIsRetriedWithTheSameArguments();
+    void instanceRegisteredDuringConstructionIsReturned();
+    void destructionWaitsForConstructionInProgress();
+
+};
+
+#endif // LAZYINSTANCETEST_H
@@ -0,0 +1,130 @@
+#include "NoHeapTest.h"
+#include "operatorNew.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+using namespace global;
+
+namespace {
+
+struct Wide{};
+struct Lazy{ int i = 0; };
+
+template<typename T>
+DeferredCallUsage usageOf(){
+    DeferredCallUsage u{0,0};
+    forEachInstanceType([&u](InstanceType const& t){ if (t.id()==typeId<T>()) u = t.deferredCalls(); });
+    return u;
+}
+
+}
+
+namespace global {
+template<> struct DeferredCallCapacity<Wide> : std::integral_constant<std::size_t, 8> {};
+template<> struct LazyAccess<Lazy> : std::true_type {};
+}
+
+NoHeapTest::NoHeapTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void NoHeapTest::highWatermarkIsReported()
+{
+    struct A{};
+
+    for(int i = 0; i<3; ++i) instance<A>().ifAvailable([](A&){});
+    {
+        Instance<A> a;
+        instance<A>().becomesUnavailable([](A&){});
+    }
+
+    QCOMPARE(usageOf<A>().highWatermark,static_cast<std::size_t>(3));
+    QCOMPARE(usageOf<A>().capacity,static_cast<std::size_t>(GLOBAL_DEFERRED_CALL_CAPACITY));
+
+    std::ostringstream out;
+    writeDeferredCallHighWatermarks(out);
+    QCOMPARE(out.str().find("3 " + std::to_string(GLOBAL_DEFERRED_CALL_CAPACITY) + " ")!=std::string::npos,true);
+}
+
+void NoHeapTest::capacityCanBeSetPerType()
+{
+    for(int i = 0; i<8; ++i) instance<Wide>().ifAvailable([](Wide&){});
+
+    int calls = 0;
+    instance<Wide>().becomesUnavailable([&calls](Wide&){ ++calls; });
+    {
+        Instance<Wide> w;
+    }
+
+    QCOMPARE(usageOf<Wide>().highWatermark,static_cast<std::size_t>(8));
+    QCOMPARE(usageOf<Wide>().capacity,static_cast<std::size_t>(8));
+    QCOMPARE(calls,1);
+}
+
+void NoHeapTest::exceedingTheCapacityIsAnError()
+{
+#if defined(GLOBAL_NO_HEAP) && defined(__cpp_exceptions)
+    struct A{};
+
+    int calls = 0;
+    for(int i = 0; i<GLOBAL_DEFERRED_CALL_CAPACITY; ++i) instance<A>().ifAvailable([&calls](A&){ ++calls; });
+
+    try {
+        instance<A>().ifAvailable([&calls](A&){ ++calls; });
+        QFAIL("");
+    }
+    catch(CapacityExceeded&) {}
+
+    Instance<A> a; //the queued calls are kept
+    QCOMPARE(calls,GLOBAL_DEFERRED_CALL_CAPACITY);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is not defined or exceptions are disabled", SkipAll);
+#endif
+}
+
+void NoHeapTest::nothingIsAllocatedAfterStartup()
+{
+#ifdef GLOBAL_NO_HEAP
+    struct A{ int i = 0; };
+    using B = Lazy;
+
+    int calls = 0;
+    int readerAllocations = -1;
+
+    const int newCountBefore = newCallCount();
+    {
+        for(int i = 0; i<GLOBAL_DEFERRED_CALL_CAPACITY; ++i) instance<A>().ifAvailable([&calls](A&){ ++calls; });
+        instance<B>().ifAvailable([&calls](B& b){ b.i = 1; ++calls; });
+
+        Instance<A> a;
+        LazyInstance<B> b;
+        instance<A>().becomesUnavailable([&calls](A&){ ++calls; });
+        instance<A>()->i++;
+        instance<B>()->i++;
+
+        InlineExecutor inlineExecutor;
+        instance<A>().ifAvailable(inlineExecutor,[&calls](A&){ ++calls; });
+    }
+    const int newCountAfter = newCallCount();
+
+    SwappableInstance<A> swappable;
+    std::thread reader([&readerAllocations]{
+        const int before = newCallCount();
+        {
+            ReadSection section; //takes a thread record from the static pool
+            instance<A>()->i++;
+        }
+        readerAllocations = newCallCount() - before;
+    });
+    reader.join();
+
+    QCOMPARE(newCountBefore,newCountAfter);
+    QCOMPARE(readerAllocations,0);
+    QCOMPARE(calls,GLOBAL_DEFERRED_CALL_CAPACITY+3);
+#else
+    QSKIP("skipped since GLOBAL_NO_HEAP is not defined", SkipAll);
+#endif
+}
@@ -0,0 +1,24 @@
+#ifndef NOHEAPTEST_H
+#define NOHEAPTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class NoHeapTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NoHeapTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void highWatermarkIsReported();
+    void capacityCanBeSetPerType();
+    void exceedingTheCapacityIsAnError();
+    void nothingIsAllocatedAfterStartup();
+
+};
+
+#endif // NOHEAPTEST_H
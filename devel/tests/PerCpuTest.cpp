@@ -0,0 +1,88 @@
+#include "PerCpuTest.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+namespace {
+struct Counter{ std::atomic<long> n{0}; };
+struct Start{ long n; explicit Start(long i):n(i){} };
+}
+
+namespace global {
+template<> struct PerCpuAccess<Counter> : std::true_type {};
+template<> struct PerCpuAccess<Start> : std::true_type {};
+}
+
+PerCpuTest::PerCpuTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void PerCpuTest::replicasAreReducedOverAllCpus()
+{
+    PerCpuInstance<Counter> counter;
+
+    constexpr int threadCount = 8;
+    constexpr int increments = 1000;
+    std::vector<std::thread> threads;
+    for(int i = 0; i<threadCount; ++i) threads.emplace_back([]{
+        for(int j = 0; j<increments; ++j) instance<Counter>()->n.fetch_add(1,std::memory_order_relaxed);
+    });
+    for(auto& t:threads) t.join();
+
+    const long sum = reduce<Counter>(0L,[](long s, Counter& c){ return s + c.n.load(); });
+    QCOMPARE(sum,static_cast<long>(threadCount*increments));
+    QCOMPARE(counter.size(),detail::possibleCpuCount()); //also the cpus which are offline or not usable
+    QVERIFY(counter.size()>=std::thread::hardware_concurrency());
+}
+
+void PerCpuTest::replicasAreCacheLineAligned()
+{
+    PerCpuInstance<Counter> counter;
+
+    std::set<std::uintptr_t> lines;
+    bool aligned = true;
+    forEachReplica<Counter>([&](Counter& c){
+        const auto address = reinterpret_cast<std::uintptr_t>(&c);
+        aligned = aligned && address%64==0;
+        lines.insert(address/64);
+    });
+
+    QCOMPARE(aligned,true);
+    QCOMPARE(lines.size(),counter.size());
+    QCOMPARE(lines.count(reinterpret_cast<std::uintptr_t>(static_cast<Counter*>(instance<Counter>()))/64),static_cast<std::size_t>(1));
+}
+
+void PerCpuTest::replicasAreConstructedFromTheArguments()
+{
+    {
+        PerCpuInstance<Start> start(5L);
+        QCOMPARE(reduce<Start>(0L,[](long s, Start& r){ return s + r.n; }),static_cast<long>(5*start.size()));
+    }
+
+    QCOMPARE(static_cast<bool>(instance<Start>()),false);
+    QCOMPARE(reduce<Start>(7L,[](long s, Start& r){ return s + r.n; }),7L);
+}
+
+void PerCpuTest::deferredCallsAreCalledWithAReplica()
+{
+    std::set<Counter*> replicas;
+    Counter* available = nullptr;
+    Counter* unavailable = nullptr;
+    instance<Counter>().ifAvailable([&available](Counter& c){ available = &c; });
+
+    {
+        PerCpuInstance<Counter> counter;
+        forEachReplica<Counter>([&replicas](Counter& c){ replicas.insert(&c); });
+        instance<Counter>().becomesUnavailable([&unavailable](Counter& c){ unavailable = &c; });
+        QCOMPARE(replicas.count(available),static_cast<std::size_t>(1));
+        QCOMPARE(unavailable==nullptr,true);
+    }
+
+    QCOMPARE(replicas.count(unavailable),static_cast<std::size_t>(1));
+}
@@ -0,0 +1,24 @@
+#ifndef PERCPUTEST_H
+#define PERCPUTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class PerCpuTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PerCpuTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void replicasAreReducedOverAllCpus();
+    void replicasAreCacheLineAligned();
+    void replicasAreConstructedFromTheArguments();
+    void deferredCallsAreCalledWithAReplica();
+
+};
+
+#endif // PERCPUTEST_H
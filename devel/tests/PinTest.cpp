@@ -0,0 +1,215 @@
+#include "PinTest.h"
+#include "operatorNew.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+namespace {
+struct A{ virtual ~A(){} virtual int foo(){ return 1; } };
+struct MockA : A{ int foo() override{ return 2; } };
+
+void waitFor(std::atomic<bool> const& flag){
+    while (!flag.load()) std::this_thread::yield();
+}
+}
+
+PinTest::PinTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void PinTest::pinOfUnregisteredInstanceIsNull()
+{
+    Pinned<A> p = instance<A>().pin();
+    QVERIFY(!p);
+    QVERIFY(p.get()==nullptr);
+}
+
+void PinTest::pinnedInstanceIsAccessible()
+{
+    Instance<A> a;
+    Pinned<A> p = instance<A>().pin();
+    QVERIFY(p);
+    QCOMPARE(p->foo(),1);
+    QCOMPARE((*p).foo(),1);
+    QVERIFY(instance<A>()==p.get());
+}
+
+void PinTest::pinsCanBeNestedAndMoved()
+{
+    Instance<A> a;
+    {
+        Pinned<A> p1 = instance<A>().pin();
+        Pinned<A> p2 = instance<A>().pin();
+        Pinned<A> p3 = std::move(p1);
+        QVERIFY(!p1);
+        QVERIFY(p2);
+        QCOMPARE(p3->foo(),1);
+
+        p2 = std::move(p3);
+        QVERIFY(!p3);
+        QCOMPARE(p2->foo(),1);
+        p2.unpin();
+        QVERIFY(!p2);
+    }
+
+    TestInstance<A,MockA> mock; //replacing needs all pins of this thread to be released
+    QCOMPARE(instance<A>().pin()->foo(),2);
+}
+
+void PinTest::deregistrationWaitsForPin()
+{
+    std::atomic<bool> registered{false};
+    std::atomic<bool> pinned{false};
+    std::atomic<bool> deregistered{false};
+
+    std::thread owner([&]{
+        {
+            Instance<A> a;
+            registered = true;
+            waitFor(pinned);
+        }
+        deregistered = true;
+    });
+
+    waitFor(registered);
+    Pinned<A> p = instance<A>().pin();
+    pinned = true;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    QCOMPARE(deregistered.load(),false);
+    QCOMPARE(p->foo(),1); //still alive
+
+    p.unpin();
+    owner.join();
+    QCOMPARE(deregistered.load(),true);
+    QVERIFY(!instance<A>().pin());
+}
+
+void PinTest::deregistrationWaitsForPinsOfAllThreads()
+{
+    constexpr int threadCount = 4;
+
+    std::unique_ptr<Instance<A>> a(new Instance<A>);
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> accessed{0};
+    std::atomic<int> failed{0};
+    std::vector<std::thread> readers;
+    for(int i = 0; i<threadCount; ++i) readers.emplace_back([&]{
+        while (!stop.load()) {
+            Pinned<A> p = instance<A>().pin();
+            if (!p) continue;
+            if (p->foo()!=1) ++failed; //would read a destructed instance
+            ++accessed;
+        }
+    });
+
+    for(int i = 0; i<100; ++i) {
+        while (accessed.load()<i*threadCount) std::this_thread::yield();
+        a.reset(); //waits for the pins before destructing
+        a.reset(new Instance<A>);
+    }
+
+    stop = true;
+    for(auto& t:readers) t.join();
+    QCOMPARE(failed.load(),0);
+}
+
+void PinTest::deregistrationOfOwnPinIsReported()
+{
+#ifdef __cpp_exceptions
+    Instance<A> a;
+    Pinned<A> p = instance<A>().pin();
+
+    try {
+        TestInstance<A,MockA> mock;
+        QFAIL("");
+    }
+    catch(DeregisteringPinnedInstance&) {}
+    QVERIFY(instance<A>()==p.get()); //left unchanged
+
+    p.unpin();
+    TestInstance<A,MockA> mock;
+    QCOMPARE(instance<A>()->foo(),2);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void PinTest::destructionWhilePinnedByTheSameThreadDoesNotWait()
+{
+#ifdef NDEBUG
+    Pinned<A> p;
+    {
+        Instance<A> a;
+        p = instance<A>().pin();
+    } //cannot throw, waiting for the own pin would never return
+
+    QVERIFY(instance<A>()==nullptr);
+#else
+    QSKIP("skipped since the destruction asserts if NDEBUG is not defined", SkipAll);
+#endif
+}
+
+void PinTest::deregistrationDoesNotCreatePinRecords()
+{
+    instance<A>().pin(); //pin records exist
+
+    bool created = true;
+    std::thread t([&created]{
+        {
+            Instance<A> a;
+        }
+        created = detail::ThreadRecords<detail::PinRecord>::localIfCreated()!=nullptr;
+    });
+    t.join();
+
+    QCOMPARE(created,false);
+}
+
+void PinTest::tooManyPinsAreReported()
+{
+#ifdef __cpp_exceptions
+    Instance<A> a;
+    Pinned<A> pins[GLOBAL_PINS_PER_THREAD];
+    for(auto& p:pins) p = instance<A>().pin();
+
+    try {
+        instance<A>().pin();
+        QFAIL("");
+    }
+    catch(TooManyPins&) {}
+
+    pins[0].unpin();
+    QVERIFY(instance<A>().pin());
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void PinTest::pinningDoesNotAllocate()
+{
+#ifdef GLOBAL_TRACE
+    QSKIP("skipped since GLOBAL_TRACE records on the heap", SkipAll);
+#else
+    Instance<A> a;
+    instance<A>().pin(); //the first pin of a thread creates its record
+
+    int sum = 0;
+    const AllocationCounts c = countAllocations([&sum]{
+        Pinned<A> p1 = instance<A>().pin();
+        Pinned<A> p2 = instance<A>().pin();
+        sum += p1->foo() + p2->foo();
+    });
+
+    QCOMPARE(sum,2);
+    QCOMPARE(c.allocations,0);
+    QCOMPARE(c.frees,0);
+#endif
+}
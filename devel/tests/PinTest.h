@@ -0,0 +1,30 @@
+#ifndef PINTEST_H
+#define PINTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class PinTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PinTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void pinOfUnregisteredInstanceIsNull();
+    void pinnedInstanceIsAccessible();
+    void pinsCanBeNestedAndMoved();
+    void deregistrationWaitsForPin();
+    void deregistrationWaitsForPinsOfAllThreads();
+    void deregistrationOfOwnPinIsReported();
+    void destructionWhilePinnedByTheSameThreadDoesNotWait();
+    void deregistrationDoesNotCreatePinRecords();
+    void tooManyPinsAreReported();
+    void pinningDoesNotAllocate();
+
+};
+
+#endif // PINTEST_H
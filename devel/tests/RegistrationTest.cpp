@@ -1,6 +1,17 @@
 #include "RegistrationTest.h"
 #include <src/globalInstances.h>
-#include <src/globalInstances.h>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+struct PerThread{ int id; PerThread(int i):id(i){} };
+}
+
+namespace global {
+template<> struct ThreadLocalAccess<PerThread> : std::true_type {};
+}
 
 RegistrationTest::RegistrationTest(QObject *parent) : QObject(parent)
 {
@@ -203,5 +214,126 @@ void RegistrationTest::privateConstructorsCanBeUsedWithMacro()
     global::Instance<AY> a;
 }
 
+void RegistrationTest::concurrentRegistrationIsRaceFree()
+{
+    struct A{ int x; };
+    A a{0};
+    A written[4] = {{1},{2},{3},{4}};
+    global::detail::InstanceRegistration<A> registration(&a);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> wrongValues{0};
+
+    std::thread reader([&]{
+        while (!done) {
+            const int x = global::instance<A>()->x;
+            if (x<0 || x>4) ++wrongValues;
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i<4; ++i) writers.emplace_back([&written,i]{
+        for (int j = 0; j<1000; ++j) {
+            global::detail::ReplacingInstanceRegistration<A> r(&written[i]);
+            std::this_thread::yield(); //lets the registrations of different writers end out of order
+        }
+    });
+
+    for (auto& w:writers) w.join();
+    done = true;
+    reader.join();
+
+    QCOMPARE(wrongValues.load(),0);
+    QVERIFY(static_cast<A*>(global::instance<A>())==&a); //no writer put back an instance of another one
+}
+
+void RegistrationTest::registrationEndingOutOfOrderIsHandedOver()
+{
+    struct A{};
+    A a, b, c;
+    global::detail::InstanceRegistration<A> registration(&a);
+
+    global::detail::ReplacingInstanceRegistration<A> replacing(&b);
+    global::detail::ReplacingInstanceRegistration<A> last(&c);
+
+    replacing.deregisterInstance(); //c stays registered and puts back a later on
+    QVERIFY(static_cast<A*>(global::instance<A>())==&c);
+
+    last.deregisterInstance();
+    QVERIFY(static_cast<A*>(global::instance<A>())==&a);
+}
 
+void RegistrationTest::concurrentExclusiveRegistrationAdmitsOnlyOne()
+{
+#ifdef __cpp_exceptions
+    struct A{};
+    A a;
 
+    std::atomic<int> registered{0};
+    std::atomic<int> rejected{0};
+    std::atomic<bool> release{false};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i<4; ++i) threads.emplace_back([&]{
+        try {
+            global::detail::InstanceRegistration<A> r(&a);
+            ++registered;
+            while (!release) {}
+        }
+        catch(global::InstanceReplacementNotAllowed const&){ ++rejected; }
+    });
+
+    while (registered+rejected<4 && rejected<3) {}
+    release = true;
+    for (auto& t:threads) t.join();
+
+    QVERIFY(registered>=1);
+    QCOMPARE(registered+rejected,4);
+    QVERIFY(global::instance<A>()==nullptr);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void RegistrationTest::threadLocalInstanceIsVisibleOnlyToItsThread()
+{
+    global::Instance<PerThread> shared(1);
+    global::ThreadLocalInstance<PerThread> local(2);
+
+    int otherThreadId = 0;
+    std::thread t([&]{ otherThreadId = global::instance<PerThread>()->id; });
+    t.join();
+
+    QCOMPARE(global::instance<PerThread>()->id,2);
+    QCOMPARE(otherThreadId,1);
+}
+
+void RegistrationTest::threadLocalInstanceFallsBackToGlobalInstance()
+{
+    global::Instance<PerThread> shared(1);
+    {
+        global::ThreadLocalInstance<PerThread> local(2);
+        {
+            global::ThreadLocalInstance<PerThread> nested(3);
+            QCOMPARE(global::instance<PerThread>()->id,3);
+        }
+        QCOMPARE(global::instance<PerThread>()->id,2);
+    }
+    QCOMPARE(global::instance<PerThread>()->id,1);
+}
+
+void RegistrationTest::instanceAddsOnlyTwoPointers()
+{
+    struct A{ void* p = nullptr; };
+
+    QCOMPARE(std::is_polymorphic<global::detail::InstanceRegistration<A>>::value,false);
+    QCOMPARE(std::is_polymorphic<global::detail::ReplacingInstanceRegistration<A>>::value,false);
+    QCOMPARE(sizeof(global::detail::InstanceRegistration<A>),2*sizeof(void*)); //replaced instance and registration below
+    QCOMPARE(sizeof(global::detail::ThreadLocalInstanceRegistration<PerThread>),sizeof(void*));
+#ifndef GLOBAL_TRACE
+    QCOMPARE(sizeof(global::Instance<A>),sizeof(A)+2*sizeof(void*));
+#endif
+#if !defined(GLOBAL_TRACE) && !defined(GLOBAL_TEST_CONTEXTS)
+    QCOMPARE(sizeof(global::TestInstance<A>),sizeof(A)+2*sizeof(void*)); //remembers its context otherwise
+#endif
+}
@@ -36,6 +36,15 @@ private slots:
     void privateConstructorsCanBeUsed();
     void privateConstructorsCanBeUsedWithMacro();
 
+    void concurrentRegistrationIsRaceFree();
+    void registrationEndingOutOfOrderIsHandedOver();
+    void concurrentExclusiveRegistrationAdmitsOnlyOne();
+
+    void threadLocalInstanceIsVisibleOnlyToItsThread();
+    void threadLocalInstanceFallsBackToGlobalInstance();
+
+    void instanceAddsOnlyTwoPointers();
+
 
 };
 
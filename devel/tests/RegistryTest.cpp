@@ -0,0 +1,209 @@
+#include "RegistryTest.h"
+#include <src/globalInstances.h>
+#include <memory>
+#include <set>
+
+using namespace global;
+
+namespace {
+
+struct Listed{};
+struct Unlisted{};
+
+template<typename T>
+struct Tagged{};
+
+std::size_t unregisteredCount(){
+    std::size_t count = 0;
+    forEachInstanceType([&count](InstanceType const& t){ if (!t.registered()) ++count; });
+    return count;
+}
+
+}
+
+RegistryTest::RegistryTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void RegistryTest::accessedTypesHaveDenseIds()
+{
+    struct A{};
+    struct B{};
+    struct C{};
+
+    instance<A>();
+    instance<B>();
+    instance<C>();
+
+    std::set<std::size_t> ids{typeId<A>(),typeId<B>(),typeId<C>()};
+    QCOMPARE(ids.size(),static_cast<std::size_t>(3));
+    QVERIFY(*ids.rbegin()<instanceTypeCount());
+    QCOMPARE(typeId<A>(),typeId<A>());
+}
+
+void RegistryTest::accessedTypesAreEnumerated()
+{
+    if (false) instance<Listed>(); //never called, entered during static initialization anyway
+
+    int listed = 0;
+    std::size_t expectedId = 0;
+    bool idsInOrder = true;
+    forEachInstanceType([&](InstanceType const& t){
+        if (t.name().str()=="{anonymous}::Listed" || t.name().str()=="(anonymous namespace)::Listed") ++listed;
+        idsInOrder = idsInOrder && t.id()==expectedId++;
+    });
+
+    QCOMPARE(listed,1);
+    QVERIFY(idsInOrder);
+    QCOMPARE(expectedId,instanceTypeCount());
+}
+
+void RegistryTest::typeNamesAreAvailableWithoutRtti()
+{
+    QCOMPARE(typeName<int>().str(),std::string("int"));
+    QCOMPARE(typeName<Tagged<Unlisted>>().str().find("Tagged<")!=std::string::npos,true);
+    QCOMPARE(typeName<Tagged<Unlisted>>().str().find("Unlisted>")!=std::string::npos,true);
+}
+
+void RegistryTest::missingRegistrationsAreDetected()
+{
+    struct A{};
+
+    QCOMPARE(instance<A>() ? true : false, false);
+    const std::size_t before = unregisteredCount();
+    QCOMPARE(allInstancesRegistered(),false);
+
+    {
+        Instance<A> a;
+        QCOMPARE(unregisteredCount(),before-1);
+    }
+
+    QCOMPARE(unregisteredCount(),before);
+}
+
+void RegistryTest::typeTableGrowsInChunks()
+{
+    const std::size_t chunk = detail::TypeIdTable<int>::chunkSize;
+    detail::TypeIdTable<int> table;
+
+    table.at(1) = 1;
+    QCOMPARE(*table.find(1),1);
+    QVERIFY(table.find(chunk)==nullptr);
+
+#ifdef GLOBAL_NO_HEAP
+#ifdef __cpp_exceptions
+    try {
+        table.at(chunk);
+        QFAIL("");
+    }
+    catch(TooManyInstanceTypes&) {}
+#endif
+#else
+    table.at(2*chunk+1) = 3;
+    QCOMPARE(*table.find(2*chunk+1),3);
+    QCOMPARE(*table.find(chunk),0);
+    QVERIFY(table.find(3*chunk)==nullptr);
+
+    table.freeChunks();
+    QVERIFY(table.find(chunk)==nullptr);
+    QCOMPARE(*table.find(1),1);
+#endif
+}
+
+void RegistryTest::snapshotRestoresTheInstancePointers()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+
+    Instance<A> a;
+    A* const original = static_cast<A*>(instance<A>());
+    bool unavailableCalled = false;
+    A other;
+
+    detail::ReplacingInstanceRegistration<A> reg;
+    {
+        RegistrySnapshot snapshot;
+        QCOMPARE(snapshot.size(),instanceTypeCount());
+
+        reg.registerInstance(&other);
+        instance<A>().becomesUnavailable([&unavailableCalled](A&){ unavailableCalled = true; });
+        QVERIFY(instance<A>()==&other);
+    }
+
+    QVERIFY(instance<A>()==original);
+    QCOMPARE(unavailableCalled,false);
+#endif
+}
+
+void RegistryTest::snapshotParksTheQueuedCalls()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct B{};
+
+    int queuedBefore = 0;
+    int queuedAfter = 0;
+    instance<B>().ifAvailable([&queuedBefore](B&){ ++queuedBefore; });
+
+    {
+        RegistrySnapshot snapshot;
+        instance<B>().ifAvailable([&queuedAfter](B&){ ++queuedAfter; });
+        Instance<B> b;
+        QCOMPARE(queuedBefore,0);
+        QCOMPARE(queuedAfter,1);
+    }
+
+    Instance<B> b;
+    QCOMPARE(queuedBefore,1);
+    QCOMPARE(queuedAfter,1);
+#endif
+}
+
+void RegistryTest::callsQueuedAfterTheSnapshotAreDropped()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct C{};
+
+    bool called = false;
+    {
+        RegistrySnapshot snapshot;
+        instance<C>().ifAvailable([&called](C&){ called = true; });
+    }
+
+    Instance<C> c;
+    QCOMPARE(called,false);
+#endif
+}
+
+void RegistryTest::instancesDestructedAfterTheSnapshotAreNotRestored()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct D{};
+
+    std::unique_ptr<Instance<D>> captured(new Instance<D>);
+    {
+        RegistrySnapshot snapshot;
+        captured.reset(); //deregistered and destructed
+    }
+    QVERIFY(!instance<D>());
+
+    captured.reset(new Instance<D>);
+    std::unique_ptr<Instance<D>> next;
+    {
+        RegistrySnapshot snapshot;
+        captured.reset();
+        next.reset(new Instance<D>);
+    }
+    QVERIFY(static_cast<bool>(instance<D>()));
+    next.reset();
+    QVERIFY(!instance<D>()); //the registered one was the instance of next
+#endif
+}
@@ -0,0 +1,29 @@
+#ifndef REGISTRYTEST_H
+#define REGISTRYTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class RegistryTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RegistryTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void accessedTypesHaveDenseIds();
+    void accessedTypesAreEnumerated();
+    void typeNamesAreAvailableWithoutRtti();
+    void missingRegistrationsAreDetected();
+    void typeTableGrowsInChunks();
+    void snapshotRestoresTheInstancePointers();
+    void snapshotParksTheQueuedCalls();
+    void callsQueuedAfterTheSnapshotAreDropped();
+    void instancesDestructedAfterTheSnapshotAreNotRestored();
+
+};
+
+#endif // REGISTRYTEST_H
@@ -0,0 +1,110 @@
+#include "SmallFunctionTest.h"
+#include "operatorNew.h"
+
+#include <src/globalInstances.h>
+
+using global::detail::SmallFunction;
+using global::detail::SmallVector;
+
+SmallFunctionTest::SmallFunctionTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void SmallFunctionTest::defaultConstructedFunctionIsEmpty()
+{
+    SmallFunction<void()> f;
+    QCOMPARE(static_cast<bool>(f),false);
+}
+
+void SmallFunctionTest::smallCallableDoesNotInvokeOperatorNew()
+{
+    int x = 0;
+    auto callable = [&x](int y){ x = y; };
+
+    const int newCountBefore = newCallCount();
+
+    SmallFunction<void(int)> f(callable);
+    f(3);
+
+    QCOMPARE(newCountBefore,newCallCount());
+    QCOMPARE(x,3);
+}
+
+void SmallFunctionTest::largeCallableIsCalled()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct Large{ char buffer[256]; int operator()(){ return buffer[255]; } };
+    Large l{};
+    l.buffer[255] = 7;
+
+    SmallFunction<int()> f(l);
+
+    QCOMPARE(f(),7);
+#endif
+}
+
+void SmallFunctionTest::movingTransfersTheCallable()
+{
+    SmallFunction<int()> f([]{ return 4; });
+    SmallFunction<int()> g(std::move(f));
+
+    QCOMPARE(static_cast<bool>(f),false);
+    QCOMPARE(g(),4);
+}
+
+void SmallFunctionTest::callableIsDestroyedOnce()
+{
+    struct Counted{
+        int* destructions;
+        Counted(int* d):destructions(d){}
+        Counted(Counted&& other) noexcept :destructions(other.destructions){ other.destructions = nullptr; }
+        ~Counted(){ if (destructions!=nullptr) ++*destructions; }
+        void operator()(){}
+    };
+
+    int destructions = 0;
+    {
+        SmallFunction<void()> f(Counted{&destructions});
+        SmallFunction<void()> g;
+        g = std::move(f);
+    }
+
+    QCOMPARE(destructions,1);
+}
+
+void SmallFunctionTest::vectorKeepsElementsWhenGrowing()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    SmallVector<SmallFunction<int()>,2> v;
+    for (int i = 0; i<10; ++i) v.emplace_back([i]{ return i; });
+
+    SmallVector<SmallFunction<int()>,2> w;
+    w.swap(v);
+
+    QCOMPARE(v.size(),std::size_t{0});
+    QCOMPARE(w.size(),std::size_t{10});
+
+    int i = 0;
+    for (auto& f:w) QCOMPARE(f(),i++);
+#endif
+}
+
+void SmallFunctionTest::vectorWithoutInlineCapacityGrows()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    SmallVector<SmallFunction<int()>,0> v;
+    for (int i = 0; i<3; ++i) v.emplace_back([i]{ return i; });
+
+    QCOMPARE(v.size(),std::size_t{3});
+
+    int i = 0;
+    for (auto& f:v) QCOMPARE(f(),i++);
+#endif
+}
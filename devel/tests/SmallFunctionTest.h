@@ -0,0 +1,27 @@
+#ifndef SMALLFUNCTIONTEST_H
+#define SMALLFUNCTIONTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class SmallFunctionTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SmallFunctionTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void defaultConstructedFunctionIsEmpty();
+    void smallCallableDoesNotInvokeOperatorNew();
+    void largeCallableIsCalled();
+    void movingTransfersTheCallable();
+    void callableIsDestroyedOnce();
+    void vectorKeepsElementsWhenGrowing();
+    void vectorWithoutInlineCapacityGrows();
+
+};
+
+#endif // SMALLFUNCTIONTEST_H
@@ -0,0 +1,275 @@
+#include "StartupTest.h"
+#include <src/globalInstances.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+StartupTest::StartupTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void StartupTest::allInstancesAreConstructedAndRegistered()
+{
+    struct A{};
+    struct B{};
+
+    {
+        Startup startup;
+        startup.add<Instance<A>>();
+        startup.add<Instance<B>>();
+        startup.run(2);
+
+        QVERIFY(instance<A>()!=nullptr);
+        QVERIFY(instance<B>()!=nullptr);
+    }
+
+    QVERIFY(instance<A>()==nullptr);
+    QVERIFY(instance<B>()==nullptr);
+}
+
+void StartupTest::dependenciesAreRegisteredBeforeConstruction()
+{
+    struct A{};
+    struct B{ bool aAvailable = instance<A>(); };
+    struct C{ bool abAvailable = instance<A>() && instance<B>(); };
+
+    Startup startup;
+    startup.add<Instance<C>, DependsOn<A,B>>();
+    startup.add<Instance<B>, DependsOn<A>>();
+    startup.add<Instance<A>>();
+    startup.run(4);
+
+    QVERIFY(instance<B>()->aAvailable);
+    QVERIFY(instance<C>()->abAvailable);
+}
+
+namespace {
+std::atomic<int> constructorsEntered{0};
+
+//waits for the other constructor to be entered as well
+bool meetOther(){
+    ++constructorsEntered;
+    const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (constructorsEntered<2) {
+        if (std::chrono::steady_clock::now()>timeout) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+}
+
+void StartupTest::independentInstancesAreConstructedConcurrently()
+{
+    struct A{ bool concurrent = meetOther(); };
+    struct B{ bool concurrent = meetOther(); };
+
+    constructorsEntered = 0;
+
+    Startup startup;
+    startup.add<Instance<A>>();
+    startup.add<Instance<B>>();
+    startup.run(2);
+
+    QVERIFY(instance<A>()->concurrent);
+    QVERIFY(instance<B>()->concurrent);
+}
+
+void StartupTest::instancesAreDestructedInReverseOrder()
+{
+    struct A{};
+    struct B{ ~B(){ aAvailableOnDestruction = instance<A>(); } bool& aAvailableOnDestruction; B(bool& b):aAvailableOnDestruction(b){} };
+
+    bool aAvailable = false;
+    {
+        Startup startup;
+        startup.add<Instance<B>, DependsOn<A>>(std::ref(aAvailable));
+        startup.add<Instance<A>>();
+        startup.run();
+    }
+
+    QVERIFY(aAvailable);
+}
+
+void StartupTest::argumentsArePassedToTheConstructor()
+{
+    struct A{ int x; std::string y; A(int x_, std::string y_):x(x_),y(y_){} };
+
+    Startup startup;
+    startup.add<Instance<A>>(3,"bla");
+    startup.run();
+
+    QCOMPARE(instance<A>()->x,3);
+    QVERIFY(instance<A>()->y=="bla");
+}
+
+void StartupTest::cyclicDependencyIsReported()
+{
+#ifdef __cpp_exceptions
+    struct A{};
+    struct B{};
+
+    Startup startup;
+    startup.add<Instance<A>, DependsOn<B>>();
+    startup.add<Instance<B>, DependsOn<A>>();
+
+    try{
+        startup.run();
+        QFAIL("");
+    }
+    catch(CyclicDependency const&){}
+
+    QVERIFY(instance<A>()==nullptr);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void StartupTest::unresolvedDependencyIsReported()
+{
+#ifdef __cpp_exceptions
+    struct A{};
+    struct B{};
+
+    Startup startup;
+    startup.add<Instance<A>, DependsOn<B>>();
+
+    try{
+        startup.run();
+        QFAIL("");
+    }
+    catch(UnresolvedDependency const&){}
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void StartupTest::constructionErrorIsRethrown()
+{
+#ifdef __cpp_exceptions
+    struct Error{};
+    struct A{ A(){ throw Error{}; } };
+    struct B{};
+
+    Startup startup;
+    startup.add<Instance<A>>();
+    startup.add<Instance<B>, DependsOn<A>>();
+
+    try{
+        startup.run();
+        QFAIL("");
+    }
+    catch(Error const&){}
+
+    QVERIFY(instance<B>()==nullptr);
+#else
+    QSKIP("skipped due to disabled exceptions", SkipAll);
+#endif
+}
+
+void StartupTest::failedConstructionIsRetriedWithTheSameArguments()
+{
+#if defined(__cpp_exceptions) && !defined(GLOBAL_NO_HEAP)
+    struct Error{};
+    struct A{
+        std::string name;
+        A(std::string n, int* attempts):name(n){ if (++*attempts==1) throw Error{}; }
+    };
+    struct B{};
+
+    int attempts = 0;
+    Startup startup;
+    startup.add<Instance<A>>(std::string("a name longer than the small string buffer"),&attempts);
+    startup.add<Instance<B>, DependsOn<A>>();
+
+    try{
+        startup.run();
+        QFAIL("");
+    }
+    catch(Error const&){}
+
+    startup.run(); //constructs the remaining instances
+    QCOMPARE(attempts,2);
+    QVERIFY(instance<A>()->name=="a name longer than the small string buffer");
+    QVERIFY(instance<B>()!=nullptr);
+#else
+    QSKIP("skipped due to disabled exceptions or GLOBAL_NO_HEAP", SkipAll);
+#endif
+}
+
+void StartupTest::independentInstancesAreDestructedConcurrently()
+{
+    struct A{ ~A(){ concurrent = meetOther(); } bool& concurrent; A(bool& b):concurrent(b){} };
+    struct B{ ~B(){ concurrent = meetOther(); } bool& concurrent; B(bool& b):concurrent(b){} };
+
+    bool aConcurrent = false;
+    bool bConcurrent = false;
+    constructorsEntered = 0;
+
+    Startup startup;
+    startup.add<Instance<A>>(std::ref(aConcurrent));
+    startup.add<Instance<B>>(std::ref(bConcurrent));
+    startup.run(2);
+    const ShutdownReport report = startup.shutdown(2);
+
+    QVERIFY(aConcurrent);
+    QVERIFY(bConcurrent);
+    QCOMPARE(report.instances.size(),static_cast<std::size_t>(2));
+    QVERIFY(instance<A>()==nullptr);
+}
+
+namespace {
+struct ShutdownSeen{ bool firstAvailable = false; bool lastAvailable = true; bool deregistered = false; };
+struct First{};
+struct Middle{ ~Middle(); ShutdownSeen& seen; Middle(ShutdownSeen& s):seen(s){} };
+struct Last{};
+Middle::~Middle(){ seen.firstAvailable = instance<First>(); seen.lastAvailable = instance<Last>(); seen.deregistered = !instance<Middle>(); }
+}
+
+void StartupTest::dependentsAreDestructedFirstOnParallelShutdown()
+{
+    ShutdownSeen seen;
+    {
+        Startup startup;
+        startup.add<Instance<First>>();
+        startup.add<Instance<Middle>, DependsOn<First>>(std::ref(seen));
+        startup.add<Instance<Last>, DependsOn<Middle>>();
+        startup.run(4);
+        startup.shutdown(4);
+    }
+
+    QVERIFY(seen.firstAvailable);
+    QVERIFY(!seen.lastAvailable);
+    QVERIFY(seen.deregistered);
+}
+
+void StartupTest::shutdownReportListsTheSlowestFirst()
+{
+    struct Slow{ ~Slow(){ std::this_thread::sleep_for(std::chrono::milliseconds(50)); } };
+    struct Fast{};
+
+    Startup startup;
+    startup.add<Instance<Fast>>();
+    startup.add<Instance<Slow>>();
+    startup.run(2);
+    const ShutdownReport report = startup.shutdown(2,std::chrono::milliseconds(20));
+
+    QCOMPARE(report.instances.size(),static_cast<std::size_t>(2));
+    QVERIFY(report.instances[0].name.str().find("Slow")!=std::string::npos);
+    QVERIFY(report.instances[0].deadlineExceeded);
+    QVERIFY(!report.instances[1].deadlineExceeded);
+    QVERIFY(report.deadlineExceeded());
+    QVERIFY(report.total>=report.instances[0].duration);
+
+    std::ostringstream out;
+    writeShutdownReport(out,report);
+    const std::string written = out.str();
+    QCOMPARE(std::count(written.begin(),written.end(),'\n'),static_cast<std::ptrdiff_t>(2));
+    QVERIFY(written.find("Slow deadline exceeded\n")!=std::string::npos);
+}
@@ -0,0 +1,32 @@
+#ifndef STARTUPTEST_H
+#define STARTUPTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class StartupTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StartupTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void allInstancesAreConstructedAndRegistered();
+    void dependenciesAreRegisteredBeforeConstruction();
+    void independentInstancesAreConstructedConcurrently();
+    void instancesAreDestructedInReverseOrder();
+    void argumentsArePassedToTheConstructor();
+    void cyclicDependencyIsReported();
+    void unresolvedDependencyIsReported();
+    void constructionErrorIsRethrown();
+    void failedConstructionIsRetriedWithTheSameArguments();
+    void independentInstancesAreDestructedConcurrently();
+    void dependentsAreDestructedFirstOnParallelShutdown();
+    void shutdownReportListsTheSlowestFirst();
+
+};
+
+#endif // STARTUPTEST_H
@@ -0,0 +1,100 @@
+#include "SwappableInstanceTest.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+SwappableInstanceTest::SwappableInstanceTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void SwappableInstanceTest::replacedInstanceIsAccessible()
+{
+    struct A{ int version; A(int v):version(v){} };
+
+    SwappableInstance<A> a(1);
+    QCOMPARE(instance<A>()->version,1);
+
+    a.emplace(2);
+    QCOMPARE(instance<A>()->version,2);
+}
+
+void SwappableInstanceTest::replacingDoesNotTriggerDeferredCalls()
+{
+    struct A{ int version; A(int v):version(v){} };
+
+    int unavailableCount = 0;
+    int lastVersion = 0;
+    {
+        SwappableInstance<A> a(1);
+        instance<A>().becomesUnavailable([&](A& r){ ++unavailableCount; lastVersion = r.version; });
+
+        a.emplace(2);
+        a.emplace(3);
+        QCOMPARE(unavailableCount,0);
+    }
+
+    QCOMPARE(unavailableCount,1);
+    QCOMPARE(lastVersion,3);
+}
+
+void SwappableInstanceTest::oldVersionIsKeptWhileReadSectionIsActive()
+{
+    struct A{ int version; A(int v):version(v){} };
+
+    SwappableInstance<A> a(1);
+
+    std::atomic<bool> entered{false};
+    std::atomic<bool> leave{false};
+    int seenVersion = 0;
+
+    std::thread reader([&]{
+        ReadSection section;
+        A* old = static_cast<A*>(instance<A>());
+        entered = true;
+        while (!leave) {}
+        seenVersion = old->version;
+    });
+
+    while (!entered) {}
+    a.emplace(2);
+    QCOMPARE(a.retiredCount(),std::size_t{1});
+
+    leave = true;
+    reader.join();
+    a.reclaim();
+
+    QCOMPARE(a.retiredCount(),std::size_t{0});
+    QCOMPARE(seenVersion,1);
+}
+
+void SwappableInstanceTest::concurrentReadersOnlySeeLiveVersions()
+{
+    struct A{
+        std::atomic<bool> alive{true};
+        ~A(){ alive = false; }
+    };
+
+    SwappableInstance<A> a;
+
+    std::atomic<bool> done{false};
+    std::atomic<int> deadAccesses{0};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i<3; ++i) readers.emplace_back([&]{
+        while (!done) {
+            ReadSection section;
+            if (!instance<A>()->alive) ++deadAccesses;
+        }
+    });
+
+    for (int i = 0; i<2000; ++i) a.emplace();
+
+    done = true;
+    for (auto& r:readers) r.join();
+
+    QCOMPARE(deadAccesses.load(),0);
+}
@@ -0,0 +1,24 @@
+#ifndef SWAPPABLEINSTANCETEST_H
+#define SWAPPABLEINSTANCETEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class SwappableInstanceTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SwappableInstanceTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void replacedInstanceIsAccessible();
+    void replacingDoesNotTriggerDeferredCalls();
+    void oldVersionIsKeptWhileReadSectionIsActive();
+    void concurrentReadersOnlySeeLiveVersions();
+
+};
+
+#endif // SWAPPABLEINSTANCETEST_H
@@ -0,0 +1,121 @@
+#include "TestContextTest.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace global;
+
+namespace {
+struct A{ virtual ~A(){} virtual int foo(){ return 1; } };
+struct MockA : A{ explicit MockA(int i):value(i){} int foo() override{ return value; } int value; };
+
+#ifdef GLOBAL_TEST_CONTEXTS
+void waitFor(std::atomic<int>& count, int n){
+    ++count;
+    while (count.load()<n) std::this_thread::yield();
+}
+#endif
+}
+
+TestContextTest::TestContextTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void TestContextTest::overridesAreVisibleOnlyInTheirContext()
+{
+#ifndef GLOBAL_TEST_CONTEXTS
+    QSKIP("skipped since GLOBAL_TEST_CONTEXTS is not defined", SkipAll);
+#else
+    Instance<A> a;
+
+    constexpr int testCount = 4;
+    std::atomic<int> registered{0};
+    std::atomic<int> checked{0};
+    std::vector<int> seen(testCount,0);
+    std::vector<std::thread> tests;
+    for(int i = 0; i<testCount; ++i) tests.emplace_back([&,i]{
+        TestContext context;
+        TestInstance<A,MockA> mock(10+i);
+        waitFor(registered,testCount); //all overrides are registered at the same time
+        seen[i] = instance<A>()->foo();
+        waitFor(checked,testCount);
+    });
+    for(auto& t:tests) t.join();
+
+    for(int i = 0; i<testCount; ++i) QCOMPARE(seen[i],10+i);
+    QCOMPARE(instance<A>()->foo(),1);
+#endif
+}
+
+void TestContextTest::tasksSpawnedInAContextSeeItsOverrides()
+{
+#ifndef GLOBAL_TEST_CONTEXTS
+    QSKIP("skipped since GLOBAL_TEST_CONTEXTS is not defined", SkipAll);
+#else
+    Instance<A> a;
+    TestContext context;
+    TestInstance<A,MockA> mock(2);
+
+    std::atomic<int> pooled{0};
+    {
+        ThreadPool pool(2);
+        pool.execute([&pooled]{ pooled = instance<A>()->foo(); });
+    }
+
+    BatchingExecutor executor;
+    int batched = 0;
+    executor.execute([&batched]{ batched = instance<A>()->foo(); });
+    std::thread([&executor]{ executor.run(); }).join();
+
+    int bound = 0;
+    int unbound = 0;
+    std::thread(bindTestContext([&bound]{ bound = instance<A>()->foo(); })).join();
+    std::thread([&unbound]{ unbound = instance<A>()->foo(); }).join();
+
+    QCOMPARE(pooled.load(),2);
+    QCOMPARE(batched,2);
+    QCOMPARE(bound,2);
+    QCOMPARE(unbound,1);
+#endif
+}
+
+void TestContextTest::overridingByNullHidesTheRegisteredInstance()
+{
+#ifndef GLOBAL_TEST_CONTEXTS
+    QSKIP("skipped since GLOBAL_TEST_CONTEXTS is not defined", SkipAll);
+#else
+    Instance<A> a;
+    TestContext context;
+
+    {
+        detail::TestContextRegistration<A> reg(nullptr);
+        QCOMPARE(static_cast<bool>(instance<A>()),false);
+
+        bool visible = false;
+        std::thread([&visible]{ visible = static_cast<bool>(instance<A>()); }).join();
+        QCOMPARE(visible,true);
+    }
+
+    QCOMPARE(instance<A>()->foo(),1);
+#endif
+}
+
+void TestContextTest::withoutContextTheInstanceIsReplacedForAllThreads()
+{
+#ifndef GLOBAL_TEST_CONTEXTS
+    QSKIP("skipped since GLOBAL_TEST_CONTEXTS is not defined", SkipAll);
+#else
+    Instance<A> a;
+
+    {
+        TestInstance<A,MockA> mock(3);
+        int seen = 0;
+        std::thread([&seen]{ seen = instance<A>()->foo(); }).join();
+        QCOMPARE(seen,3);
+    }
+
+    QCOMPARE(instance<A>()->foo(),1);
+#endif
+}
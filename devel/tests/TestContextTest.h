@@ -0,0 +1,24 @@
+#ifndef TESTCONTEXTTEST_H
+#define TESTCONTEXTTEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class TestContextTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TestContextTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void overridesAreVisibleOnlyInTheirContext();
+    void tasksSpawnedInAContextSeeItsOverrides();
+    void overridingByNullHidesTheRegisteredInstance();
+    void withoutContextTheInstanceIsReplacedForAllThreads();
+
+};
+
+#endif // TESTCONTEXTTEST_H
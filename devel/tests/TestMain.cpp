@@ -8,6 +8,23 @@
 #include <src/globalInstances.h>
 #include "InstanceTest.h"
 #include "RegistrationTest.h"
+#include "SmallFunctionTest.h"
+#include "SwappableInstanceTest.h"
+#include "StartupTest.h"
+#include "RegistryTest.h"
+#include "TraceTest.h"
+#include "AccessCountTest.h"
+#include "LazyInstanceTest.h"
+#include "CoroutineTest.h"
+#include "WhenAllAvailableTest.h"
+#include "ExecutorTest.h"
+#include "NoHeapTest.h"
+#include "FreezeTest.h"
+#include "KeyedInstanceTest.h"
+#include "PerCpuTest.h"
+#include "TestContextTest.h"
+#include "AllocationTest.h"
+#include "PinTest.h"
 
 
 namespace global {
@@ -41,6 +58,91 @@ TestMain::TestMain(int argc, char* argv[])
         if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
     }
 
+    {
+        SmallFunctionTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        SwappableInstanceTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        StartupTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        RegistryTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        TraceTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        AccessCountTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        LazyInstanceTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        CoroutineTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        WhenAllAvailableTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        ExecutorTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        NoHeapTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        FreezeTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        KeyedInstanceTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        PerCpuTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        TestContextTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        AllocationTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
+    {
+        PinTest tc;
+        if (QTest::qExec(&tc, argc, argv)!=0) testFailed();
+    }
+
 
 }
 
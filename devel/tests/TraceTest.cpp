@@ -0,0 +1,72 @@
+#include "TraceTest.h"
+#include <src/globalInstances.h>
+#include <sstream>
+#include <string>
+
+using namespace global;
+
+namespace {
+
+struct Traced{};
+
+std::string trace(){
+    std::ostringstream out;
+    writeTrace(out);
+    return out.str();
+}
+
+bool contains(std::string const& s, std::string const& part){ return s.find(part)!=std::string::npos; }
+
+}
+
+TraceTest::TraceTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void TraceTest::lifetimeOfInstanceIsRecorded()
+{
+#ifdef GLOBAL_TRACE
+    clearTrace();
+    {
+        Instance<Traced> t;
+    }
+    const std::string s = trace();
+
+    QVERIFY(contains(s,"Traced\",\"cat\":\"construct\""));
+    QVERIFY(contains(s,"Traced\",\"cat\":\"register\""));
+    QVERIFY(contains(s,"Traced\",\"cat\":\"deregister\""));
+    QVERIFY(contains(s,"Traced\",\"cat\":\"destruct\""));
+    QVERIFY(s.find("\"construct\"")<s.find("\"register\""));
+#else
+    QSKIP("skipped since GLOBAL_TRACE is not defined", SkipAll);
+#endif
+}
+
+void TraceTest::deferredCallsAreRecorded()
+{
+#ifdef GLOBAL_TRACE
+    clearTrace();
+
+    instance<Traced>().ifAvailable([](Traced&){});
+    instance<Traced>().becomesUnavailable([](Traced&){});
+    {
+        Instance<Traced> t;
+    }
+    const std::string s = trace();
+
+    QVERIFY(contains(s,"Traced\",\"cat\":\"ifAvailable\""));
+    QVERIFY(contains(s,"Traced\",\"cat\":\"becomesUnavailable\""));
+#else
+    QSKIP("skipped since GLOBAL_TRACE is not defined", SkipAll);
+#endif
+}
+
+void TraceTest::traceIsValidWithoutEvents()
+{
+    clearTrace();
+    const std::string s = trace();
+
+    QVERIFY(contains(s,"{\"traceEvents\":["));
+    QVERIFY(!contains(s,"\"ph\""));
+}
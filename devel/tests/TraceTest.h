@@ -0,0 +1,23 @@
+#ifndef TRACETEST_H
+#define TRACETEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class TraceTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TraceTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void lifetimeOfInstanceIsRecorded();
+    void deferredCallsAreRecorded();
+    void traceIsValidWithoutEvents();
+
+};
+
+#endif // TRACETEST_H
@@ -0,0 +1,240 @@
+#include "WhenAllAvailableTest.h"
+#include <src/globalInstances.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+using namespace global;
+
+namespace {
+
+template<typename T>
+void registerUntilFinished(std::atomic<int>& registered, std::atomic<bool>& finish){
+    Instance<T> t;
+    ++registered;
+    while (!finish) std::this_thread::yield();
+}
+
+struct Replicated{};
+struct PerThread{ int v = 1; };
+struct Overridden{ virtual ~Overridden(){} virtual int v(){ return 1; } };
+struct MockOverridden : Overridden{ int v() override{ return 2; } };
+
+template<typename T>
+DeferredCallUsage usageOf(){
+    DeferredCallUsage u{0,0};
+    forEachInstanceType([&u](InstanceType const& t){ if (t.id()==typeId<T>()) u = t.deferredCalls(); });
+    return u;
+}
+
+}
+
+namespace global {
+template<> struct PerCpuAccess<Replicated> : std::true_type {};
+template<> struct ThreadLocalAccess<PerThread> : std::true_type {};
+}
+
+WhenAllAvailableTest::WhenAllAvailableTest(QObject *parent) : QObject(parent)
+{
+
+}
+
+void WhenAllAvailableTest::calledOnceWhenLastIsRegistered()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{ int v = 1; };
+    struct B{ int v = 2; };
+    struct C{ int v = 3; };
+
+    int calls = 0;
+    int sum = 0;
+    whenAllAvailable<A,B,C>([&](A& a, B& b, C& c){ ++calls; sum = a.v + b.v + c.v; });
+
+    Instance<C> c;
+    Instance<A> a;
+    QCOMPARE(calls,0);
+
+    {
+        Instance<B> b;
+        QCOMPARE(calls,1);
+        QCOMPARE(sum,6);
+    }
+
+    Instance<B> b;
+    QCOMPARE(calls,1);
+#endif
+}
+
+void WhenAllAvailableTest::calledDirectlyIfAllAreRegistered()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+    struct B{};
+
+    Instance<A> a;
+    Instance<B> b;
+
+    int calls = 0;
+    whenAllAvailable<A,B>([&calls](A&, B&){ ++calls; });
+    QCOMPARE(calls,1);
+
+    whenAllAvailable<>([&calls](){ ++calls; });
+    QCOMPARE(calls,2);
+#endif
+}
+
+void WhenAllAvailableTest::waitsAgainIfOneIsDeregistered()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+    struct B{};
+
+    A* called = nullptr;
+    whenAllAvailable<A,B>([&called](A& a, B&){ called = &a; });
+
+    {
+        Instance<A> first;
+    }
+
+    Instance<B> b;
+    QVERIFY(called==nullptr);
+
+    Instance<A> second;
+    QVERIFY(called==&*instance<A>());
+#endif
+}
+
+void WhenAllAvailableTest::concurrentRegistrationsCallOnce()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+    struct B{};
+    struct C{};
+    struct D{};
+
+    for(int round = 0; round<50; ++round) {
+
+        std::atomic<int> calls{0};
+        whenAllAvailable<A,B,C,D>([&calls](A&, B&, C&, D&){ ++calls; });
+
+        std::atomic<int> registered{0};
+        std::atomic<bool> finish{false};
+        std::thread ta(registerUntilFinished<A>,std::ref(registered),std::ref(finish));
+        std::thread tb(registerUntilFinished<B>,std::ref(registered),std::ref(finish));
+        std::thread tc(registerUntilFinished<C>,std::ref(registered),std::ref(finish));
+        std::thread td(registerUntilFinished<D>,std::ref(registered),std::ref(finish));
+        while (registered<4) std::this_thread::yield();
+
+        QCOMPARE(calls.load(),1);
+
+        finish = true;
+        ta.join(); tb.join(); tc.join(); td.join();
+    }
+#endif
+}
+
+void WhenAllAvailableTest::funcIsReleasedAfterTheCall()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+    struct B{};
+
+    auto captured = std::make_shared<int>(0);
+    std::weak_ptr<int> released = captured;
+    whenAllAvailable<A,B>([captured](A&, B&){ ++*captured; });
+    captured.reset();
+
+    Instance<A> a;
+    QVERIFY(!released.expired());
+
+    Instance<B> b;
+    QVERIFY(released.expired()); //though a deregistration of A is still waited for
+#endif
+}
+
+void WhenAllAvailableTest::completedJoinsLeaveNothingQueued()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct A{};
+    struct B{};
+
+    Instance<A> a; //outlives all joins
+    int calls = 0;
+    for(int i = 0; i<50; ++i) {
+        whenAllAvailable<A,B>([&calls](A&, B&){ ++calls; });
+        Instance<B> b;
+    }
+
+    QCOMPARE(calls,50);
+    QCOMPARE(usageOf<A>().highWatermark,std::size_t{0});
+    QCOMPARE(usageOf<B>().highWatermark,std::size_t{1});
+#endif
+}
+
+void WhenAllAvailableTest::perCpuInstancesAreNotWaitedForAgain()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct B{};
+
+    PerCpuInstance<Replicated> replicated;
+    std::atomic<int> calls{0};
+    whenAllAvailable<Replicated,B>([&calls](Replicated&, B&){ ++calls; });
+
+    std::thread other([]{ Instance<B> b; }); //possibly on another cpu than the call for Replicated
+    other.join();
+
+    QCOMPARE(calls.load(),1);
+#endif
+}
+
+void WhenAllAvailableTest::threadLocalInstancesAreNotWaitedForAgain()
+{
+#ifdef GLOBAL_NO_HEAP
+    QSKIP("skipped since GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct B{ int v = 2; };
+
+    ThreadLocalInstance<PerThread> perThread;
+    Instance<B> b;
+    int calls = 0;
+    int sum = 0;
+    whenAllAvailable<PerThread,B>([&](PerThread& p, B& r){ ++calls; sum = p.v + r.v; });
+
+    QCOMPARE(calls,1);
+    QCOMPARE(sum,3);
+#endif
+}
+
+void WhenAllAvailableTest::testContextOverridesAreNotWaitedForAgain()
+{
+#if !defined(GLOBAL_TEST_CONTEXTS) || defined(GLOBAL_NO_HEAP)
+    QSKIP("skipped since GLOBAL_TEST_CONTEXTS is not defined or GLOBAL_NO_HEAP is defined", SkipAll);
+#else
+    struct B{ int v = 2; };
+
+    TestContext context;
+    TestInstance<Overridden,MockOverridden> mock;
+    Instance<B> b;
+    int calls = 0;
+    int sum = 0;
+    whenAllAvailable<Overridden,B>([&](Overridden& o, B& r){ ++calls; sum = o.v() + r.v; });
+
+    QCOMPARE(calls,1);
+    QCOMPARE(sum,4);
+#endif
+}
@@ -0,0 +1,29 @@
+#ifndef WHENALLAVAILABLETEST_H
+#define WHENALLAVAILABLETEST_H
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+class WhenAllAvailableTest : public QObject
+{
+    Q_OBJECT
+public:
+    explicit WhenAllAvailableTest(QObject *parent = nullptr);
+
+signals:
+
+private slots:
+
+    void calledOnceWhenLastIsRegistered();
+    void calledDirectlyIfAllAreRegistered();
+    void waitsAgainIfOneIsDeregistered();
+    void concurrentRegistrationsCallOnce();
+    void funcIsReleasedAfterTheCall();
+    void completedJoinsLeaveNothingQueued();
+    void perCpuInstancesAreNotWaitedForAgain();
+    void threadLocalInstancesAreNotWaitedForAgain();
+    void testContextOverridesAreNotWaitedForAgain();
+
+};
+
+#endif // WHENALLAVAILABLETEST_H
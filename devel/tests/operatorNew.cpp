@@ -1,37 +1,94 @@
 #include "operatorNew.h"
-#include <src/globalInstances.h>
-#include <memory>
+#include <atomic>
+#include <cstdlib>
 
+//replaces all variants of operator new and delete to record the allocations of each thread
 
-int &newCallCount()
-{
-    static int i = 0;
-    return i;
-}
+namespace {
+    std::atomic<int> newCalls{0}; //operator new might be called from multiple threads
+    thread_local AllocationCounts threadCounts{0,0,0,0,0}; //constant initialized, so it allocates nothing itself
+
+    void* allocate(std::size_t count){
+        ++newCalls;
+        ++threadCounts.allocations;
+        threadCounts.bytes += count;
+        return std::malloc(count!=0 ? count : 1);
+    }
+
+    void* outOfMemory(){
+#ifdef __cpp_exceptions
+        throw std::bad_alloc{};
+#else
+        std::abort();
+#endif
+    }
+
+    void* allocateOrThrow(std::size_t count){
+        void* p = allocate(count);
+        return p!=nullptr ? p : outOfMemory();
+    }
+
+    void release(void* p){
+        if (p==nullptr) return;
+        ++threadCounts.frees;
+        std::free(p);
+    }
 
+#ifdef __cpp_aligned_new
+    void* allocateAligned(std::size_t count, std::align_val_t al){
+        const std::size_t alignment = static_cast<std::size_t>(al);
+        ++newCalls;
+        ++threadCounts.allocations;
+        ++threadCounts.aligned;
+        threadCounts.bytes += count;
+        void* p = nullptr;
+        return posix_memalign(&p,alignment<sizeof(void*) ? sizeof(void*) : alignment,count!=0 ? count : 1)==0 ? p : nullptr;
+    }
 
-void *operator new(std::size_t count)
+    void* allocateAlignedOrThrow(std::size_t count, std::align_val_t al){
+        void* p = allocateAligned(count,al);
+        return p!=nullptr ? p : outOfMemory();
+    }
+#endif
+}
+
+int newCallCount()
 {
-    ++newCallCount();
-    return malloc(count);
+    return newCalls;
 }
 
-void *operator new[](std::size_t count)
+AllocationCounts threadAllocationCounts()
 {
-    ++newCallCount();
-    return malloc(count);
+    return threadCounts;
 }
 
-//void *operator new(std::size_t count, const std::nothrow_t &)
-//{
-//    global::detail::do_throw(std::exception{}); //unexpected
-//    return malloc(count);
-//}
 
-//void *operator new[](std::size_t count, const std::nothrow_t &)
-//{
-//    global::detail::do_throw(std::exception{}); //unexpected
-//    return malloc(count);
-//}
+void* operator new  (std::size_t count){ return allocateOrThrow(count); }
+void* operator new[](std::size_t count){ return allocateOrThrow(count); }
+
+void* operator new  (std::size_t count, std::nothrow_t const&) noexcept{ ++threadCounts.nothrow; return allocate(count); }
+void* operator new[](std::size_t count, std::nothrow_t const&) noexcept{ ++threadCounts.nothrow; return allocate(count); }
+
+void operator delete  (void* p) noexcept{ release(p); }
+void operator delete[](void* p) noexcept{ release(p); }
+void operator delete  (void* p, std::nothrow_t const&) noexcept{ release(p); }
+void operator delete[](void* p, std::nothrow_t const&) noexcept{ release(p); }
+
+#ifdef __cpp_sized_deallocation
+void operator delete  (void* p, std::size_t) noexcept{ release(p); }
+void operator delete[](void* p, std::size_t) noexcept{ release(p); }
+#endif
 
+#ifdef __cpp_aligned_new
+void* operator new  (std::size_t count, std::align_val_t al){ return allocateAlignedOrThrow(count,al); }
+void* operator new[](std::size_t count, std::align_val_t al){ return allocateAlignedOrThrow(count,al); }
+void* operator new  (std::size_t count, std::align_val_t al, std::nothrow_t const&) noexcept{ ++threadCounts.nothrow; return allocateAligned(count,al); }
+void* operator new[](std::size_t count, std::align_val_t al, std::nothrow_t const&) noexcept{ ++threadCounts.nothrow; return allocateAligned(count,al); }
 
+void operator delete  (void* p, std::align_val_t) noexcept{ release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept{ release(p); }
+void operator delete  (void* p, std::size_t, std::align_val_t) noexcept{ release(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept{ release(p); }
+void operator delete  (void* p, std::align_val_t, std::nothrow_t const&) noexcept{ release(p); }
+void operator delete[](void* p, std::align_val_t, std::nothrow_t const&) noexcept{ release(p); }
+#endif
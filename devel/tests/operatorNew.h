@@ -1,15 +1,32 @@
 #pragma once
 
+#include <cstddef>
 #include <new>
 
 
-int& newCallCount();
+//allocations of all threads by any operator new
+int newCallCount();
 
 
-void* operator new  ( std::size_t count );
-void* operator new[]( std::size_t count );
+struct AllocationCounts{
+    int allocations;    //by any operator new
+    int frees;          //by any operator delete
+    std::size_t bytes;  //allocated
+    int aligned;        //by the align_val_t variants
+    int nothrow;        //by the nothrow_t variants
 
+    AllocationCounts operator-(AllocationCounts const& o) const{
+        return {allocations-o.allocations,frees-o.frees,bytes-o.bytes,aligned-o.aligned,nothrow-o.nothrow};
+    }
+};
 
-//void* operator new  ( std::size_t count, const std::nothrow_t& tag);
-//void* operator new[]( std::size_t count, const std::nothrow_t& tag);
+//allocations and frees of the calling thread since it was started
+AllocationCounts threadAllocationCounts();
 
+//allocations and frees of the calling thread while f() is called
+template<typename Func>
+AllocationCounts countAllocations(Func&& f){
+    const AllocationCounts before = threadAllocationCounts();
+    f();
+    return threadAllocationCounts() - before;
+}
@@ -4,6 +4,23 @@ HEADERS += \
     $$PWD/InstanceTest.h \
     $$PWD/RegistrationTest.h \
     $$PWD/OptionalValueTest.h \
+    $$PWD/SmallFunctionTest.h \
+    $$PWD/SwappableInstanceTest.h \
+    $$PWD/StartupTest.h \
+    $$PWD/RegistryTest.h \
+    $$PWD/TraceTest.h \
+    $$PWD/AccessCountTest.h \
+    $$PWD/LazyInstanceTest.h \
+    $$PWD/CoroutineTest.h \
+    $$PWD/WhenAllAvailableTest.h \
+    $$PWD/ExecutorTest.h \
+    $$PWD/NoHeapTest.h \
+    $$PWD/FreezeTest.h \
+    $$PWD/KeyedInstanceTest.h \
+    $$PWD/PerCpuTest.h \
+    $$PWD/TestContextTest.h \
+    $$PWD/AllocationTest.h \
+    $$PWD/PinTest.h \
     $$PWD/operatorNew.h
 
 SOURCES += \
@@ -11,6 +28,23 @@ SOURCES += \
     $$PWD/InstanceTest.cpp \
     $$PWD/RegistrationTest.cpp \
     $$PWD/OptionalValueTest.cpp \
+    $$PWD/SmallFunctionTest.cpp \
+    $$PWD/SwappableInstanceTest.cpp \
+    $$PWD/StartupTest.cpp \
+    $$PWD/RegistryTest.cpp \
+    $$PWD/TraceTest.cpp \
+    $$PWD/AccessCountTest.cpp \
+    $$PWD/LazyInstanceTest.cpp \
+    $$PWD/CoroutineTest.cpp \
+    $$PWD/WhenAllAvailableTest.cpp \
+    $$PWD/ExecutorTest.cpp \
+    $$PWD/NoHeapTest.cpp \
+    $$PWD/FreezeTest.cpp \
+    $$PWD/KeyedInstanceTest.cpp \
+    $$PWD/PerCpuTest.cpp \
+    $$PWD/TestContextTest.cpp \
+    $$PWD/AllocationTest.cpp \
+    $$PWD/PinTest.cpp \
     $$PWD/operatorNew.cpp
 
 
@@ -0,0 +1,69 @@
+# Compiles instance<T>()->foo() with every available compiler and optimization
+# level and checks that the generated access code contains no guard for
+# thread-safe static initialization. The unchecked access frozenInstance<T>()
+# must additionally contain no null check. Run from devel/tools.
+
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+#config
+compilers = ['g++', 'clang++']
+optimizations = ['-O2', '-O3']
+flags = ['-std=c++11', '-fno-rtti', '-DNDEBUG', '-S', '-o', '-']
+includeDir = os.path.abspath('..')
+guards = ['__cxa_guard', '_ZGV']
+functions = [('_Z14accessInstancev', guards),
+             ('_Z12accessFrozenv', guards + ['onNullPtrAccess', 'test', 'cmp'])]
+
+snippet = '''
+#include <src/globalInstances.h>
+
+struct A { int foo(); };
+
+int accessInstance() { return global::instance<A>()->foo(); }
+
+int accessFrozen() { return global::frozenInstance<A>().foo(); }
+'''
+
+
+def functionBody( asm, name ):
+    match = re.search('^' + name + ':\n(.*?)\t\\.cfi_endproc', asm, re.S | re.M)
+    return match.group(1) if match else None
+
+
+def check( compiler, optimization, source ):
+    asm = subprocess.check_output([compiler, optimization, '-I', includeDir] + flags + [source]).decode()
+    return all([checkFunction(asm, name, forbidden, compiler + ' ' + optimization) for name, forbidden in functions])
+
+
+def checkFunction( asm, name, forbidden, config ):
+    body = functionBody(asm, name)
+    if body is None:
+        print (config + ': ' + name + ' not found')
+        return False
+
+    instructions = [l for l in body.splitlines() if l.startswith('\t') and not l.startswith('\t.')]
+    found = [f for f in forbidden if any(f in l for l in instructions)]
+    status = 'FAILED, found ' + ', '.join(found) if found else 'ok'
+    print (config + ' ' + name + ': ' + status)
+    print (''.join(l + '\n' for l in instructions))
+    return not found
+
+
+#execute
+with tempfile.NamedTemporaryFile(mode='w', suffix='.cpp', delete=False) as f:
+    f.write(snippet)
+
+results = [check(c, o, f.name) for c in compilers if shutil.which(c) for o in optimizations]
+os.remove(f.name)
+
+if not results:
+    print ('no compiler found')
+    sys.exit(1)
+
+print ('done.')
+sys.exit(0 if all(results) else 1)
@@ -0,0 +1,86 @@
+# Compiles a translation unit accessing N types by instance<T>()->foo() against the
+# access-only and the full single header with every available compiler and reports the
+# front-end time (-fsyntax-only, best of several runs) and the size of the object file.
+# The full header of the baseline revision is compiled as well and the access-only header
+# has to be faster to parse, otherwise the benchmark fails. Run from devel/tools after
+# makeSingleHeader.py.
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+#config
+compilers = ['g++', 'clang++']
+typeCounts = [1, 100, 1000]
+variants = [('access', 'globalInstanceAccess.h'), ('full', 'globalInstances.h'), ('baseline', 'baseline/globalInstances.h')]
+flags = ['-std=c++11', '-O2']
+includeDir = os.path.abspath('../../include')
+repetitions = 3
+baselineRevision = 'e3d99f2' # before the access-only header was split off
+
+
+def writeBaselineHeader( directory ):
+    header = subprocess.check_output(['git', 'show', baselineRevision + ':include/globalInstances.h'])
+    os.makedirs(os.path.join(directory, 'baseline'))
+    with open(os.path.join(directory, 'baseline', 'globalInstances.h'), 'wb') as f:
+        f.write(header)
+
+
+def source( header, typeCount ):
+    lines = ['#include <' + header + '>\n']
+    for i in range(typeCount):
+        lines.append('struct T%d { int foo(); };\n' % i)
+        lines.append('int access%d() { return global::instance<T%d>()->foo(); }\n' % (i, i))
+    return ''.join(lines)
+
+
+def frontEndSeconds( compiler, file ):
+    best = None
+    for _ in range(repetitions):
+        begin = time.perf_counter()
+        subprocess.check_call([compiler, '-fsyntax-only', '-I', includeDir, '-I', os.path.dirname(file)] + flags + [file])
+        elapsed = time.perf_counter() - begin
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+
+def objectBytes( compiler, file, directory ):
+    obj = os.path.join(directory, 'benchmark.o')
+    subprocess.check_call([compiler, '-c', '-I', includeDir, '-I', os.path.dirname(file)] + flags + [file, '-o', obj])
+    return os.path.getsize(obj)
+
+
+#execute
+directory = tempfile.mkdtemp()
+writeBaselineHeader(directory)
+available = [c for c in compilers if shutil.which(c)]
+slower = []
+
+for compiler in available:
+    print ('\n' + compiler + ' ' + ' '.join(flags))
+    print ('%-8s %6s %12s %12s' % ('variant', 'types', 'front-end s', 'object kB'))
+    for typeCount in typeCounts:
+        seconds = {}
+        for name, header in variants:
+            file = os.path.join(directory, 'benchmark.cpp')
+            with open(file, 'w') as f:
+                f.write(source(header, typeCount))
+            seconds[name] = frontEndSeconds(compiler, file)
+            kilobytes = objectBytes(compiler, file, directory) / 1024.0
+            print ('%-8s %6d %12.3f %12.1f' % (name, typeCount, seconds[name], kilobytes))
+        if seconds['access'] >= seconds['baseline']:
+            slower.append('%s with %d types' % (compiler, typeCount))
+
+shutil.rmtree(directory)
+
+if not available:
+    print ('no compiler found')
+
+if slower:
+    print ('FAILED, the access-only header is not faster to parse than the baseline: ' + ', '.join(slower))
+    sys.exit(1)
+
+print ('done.')
@@ -8,10 +8,10 @@ table = [
     'control over destruction point in time |  full | none | none | full | full | full | none | none | full | full',
     'automatic destruction | X | X | X | - | -<sup>3</sup> | - | X | X | -<sup>4</sup> | X',
     'constructor arguments | X | - | X<sup>1</sup> | - | - | - | X | - | - | up to 4',
-    'threadsave construction | - | X | X | - | - | X<sup>5</sup> | X | X | X | optional',
+    'threadsave construction | X<sup>7</sup> | X | X | - | - | X<sup>5</sup> | X | X | X | optional',
     'implementation pattern | indep. class | function | CRTP | macro |  indep. class  | CRTP | CRTP | indep. class | indep. class | indep. class',
     'forces virtual destructor | - | - | X | - | - | X | - | - | - | -',
-    'thread local instances | - | - | - | - | - | - | - | - | X | -']
+    'thread local instances | X | - | - | - | - | - | - | - | X | -']
 
 for x in range(11):
 
@@ -2,22 +2,35 @@ import makeSingleHeaderHelpers as hlp
 
 #config
 singleHeaderProxy = '../src/globalInstances.h'
+accessHeaderProxy = '../src/globalInstanceAccess.h'
+accessGuard = 'GLOBAL_INSTANCE_ACCESS_INCLUDED' # lets both headers be included by the same translation unit
 collapseNamespaceDetail = True
 ns_global = 'global'
 ns_detail = 'detail'
 clang_format_style = hlp.LLVM
 
 
+def code( headers ):
+    includes, code = hlp.headerContents(headers, ns_global)
+    return includes, hlp.collapsNamespace(ns_detail,code) if collapseNamespaceDetail else ''.join(code)
+
+
 #execute
-headerFiles = hlp.getIncludeFiles( singleHeaderProxy )
-singleHeaderTarget = headerFiles.pop(0) #first header is the target header
+accessHeaderFiles = hlp.getIncludeFiles( accessHeaderProxy )
+accessHeaderTarget = accessHeaderFiles.pop(0) #first header is the target header
 
-includes, code = hlp.headerContents(headerFiles, ns_global)
+headerFiles = hlp.getIncludeFiles( singleHeaderProxy )
+singleHeaderTarget = headerFiles.pop(0)
+headerFiles.remove(accessHeaderProxy) #replaced by the code of the access header
 
-codeJoined = hlp.collapsNamespace(ns_detail,code) if collapseNamespaceDetail else ''.join(code)
+accessIncludes, accessCode = code(accessHeaderFiles)
+accessCode = hlp.guarded(accessCode, accessGuard)
+includes, restCode = code(headerFiles)
 
-hlp.writeHeader(singleHeaderTarget, includes, codeJoined, ns_global)
+hlp.writeHeader(accessHeaderTarget, accessIncludes, accessCode, ns_global)
+hlp.writeHeader(singleHeaderTarget, accessIncludes + includes, accessCode + '\n' + restCode, ns_global)
 
+hlp.clang_format_inplace(accessHeaderTarget,clang_format_style)
 hlp.clang_format_inplace(singleHeaderTarget,clang_format_style)
 
-print ('done.')
\ No newline at end of file
+print ('done.')
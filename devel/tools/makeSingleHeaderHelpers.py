@@ -1,4 +1,5 @@
 import re
+import shutil
 import subprocess
 import os.path
 
@@ -27,6 +28,8 @@ def headerContent( fileContent, ns ):
     includes = []
     dst = []
     bracketLevel = 0
+    beforeNamespace = True
+    nested = None
 
     for line in fileContent:
 
@@ -44,9 +47,21 @@ def headerContent( fileContent, ns ):
             continue
         if line.startswith('namespace ' + ns):
             assert bracketLevel==1
+            beforeNamespace = False
+            continue
+        if beforeNamespace and bracketLevel==0 and line.lstrip().startswith('#'): # e.g. conditional includes or feature detection
+            includes.append(line)
             continue
         if line.startswith('}') and bracketLevel == 0: # end of ns scope
             continue
+        if line.startswith('namespace ') and bracketLevel == 2: # nested ns, normalized for collapsNamespace
+            nested = line.split()[1]
+            dst.append('namespace ' + nested + ' {\n')
+            continue
+        if line.startswith('}') and bracketLevel == 1 and nested is not None: # end of nested ns
+            dst.append('} // namespace ' + nested + '\n')
+            nested = None
+            continue
         if line =='\n' and bracketLevel <= 1:
             continue
 
@@ -58,6 +73,25 @@ def headerContent( fileContent, ns ):
     return includes,dst
 
 
+#drops unconditional includes of headers already included unconditionally
+def uniqueIncludes( lines ):
+    seen = set()
+    res = []
+    depth = 0
+    for line in lines:
+        if line.startswith('#if'):
+            depth += 1
+        elif line.startswith('#endif'):
+            depth -= 1
+        elif depth==0 and line.startswith('#include <'):
+            header = line.split('>')[0]
+            if header in seen:
+                continue
+            seen.add(header)
+        res.append(line)
+    return res
+
+
 def headerContents( headers, ns ): 
 
     inc = []
@@ -73,7 +107,10 @@ def headerContents( headers, ns ):
 
 
 def collapsNamespace( ns, lines ):
-    return re.sub('\n}[\n| ].*\n*namespace ' + ns + ' {.*\n', '', ''.join(lines))
+    return re.sub('\n} // namespace ' + ns + '\n\\s*namespace ' + ns + ' {\n', '\n', ''.join(lines))
+
+def guarded(body, guard):
+    return '#ifndef ' + guard + '\n#define ' + guard + '\n\n' + body + '\n#endif // ' + guard + '\n'
 
 def assembleHeader(includes, body, ns) :
     r = ''
@@ -94,7 +131,7 @@ def assembleHeader(includes, body, ns) :
 
 def writeHeader(singleHeaderTarget, includes, codeJoined, ns):
     with open(singleHeaderTarget,'w') as f:
-        f.write(assembleHeader(''.join(includes),codeJoined,ns))
+        f.write(assembleHeader(''.join(uniqueIncludes(includes)),codeJoined,ns))
 
 
 
@@ -105,5 +142,10 @@ Mozilla = 'Mozilla'
 WebKit = 'WebKit'
 
 
+clang_formats = ['clang-format-5.0', 'clang-format']
+
 def clang_format_inplace(file, style):
-    subprocess.check_output( ['clang-format-5.0', '-i', '-style=' + style, file] )
\ No newline at end of file
+    available = [c for c in clang_formats if shutil.which(c)]
+    if not available:
+        raise RuntimeError('no clang-format found (tried ' + ', '.join(clang_formats) + '), cannot format ' + file)
+    subprocess.check_output( [available[0], '-i', '-style=' + style, file] )
\ No newline at end of file
@@ -0,0 +1,62 @@
+# Builds devel/benchmark.pro for every available compiler and optimization
+# level and reports ns/op and instructions/op for each benchmark.
+# Run from devel/tools, requires qmake and, for instruction counts, Linux perf
+# events to be accessible (see /proc/sys/kernel/perf_event_paranoid).
+
+import os
+import re
+import shutil
+import subprocess
+
+#config
+qmake = 'qmake'
+specs = {'g++': 'linux-g++', 'clang++': 'linux-clang'}
+optimizations = ['-O2', '-O3']
+project = os.path.abspath('../benchmark.pro')
+buildRoot = os.path.abspath('../../BuildBenchmarks')
+binary = 'benchmark'
+source = os.path.abspath('../benchmarks/InstanceBenchmark.cpp')
+
+resultPattern = re.compile('RESULT : InstanceBenchmark::(\\w+)\\(\\):\\s*\n\\s*([0-9.e+-]+) (msecs|instructions) per iteration')
+
+
+#each QBENCHMARK iteration runs this many operations, the results are reported per operation
+def operationsPerIteration():
+    with open(source,'r') as f:
+        return int(re.search('constexpr int operationsPerIteration = (\\d+);', f.read()).group(1))
+
+
+def build( compiler, optimization ):
+    buildDir = os.path.join(buildRoot, compiler.replace('+', 'x') + optimization)
+    if not os.path.isdir(buildDir):
+        os.makedirs(buildDir)
+    subprocess.check_call([qmake, project, '-spec', specs[compiler],
+                           'QMAKE_CXXFLAGS_RELEASE=' + optimization], cwd=buildDir)
+    subprocess.check_call(['make', '-j4'], cwd=buildDir)
+    return os.path.join(buildDir, binary)
+
+
+def measure( executable, args ):
+    output = subprocess.check_output([executable] + args).decode()
+    return {m.group(1): (float(m.group(2)), m.group(3)) for m in resultPattern.finditer(output)}
+
+
+def nanoseconds( value ):
+    return value[0] * 1e6 if value[1] == 'msecs' else value[0]
+
+
+#execute
+operations = operationsPerIteration()
+for compiler in [c for c in sorted(specs) if shutil.which(c)]:
+    for optimization in optimizations:
+        executable = build(compiler, optimization)
+        times = measure(executable, [])
+        instructions = measure(executable, ['-perf', '-perfcounter', 'instructions'])
+
+        print ('\n' + compiler + ' ' + optimization)
+        print ('%-34s %10s %10s' % ('benchmark', 'ns/op', 'instr/op'))
+        for name in sorted(times):
+            instr = instructions.get(name, (float('nan'), ''))[0]
+            print ('%-34s %10.3f %10.2f' % (name, nanoseconds(times[name]) / operations, instr / operations))
+
+print ('done.')
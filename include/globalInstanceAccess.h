@@ -0,0 +1,942 @@
+#pragma once
+
+#ifdef __has_cpp_attribute
+#ifndef __cpp_exceptions
+#define EXCEPTIONS_DISABLED
+#endif
+#else
+#if (!defined(__clang__)) && (__GNUC__ >= 4) && (__GNUC_MINOR__ >= 7) &&       \
+    (__GNUC_PATCHLEVEL__ >= 1)
+#ifndef __EXCEPTIONS
+#define EXCEPTIONS_DISABLED
+#endif
+#else
+#warning Cannot detect if exceptions are enabled, so enabling them by default. They can be manually disabled by defining 'EXCEPTIONS_DISABLED'
+#endif // __GNUC__
+#endif // __has_cpp_attribute
+#ifndef COROUTINES_DISABLED
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#define COROUTINES_AVAILABLE
+#endif
+#endif
+#endif             // COROUTINES_DISABLED
+#ifdef EXCEPTIONS_DISABLED
+#include <cstdlib> //for exit(1);
+#endif
+#include <exception>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#ifndef GLOBAL_THREAD_RECORD_CAPACITY
+#define GLOBAL_THREAD_RECORD_CAPACITY 16
+#endif
+#ifndef GLOBAL_INSTANCE_TYPE_CAPACITY
+#define GLOBAL_INSTANCE_TYPE_CAPACITY 1024
+#endif
+#if defined(GLOBAL_TEST_CONTEXTS) && defined(GLOBAL_NO_HEAP)
+#error GLOBAL_TEST_CONTEXTS enlarges the calls handed to executors and cannot be combined with GLOBAL_NO_HEAP
+#endif
+#ifdef __GNUC__
+#define GLOBAL_COLD __attribute__((noinline, cold))
+#else
+#define GLOBAL_COLD
+#endif
+
+namespace global {
+
+#ifndef GLOBAL_INSTANCE_ACCESS_INCLUDED
+#define GLOBAL_INSTANCE_ACCESS_INCLUDED
+
+// gcc has its own macro prior to supporting __has_cpp_attribute
+
+// defines COROUTINES_AVAILABLE if the compiler and the standard library support
+// c++20 coroutines, they can be manually disabled by defining
+// 'COROUTINES_DISABLED'
+
+namespace detail {
+
+template <typename T> T &staticValue() {
+  static T t;
+  return t;
+}
+
+// T needs a constexpr default constructor, then the value is
+// constant-initialized and the access needs no guard for thread-safe static
+// initialization
+template <typename T> struct ConstantStaticValue { static T value; };
+
+template <typename T> T ConstantStaticValue<T>::value;
+
+template <typename T> T &constantStaticValue() {
+  return ConstantStaticValue<T>::value;
+}
+
+template <typename T> void throwImpl(T t) {
+
+#ifdef EXCEPTIONS_DISABLED
+  (void)t; // avoid unused
+  exit(1);
+#else
+  throw t;
+#endif
+}
+
+} // namespace detail
+
+class NullptrAccess : public std::exception {};
+template <typename T = void> void onNullPtrAccess() {
+  detail::throwImpl(NullptrAccess{});
+}
+// override by spcializing
+// template<> void onNullPtrAccess<>(){ exit(1); }
+
+namespace detail {
+
+// minimal lock for the rarely taken registration paths, usable without
+// thread support from the standard library (e.g. on embedded targets)
+class SpinLock {
+
+public:
+  void lock() {
+    while (flag.test_and_set(std::memory_order_acquire)) {
+    }
+  }
+  void unlock() { flag.clear(std::memory_order_release); }
+
+private:
+  std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+class SpinLockGuard {
+
+public:
+  explicit SpinLockGuard(SpinLock &l) : spinLock(l) { spinLock.lock(); }
+  ~SpinLockGuard() { spinLock.unlock(); }
+
+private:
+  SpinLockGuard(SpinLockGuard const &) = delete;
+  SpinLockGuard &operator=(SpinLockGuard const &) = delete;
+
+  SpinLock &spinLock;
+};
+
+} // namespace detail
+
+// define GLOBAL_NO_HEAP for the whole program to never allocate, SmallVector
+// and SmallFunction then fail instead of using the heap and thread records are
+// taken from a static pool
+class CapacityExceeded : public std::exception {};
+
+// maximum number of records per record type if GLOBAL_NO_HEAP is defined, i.e.
+// of threads at once using e.g. SwappableInstance::ReadSection
+namespace detail {
+
+// per thread state which other threads need to scan, each record has its
+// own cache line so threads never write to a shared one
+struct alignas(64) ThreadRecord {
+  std::atomic<std::uint64_t> epoch{0}; // 0 if not within a read section
+  std::atomic<bool> used{true};
+  ThreadRecord *next = nullptr;
+};
+
+// records are never freed but reused after their thread exits, Record needs
+// the members 'used' and 'next' like ThreadRecord
+template <typename Record = ThreadRecord> class ThreadRecords {
+
+public:
+  static Record *first() { return head().load(std::memory_order_acquire); }
+
+  // number of records created so far, the highest number of threads using them
+  // at once
+  static std::size_t created() {
+    return pool().count.load(std::memory_order_relaxed);
+  }
+
+  static Record &local() {
+    thread_local Owner owner;
+    return *owner.record;
+  }
+
+  // the record of the calling thread or nullptr if it has none yet, does not
+  // create one
+  static Record *localIfCreated() { return current(); }
+
+private:
+  struct Owner {
+    Owner() : record(acquire()) { current() = record; }
+    ~Owner() {
+      current() = nullptr;
+      record->used.store(false, std::memory_order_release);
+    }
+    Record *record;
+  };
+
+  // constant-initialized, so reading it does not construct the Owner
+  static Record *&current() {
+    thread_local Record *record = nullptr;
+    return record;
+  }
+
+  static std::atomic<Record *> &head() {
+    return constantStaticValue<std::atomic<Record *>>();
+  }
+
+  static Record *acquire() {
+
+    for (Record *r = first(); r != nullptr; r = r->next) {
+      bool expected = false;
+      if (r->used.compare_exchange_strong(expected, true))
+        return r;
+    }
+
+    Record *r = new (allocate())
+        Record(); // zero initializes members without initializer
+    r->next = head().load(std::memory_order_relaxed);
+    while (!head().compare_exchange_weak(r->next, r)) {
+    }
+    return r;
+  }
+
+#ifdef GLOBAL_NO_HEAP
+
+  struct Pool {
+    constexpr Pool() : records{}, count(0) {}
+    typename std::aligned_storage<sizeof(Record), alignof(Record)>::type
+        records[GLOBAL_THREAD_RECORD_CAPACITY];
+    std::atomic<std::size_t> count;
+  };
+
+  static void *allocate() {
+    const std::size_t i = pool().count.fetch_add(1, std::memory_order_relaxed);
+    if (i >= GLOBAL_THREAD_RECORD_CAPACITY) {
+      pool().count.fetch_sub(1, std::memory_order_relaxed);
+      detail::throwImpl(CapacityExceeded{});
+    }
+    return &pool().records[i];
+  }
+
+#else
+
+  struct Pool {
+    constexpr Pool() : count(0) {}
+    std::atomic<std::size_t> count;
+  };
+
+  static void *allocate() {
+    pool().count.fetch_add(1, std::memory_order_relaxed);
+
+    // operator new does not respect the alignment before c++17
+    auto raw = reinterpret_cast<std::uintptr_t>(
+        ::operator new(sizeof(Record) + alignof(Record)));
+    auto aligned =
+        (raw + alignof(Record) - 1) & ~std::uintptr_t(alignof(Record) - 1);
+    return reinterpret_cast<void *>(aligned);
+  }
+
+#endif // GLOBAL_NO_HEAP
+
+  static Pool &pool() { return constantStaticValue<Pool>(); }
+};
+
+} // namespace detail
+
+// allows thread local instances of T if specialized to be true,
+// in that case instance<T>() checks for a thread local instance first
+template <typename T> struct ThreadLocalAccess : std::false_type {};
+// override by spcializing
+// template<> struct ThreadLocalAccess<A> : std::true_type {};
+namespace detail {
+
+template <typename T> struct ThreadLocalPointer {
+  static thread_local T *value;
+};
+
+template <typename T> thread_local T *ThreadLocalPointer<T>::value = nullptr;
+
+} // namespace detail
+
+// replicates T per cpu if specialized to be true, in that case instance<T>()
+// returns the replica of the calling cpu and T has to be registered by a
+// PerCpuInstance<T>
+template <typename T> struct PerCpuAccess : std::false_type {};
+// override by spcializing
+// template<> struct PerCpuAccess<A> : std::true_type {};
+namespace detail {
+
+// cache line aligned so cpus never write to the same line
+template <typename T> struct alignas(64) Replica {
+  template <typename... Args>
+  explicit Replica(Args &&...args) : value(static_cast<Args &&>(args)...) {}
+  T value;
+};
+
+// set by cpuCount() before the first PerCpuInstance is registered, so querying
+// the cpu stays out of the translation units which only access instances
+struct Cpus {
+  constexpr Cpus() : count(0), current(nullptr) {}
+  std::atomic<std::size_t> count;         // number of replicas
+  std::atomic<std::size_t (*)()> current; // the cpu of the calling thread
+};
+
+inline Cpus &cpus() { return constantStaticValue<Cpus>(); }
+
+template <typename T> T *replica(T *first, std::size_t cpu) {
+  const std::size_t n = cpus().count.load(std::memory_order_relaxed);
+  if (cpu >= n)
+    cpu %= n; // cpus added after counting, or thread indices
+  return &(reinterpret_cast<Replica<T> *>(first) + cpu)->value;
+}
+
+// expects a PerCpuInstance to be registered
+template <typename T> T *localReplica(T *first) {
+  return replica(first, cpus().current.load(std::memory_order_relaxed)());
+}
+
+} // namespace detail
+
+// allows lazy instances of T if specialized to be true, only then instance<T>()
+// looks for a LazyInstance<T> to construct if no instance is registered
+template <typename T> struct LazyAccess : std::false_type {};
+// override by spcializing
+// template<> struct LazyAccess<A> : std::true_type {};
+
+// number of distinct types accessed by instance<T>() which fit into the
+// statically allocated table, more types get heap allocated chunks of the same
+// size unless GLOBAL_NO_HEAP is defined
+namespace detail {
+
+class InstanceRegistry;
+
+template <typename T> class InstancePointer;
+
+// the signature of this function names T, typeName<T>() trims it to the name
+template <typename T> char const *signature() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  return __FUNCSIG__;
+#else
+  return __PRETTY_FUNCTION__;
+#endif
+}
+
+} // namespace detail
+class TooManyInstanceTypes : public std::exception {};
+// the most deferred calls queued at once for a type and how many fit without
+// allocation
+struct DeferredCallUsage {
+  std::size_t highWatermark;
+  std::size_t capacity;
+};
+// instance pointer and queued deferred calls of one type, taken by a
+// RegistrySnapshot
+struct CapturedInstance {
+  void *instance;
+  void *parkedCalls; // owned, nullptr if no calls were queued
+  std::size_t endedRegistrations; // at the time of the capture
+};
+// the deferred calls of a type, installed by the first of them since the
+// translation units which only access instances do not compile them
+struct DeferredCallHooks {
+  DeferredCallUsage (*usage)();
+  CapturedInstance (*capture)();
+  void (*restore)(CapturedInstance);
+};
+struct TypeName;
+class RegistrySnapshot;
+// entry of the registry, describes one type accessed by instance<T>()
+class InstanceType {
+
+public:
+  constexpr InstanceType()
+      : index(0), slot(nullptr), required(false), signatureOf(nullptr),
+        hooks(nullptr) {}
+
+  std::size_t id() const { return index; }
+  TypeName name() const; // defined in TypeName.h
+  bool registered() const {
+    return slot->load(std::memory_order_acquire) != nullptr;
+  }
+  bool requiredOnFreeze() const {
+    return required;
+  } // false for lazy and thread local types
+
+  // zero if no deferred call of the type was made
+  DeferredCallUsage deferredCalls() const {
+    DeferredCallHooks const *h = hooks.load(std::memory_order_acquire);
+    return h != nullptr ? h->usage() : DeferredCallUsage{0, 0};
+  }
+
+private:
+  friend class detail::InstanceRegistry;
+  friend class RegistrySnapshot;
+
+  // without hooks no instance was registered and no call queued yet, so there
+  // is nothing to park
+  CapturedInstance capture() const {
+    DeferredCallHooks const *h = hooks.load(std::memory_order_acquire);
+    if (h != nullptr)
+      return h->capture();
+    return CapturedInstance{slot->load(std::memory_order_acquire), nullptr, 0};
+  }
+
+  void restore(CapturedInstance c) const {
+    DeferredCallHooks const *h = hooks.load(std::memory_order_acquire);
+    if (h != nullptr)
+      h->restore(c);
+  }
+
+  std::size_t index;
+  std::atomic<void *> const *slot;
+  bool required;
+  char const *(*signatureOf)();
+  std::atomic<DeferredCallHooks const *> hooks;
+};
+namespace detail {
+
+constexpr std::size_t unassignedTypeId = static_cast<std::size_t>(-1);
+
+template <typename T> struct TypeId { static std::atomic<std::size_t> value; };
+
+template <typename T>
+std::atomic<std::size_t> TypeId<T>::value{unassignedTypeId};
+
+// array indexed by type id, the first chunk is part of the table so it can be
+// constant-initialized, the chunks for more types are allocated on first use
+// and stay valid until freeChunks()
+template <typename Item> class TypeIdTable {
+
+public:
+  static constexpr std::size_t chunkSize = GLOBAL_INSTANCE_TYPE_CAPACITY;
+
+  constexpr TypeIdTable() : first{}, more(nullptr) {}
+
+  // nullptr if no item for the id was allocated yet, lock-free
+  Item *find(std::size_t id) {
+    if (id < chunkSize)
+      return &first[id];
+    Chunk *c = more.load(std::memory_order_acquire);
+    for (std::size_t i = id / chunkSize - 1; i > 0 && c != nullptr; --i)
+      c = c->next.load(std::memory_order_acquire);
+    return c != nullptr ? &c->items[id % chunkSize] : nullptr;
+  }
+
+  Item const *find(std::size_t id) const {
+    return const_cast<TypeIdTable *>(this)->find(id);
+  }
+
+  // allocates the chunk of the id if needed
+  Item &at(std::size_t id) {
+    if (id < chunkSize)
+      return first[id];
+    std::atomic<Chunk *> *link = &more;
+    for (std::size_t i = id / chunkSize; i > 0; --i) {
+      Chunk *c = link->load(std::memory_order_acquire);
+      if (c == nullptr)
+        c = allocate(*link);
+      if (i == 1)
+        return c->items[id % chunkSize];
+      link = &c->next;
+    }
+    return first[id]; // not reached
+  }
+
+  // expects no concurrent access
+  void freeChunks() {
+    Chunk *c = more.exchange(nullptr, std::memory_order_relaxed);
+    while (c != nullptr) {
+      Chunk *next = c->next.load(std::memory_order_relaxed);
+      delete c;
+      c = next;
+    }
+  }
+
+private:
+  struct Chunk {
+    Item items[chunkSize];
+    std::atomic<Chunk *> next;
+  };
+
+  static Chunk *allocate(std::atomic<Chunk *> &link) {
+#ifdef GLOBAL_NO_HEAP
+    (void)link;
+    detail::throwImpl(TooManyInstanceTypes{});
+    return nullptr;
+#else
+    Chunk *c = new Chunk(); // value-initialized, so the items start zeroed
+    Chunk *expected = nullptr;
+    if (link.compare_exchange_strong(expected, c, std::memory_order_acq_rel))
+      return c;
+    delete c; // allocated by another thread meanwhile
+    return expected;
+#endif
+  }
+
+  TypeIdTable(TypeIdTable const &) = delete;
+  TypeIdTable &operator=(TypeIdTable const &) = delete;
+
+  Item first[chunkSize];
+  std::atomic<Chunk *> more;
+};
+
+// table of all types accessed by instance<T>(), ids are the indices into it and
+// entries are never removed
+class InstanceRegistry {
+
+public:
+  constexpr InstanceRegistry() : count(0) {}
+
+  // returns the id of T, assigns the next free one on the first call
+  template <typename T> std::size_t add() {
+
+    SpinLockGuard guard(lock);
+
+    std::atomic<std::size_t> &id = TypeId<T>::value;
+    if (id.load(std::memory_order_relaxed) != unassignedTypeId)
+      return id.load(std::memory_order_relaxed);
+
+    const std::size_t next = count.load(std::memory_order_relaxed);
+    InstanceType &e = entries.at(
+        next); // throws TooManyInstanceTypes if GLOBAL_NO_HEAP is defined
+
+    e.index = next;
+    e.slot = &constantStaticValue<InstancePointer<T>>().instancePtr;
+    e.required = !LazyAccess<T>::value && !ThreadLocalAccess<T>::value;
+    e.signatureOf = &signature<T>;
+    count.store(next + 1, std::memory_order_release); // publishes the entry
+    id.store(next, std::memory_order_release);
+    return next;
+  }
+
+  std::size_t size() const { return count.load(std::memory_order_acquire); }
+
+  // expects id<size()
+  void installHooks(std::size_t id, DeferredCallHooks const *hooks) {
+    entries.find(id)->hooks.store(hooks, std::memory_order_release);
+  }
+
+  // expects id<size()
+  InstanceType const &operator[](std::size_t id) const {
+    return *entries.find(id);
+  }
+
+private:
+  InstanceRegistry(InstanceRegistry const &) = delete;
+  InstanceRegistry &operator=(InstanceRegistry const &) = delete;
+
+  TypeIdTable<InstanceType> entries;
+  std::atomic<std::size_t> count;
+  SpinLock lock;
+};
+
+inline InstanceRegistry &instanceRegistry() {
+  return constantStaticValue<InstanceRegistry>();
+}
+
+// its dynamic initialization enters T into the registry before main,
+// instance<T>() odr-uses it
+template <typename T> struct TypeIdRegistrar {
+  static const std::size_t value;
+};
+
+template <typename T>
+const std::size_t TypeIdRegistrar<T>::value = instanceRegistry().add<T>();
+
+} // namespace detail
+// dense id of T starting at 0, types accessed by instance<T>() get theirs
+// during static initialization
+template <typename T> std::size_t typeId() {
+  const std::size_t id =
+      detail::TypeId<T>::value.load(std::memory_order_acquire);
+  return id != detail::unassignedTypeId ? id
+                                        : detail::instanceRegistry().add<T>();
+}
+// number of types accessed by instance<T>()
+inline std::size_t instanceTypeCount() {
+  return detail::instanceRegistry().size();
+}
+// calls f(InstanceType const&) for all types accessed by instance<T>() in the
+// order of their ids
+template <typename Func> void forEachInstanceType(Func f) {
+  detail::InstanceRegistry const &r = detail::instanceRegistry();
+  for (std::size_t id = 0, size = r.size(); id < size; ++id)
+    f(r[id]);
+}
+// true if an instance is registered for all types accessed by instance<T>(),
+// except for the ones with LazyAccess or ThreadLocalAccess which might
+// legitimately have none
+inline bool allInstancesRegistered() {
+  detail::InstanceRegistry const &r = detail::instanceRegistry();
+  for (std::size_t id = 0, size = r.size(); id < size; ++id)
+    if (r[id].requiredOnFreeze() && !r[id].registered())
+      return false;
+  return true;
+}
+
+// true if an instance is registered for each of Ts
+template <typename... Ts> bool instancesRegistered() {
+  const bool registered[] = {
+      true, detail::instanceRegistry()[typeId<Ts>()].registered()...};
+  for (bool r : registered)
+    if (!r)
+      return false;
+  return true;
+}
+
+// define GLOBAL_TEST_CONTEXTS for the whole test program to let TestInstance
+// replace instances only within the test context bound to the registering
+// thread, otherwise contexts compile to nothing
+#ifdef GLOBAL_TEST_CONTEXTS
+class TestContext;
+namespace detail {
+
+template <typename T> class TestContextRegistration;
+
+// constant initialized, so the access needs no guard
+inline TestContext *&currentTestContext() {
+  static thread_local TestContext *context = nullptr;
+  return context;
+}
+
+// binds a context to the calling thread for its lifetime, the previous one is
+// restored afterwards
+class TestContextBinding {
+
+public:
+  explicit TestContextBinding(TestContext *c) : previous(currentTestContext()) {
+    currentTestContext() = c;
+  }
+  ~TestContextBinding() { currentTestContext() = previous; }
+
+private:
+  TestContextBinding(TestContextBinding const &) = delete;
+  TestContextBinding &operator=(TestContextBinding const &) = delete;
+
+  TestContext *previous;
+};
+
+// overrides the registered instance by nullptr within a context
+struct NoInstanceOverride {
+  constexpr NoInstanceOverride() {}
+};
+
+inline void *noInstanceOverride() {
+  return &constantStaticValue<NoInstanceOverride>();
+}
+
+} // namespace detail
+// instances replaced by TestInstance while the context is bound to the
+// registering thread are visible only to the threads the context is bound to,
+// so tests replacing the same type can run concurrently
+class TestContext {
+
+public:
+  // binds itself to the constructing thread until destruction, expects to be
+  // destructed on the same thread
+  TestContext() : binding(this) {}
+  ~TestContext() { overrides.freeChunks(); }
+
+  // the context bound to the calling thread or nullptr
+  static TestContext *current() { return detail::currentTestContext(); }
+
+  // the override of the type with the id or nullptr, lock-free
+  void *find(std::size_t id) const {
+    std::atomic<void *> const *o = overrides.find(id);
+    return o != nullptr ? o->load(std::memory_order_acquire) : nullptr;
+  }
+
+private:
+  template <typename> friend class detail::TestContextRegistration;
+
+  void *exchange(std::size_t id, void *o) {
+    return overrides.at(id).exchange(o, std::memory_order_acq_rel);
+  }
+
+  TestContext(TestContext const &) = delete;
+  TestContext &operator=(TestContext const &) = delete;
+
+  detail::TypeIdTable<std::atomic<void *>> overrides;
+  detail::TestContextBinding binding; // after the overrides
+};
+namespace detail {
+
+// the override of the context bound to the calling thread, nullptr if there is
+// none
+inline void *testContextOverride(std::size_t id) {
+  TestContext *c = currentTestContext();
+  return c != nullptr ? c->find(id) : nullptr;
+}
+
+} // namespace detail
+#endif // GLOBAL_TEST_CONTEXTS
+
+// define GLOBAL_COUNT_ACCESSES for the whole program to count the accesses of
+// each type by operator-> and operator*, otherwise the counting compiles to
+// nothing
+namespace detail {
+
+#ifdef GLOBAL_COUNT_ACCESSES
+
+// counters of one thread indexed by type id, only written by their thread
+struct alignas(64) AccessCounterShard {
+  TypeIdTable<std::atomic<std::uint64_t>> accesses;
+  TypeIdTable<std::atomic<std::uint64_t>> nullAccesses;
+  std::atomic<bool> used{true};
+  AccessCounterShard *next = nullptr;
+};
+
+// no read-modify-write is needed since there is a single writer
+inline void incrementCounter(std::atomic<std::uint64_t> &c) {
+  c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template <typename T> void countAccess(bool isNull) {
+  AccessCounterShard &shard = ThreadRecords<AccessCounterShard>::local();
+  const std::size_t id = typeId<T>();
+  incrementCounter(shard.accesses.at(id));
+  if (isNull)
+    incrementCounter(shard.nullAccesses.at(id));
+}
+
+#else
+
+template <typename T> void countAccess(bool) {}
+
+#endif // GLOBAL_COUNT_ACCESSES
+
+} // namespace detail
+
+// keeps rarely taken paths out of the accessing functions
+class RegistryNotFrozen : public std::exception {};
+template <typename T> class Pinned;
+struct InlineExecutor;
+template <typename, typename> class LazyInstance;
+namespace detail {
+
+class InstanceRegistry;
+
+// registrations, deferred calls and pins of instance<T>(), defined by
+// globalInstances.h only
+template <typename T> class InstanceSlot;
+
+template <typename Func, typename... Ts> class WhenAll;
+
+#ifdef COROUTINES_AVAILABLE
+template <typename, typename> class AvailableAwaiter;
+
+template <typename, typename> class UnavailableAwaiter;
+#endif
+
+// set by freeze(), kept apart from the other freeze state since unchecked()
+// reads it
+struct FrozenFlag {
+  constexpr FrozenFlag() : value(false) {}
+  std::atomic<bool> value;
+};
+
+inline std::atomic<bool> &frozenFlag() {
+  return constantStaticValue<FrozenFlag>().value;
+}
+
+inline bool isFrozen() { return frozenFlag().load(std::memory_order_acquire); }
+
+template <typename T> class InstancePointer {
+
+public:
+  constexpr explicit InstancePointer() : instancePtr(nullptr) {}
+
+  operator bool() const { return get() != nullptr; }
+
+  bool operator==(T const *t) const { return get() == t; }
+  bool operator!=(T const *t) const { return get() != t; }
+
+  explicit operator T *() const { return operator->(); }
+
+  T &operator*() const & {
+    T *t = get();
+    if (t == nullptr)
+      t = constructLazily(LazyAccess<T>{});
+    countAccess<T>(t == nullptr);
+    return *t;
+  }
+  T *operator->() const {
+    T *t = get();
+    if (t == nullptr)
+      t = constructLazily(LazyAccess<T>{});
+    countAccess<T>(t == nullptr);
+    if (t == nullptr)
+      global::onNullPtrAccess<>();
+    return t;
+  }
+
+  // the returned guard keeps the instance from being deregistered until it is
+  // destructed, pinning and unpinning only write to memory of the calling
+  // thread; does not construct lazy instances
+  Pinned<T> pin() const { return InstanceSlot<T>::pin(); }
+
+  // for hot paths after freeze(), the instance is not checked if NDEBUG is
+  // defined
+  T &unchecked() const {
+#ifdef NDEBUG
+    return *get();
+#else
+    if (!isFrozen())
+      throwImpl(RegistryNotFrozen{});
+    return *operator->();
+#endif
+  }
+
+  template <typename Func> void ifAvailable(Func func) {
+    InstanceSlot<T>::ifAvailable(static_cast<Func &&>(func));
+  }
+
+  template <typename Func> void becomesUnavailable(Func func) {
+    InstanceSlot<T>::becomesUnavailable(static_cast<Func &&>(func));
+  }
+
+  // func is passed to executor.execute(), it is skipped if no instance
+  // is registered anymore when the executor runs it
+  template <typename Executor, typename Func>
+  void ifAvailable(Executor &executor, Func func) {
+    InstanceSlot<T>::ifAvailable(executor, static_cast<Func &&>(func));
+  }
+
+  // func is passed to executor.execute(), the deregistration waits until it is
+  // finished and calls it itself if the executor has not started it yet
+  template <typename Executor, typename Func>
+  void becomesUnavailable(Executor &executor, Func func) {
+    InstanceSlot<T>::becomesUnavailable(executor, static_cast<Func &&>(func));
+  }
+
+#ifdef COROUTINES_AVAILABLE
+
+  AvailableAwaiter<T, InlineExecutor> available() {
+    return available(InstanceSlot<T>::inlineExecutor());
+  }
+
+  template <typename Executor>
+  AvailableAwaiter<T, Executor> available(Executor &e) {
+    return {*this, e};
+  }
+
+  UnavailableAwaiter<T, InlineExecutor> unavailable() {
+    return unavailable(InstanceSlot<T>::inlineExecutor());
+  }
+
+  template <typename Executor>
+  UnavailableAwaiter<T, Executor> unavailable(Executor &e) {
+    return {*this, e};
+  }
+
+#endif // COROUTINES_AVAILABLE
+
+private:
+#ifdef GLOBAL_TEST_CONTEXTS
+  // an override of the test context bound to the calling thread comes first
+  T *get() const {
+    void *o = testContextOverride(typeId<T>());
+    if (o != nullptr)
+      return o != noInstanceOverride() ? static_cast<T *>(o) : nullptr;
+    return get(ThreadLocalAccess<T>{});
+  }
+#else
+  T *get() const { return get(ThreadLocalAccess<T>{}); }
+#endif
+
+  T *get(std::false_type /*thread local*/) const {
+    return local(static_cast<T *>(instancePtr.load(std::memory_order_acquire)));
+  }
+
+  // touches only thread local memory if a thread local instance is registered
+  T *get(std::true_type /*thread local*/) const {
+    T *t = ThreadLocalPointer<T>::value;
+    return t != nullptr ? t : get(std::false_type{});
+  }
+
+  // the replica of the calling cpu if T is replicated per cpu, otherwise t
+  static T *local(T *t) { return local(t, PerCpuAccess<T>{}); }
+  static T *local(T *t, std::false_type /*per cpu*/) { return t; }
+  static T *local(T *t, std::true_type /*per cpu*/) {
+    return t != nullptr ? localReplica(t) : nullptr;
+  }
+
+  // folded away, so the null branch of types without lazy access is unchanged
+  static T *constructLazily(std::false_type /*lazy*/) { return nullptr; }
+
+  // only called if no instance is registered, returns the lazily constructed
+  // one if a LazyInstance is declared; kept out of line since it runs at most a
+  // few times
+  GLOBAL_COLD T *constructLazily(std::true_type /*lazy*/) const {
+    LazySlot &l = lazySlot();
+    LazyConstructor lazy;
+    {
+      SpinLockGuard guard(l.lock);
+      lazy = l.constructor;
+      if (lazy.construct == nullptr)
+        return nullptr;
+      l.constructing.fetch_add(
+          1, std::memory_order_relaxed); // keeps the owner alive, see
+                                         // ~LazyInstance
+    }
+    struct Finished {
+      std::atomic<unsigned> &constructing;
+      ~Finished() { constructing.fetch_sub(1, std::memory_order_release); }
+    } finished{l.constructing};
+    return lazy.construct(lazy.owner);
+  }
+
+  friend class InstanceSlot<T>;
+
+  template <typename, typename> friend class ::global::LazyInstance;
+
+  friend class InstanceRegistry;
+
+  template <typename Func, typename... Ts> friend class WhenAll;
+
+  template <typename> friend struct PerCpuReplicas;
+
+#ifdef COROUTINES_AVAILABLE
+  template <typename, typename> friend class AvailableAwaiter;
+#endif
+
+  using ClassType = InstancePointer<T>;
+
+  InstancePointer(ClassType const &) = delete;
+  ClassType const &operator=(ClassType const &) = delete;
+
+  struct LazyConstructor {
+    T *(*construct)(void *owner);
+    void *owner;
+  };
+
+  // constant-initialized so the inlined null path of operator-> needs no guard
+  struct LazySlot {
+    constexpr LazySlot() : constructor{nullptr, nullptr}, constructing(0) {}
+    LazyConstructor constructor;
+    std::atomic<unsigned>
+        constructing; // number of calls of constructor.construct in progress
+    SpinLock lock;
+  };
+
+  static LazySlot &lazySlot() { return constantStaticValue<LazySlot>(); }
+
+  // type erased so the registry can check all slots without knowing their types
+  std::atomic<void *> instancePtr;
+};
+
+} // namespace detail
+
+template <typename T> detail::InstancePointer<T> &instance() {
+  (void)&detail::TypeIdRegistrar<T>::value; // enters T into the registry,
+                                            // generates no code here
+  return detail::constantStaticValue<detail::InstancePointer<T>>();
+}
+template <typename T> T &instanceRef() { return *instance<T>(); }
+template <typename T> const T &instanceCRef() { return *instance<T>(); }
+// expects freeze() to be called, compiles to a single load if NDEBUG is defined
+template <typename T> T &frozenInstance() { return instance<T>().unchecked(); }
+
+#endif // GLOBAL_INSTANCE_ACCESS_INCLUDED
+
+} // namespace global
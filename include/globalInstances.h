@@ -1,19 +1,10 @@
 #pragma once
 
-#include <cstdlib> //for exit(1);
-#include <exception>
-#include <functional>
-#include <list>
-#include <utility>
-
-namespace global {
-
 #ifdef __has_cpp_attribute
 #ifndef __cpp_exceptions
 #define EXCEPTIONS_DISABLED
 #endif
 #else
-// gcc has its own macro prior to supporting __has_cpp_attribute
 #if (!defined(__clang__)) && (__GNUC__ >= 4) && (__GNUC_MINOR__ >= 7) &&       \
     (__GNUC_PATCHLEVEL__ >= 1)
 #ifndef __EXCEPTIONS
@@ -23,6 +14,81 @@ namespace global {
 #warning Cannot detect if exceptions are enabled, so enabling them by default. They can be manually disabled by defining 'EXCEPTIONS_DISABLED'
 #endif // __GNUC__
 #endif // __has_cpp_attribute
+#ifndef COROUTINES_DISABLED
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __cpp_impl_coroutine >= 201902L && __has_include(<coroutine>)
+#define COROUTINES_AVAILABLE
+#endif
+#endif
+#endif // COROUTINES_DISABLED
+#ifdef EXCEPTIONS_DISABLED
+#include <cstdlib> //for exit(1);
+#endif
+#include <exception>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#ifndef GLOBAL_THREAD_RECORD_CAPACITY
+#define GLOBAL_THREAD_RECORD_CAPACITY 16
+#endif
+#ifndef GLOBAL_INSTANCE_TYPE_CAPACITY
+#define GLOBAL_INSTANCE_TYPE_CAPACITY 1024
+#endif
+#if defined(GLOBAL_TEST_CONTEXTS) && defined(GLOBAL_NO_HEAP)
+#error GLOBAL_TEST_CONTEXTS enlarges the calls handed to executors and cannot be combined with GLOBAL_NO_HEAP
+#endif
+#ifdef __GNUC__
+#define GLOBAL_COLD __attribute__((noinline, cold))
+#else
+#define GLOBAL_COLD
+#endif
+#include <cstring>
+#include <string>
+#include <utility>
+#ifdef COROUTINES_AVAILABLE
+#include <coroutine>
+#endif
+#ifdef GLOBAL_TRACE
+#include <chrono>
+#include <mutex>
+#include <vector>
+#endif
+#if defined(GLOBAL_TRACE) && defined(GLOBAL_NO_HEAP)
+#error GLOBAL_TRACE records the events on the heap and cannot be combined with GLOBAL_NO_HEAP
+#endif
+#include <cassert>
+#include <thread>
+#ifndef GLOBAL_PINS_PER_THREAD
+#define GLOBAL_PINS_PER_THREAD 4
+#endif
+#ifndef GLOBAL_DEFERRED_CALL_CAPACITY
+#define GLOBAL_DEFERRED_CALL_CAPACITY 4
+#endif
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+
+namespace global {
+
+#ifndef GLOBAL_INSTANCE_ACCESS_INCLUDED
+#define GLOBAL_INSTANCE_ACCESS_INCLUDED
+
+// gcc has its own macro prior to supporting __has_cpp_attribute
+
+// defines COROUTINES_AVAILABLE if the compiler and the standard library support
+// c++20 coroutines, they can be manually disabled by defining
+// 'COROUTINES_DISABLED'
 
 namespace detail {
 
@@ -31,6 +97,17 @@ template <typename T> T &staticValue() {
   return t;
 }
 
+// T needs a constexpr default constructor, then the value is
+// constant-initialized and the access needs no guard for thread-safe static
+// initialization
+template <typename T> struct ConstantStaticValue { static T value; };
+
+template <typename T> T ConstantStaticValue<T>::value;
+
+template <typename T> T &constantStaticValue() {
+  return ConstantStaticValue<T>::value;
+}
+
 template <typename T> void throwImpl(T t) {
 
 #ifdef EXCEPTIONS_DISABLED
@@ -52,192 +129,3817 @@ template <typename T = void> void onNullPtrAccess() {
 
 namespace detail {
 
-class bad_optional_access_impl : public std::exception {};
-
-using bad_optional_access =
-    bad_optional_access_impl; // use c++17 version if available
-
-template <typename T> class OptionalValueImpl {
+// minimal lock for the rarely taken registration paths, usable without
+// thread support from the standard library (e.g. on embedded targets)
+class SpinLock {
 
 public:
-  explicit OptionalValueImpl() {}
-
-  OptionalValueImpl &operator=(T const &t) {
-    val = t;
-    m_hasValue = true;
-    return *this;
+  void lock() {
+    while (flag.test_and_set(std::memory_order_acquire)) {
+    }
   }
+  void unlock() { flag.clear(std::memory_order_release); }
 
-  explicit operator T() const {
-    if (!m_hasValue)
-      throwImpl(bad_optional_access{});
-    return val;
-  }
+private:
+  std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
 
-  bool has_value() const { return m_hasValue; }
-  void reset() { m_hasValue = false; }
+class SpinLockGuard {
+
+public:
+  explicit SpinLockGuard(SpinLock &l) : spinLock(l) { spinLock.lock(); }
+  ~SpinLockGuard() { spinLock.unlock(); }
 
 private:
-  T val;
-  bool m_hasValue = false;
+  SpinLockGuard(SpinLockGuard const &) = delete;
+  SpinLockGuard &operator=(SpinLockGuard const &) = delete;
+
+  SpinLock &spinLock;
 };
 
-template <typename T>
-using optional = OptionalValueImpl<T>; // use c++17 version if available
+} // namespace detail
 
-template <typename T> class InstancePointer {
+// define GLOBAL_NO_HEAP for the whole program to never allocate, SmallVector
+// and SmallFunction then fail instead of using the heap and thread records are
+// taken from a static pool
+class CapacityExceeded : public std::exception {};
 
-public:
-  explicit InstancePointer() {}
+// maximum number of records per record type if GLOBAL_NO_HEAP is defined, i.e.
+// of threads at once using e.g. SwappableInstance::ReadSection
+namespace detail {
 
-  operator bool() const { return instancePtr != nullptr; }
+// per thread state which other threads need to scan, each record has its
+// own cache line so threads never write to a shared one
+struct alignas(64) ThreadRecord {
+  std::atomic<std::uint64_t> epoch{0}; // 0 if not within a read section
+  std::atomic<bool> used{true};
+  ThreadRecord *next = nullptr;
+};
 
-  bool operator==(T const *t) const { return instancePtr == t; }
-  bool operator!=(T const *t) const { return instancePtr != t; }
+// records are never freed but reused after their thread exits, Record needs
+// the members 'used' and 'next' like ThreadRecord
+template <typename Record = ThreadRecord> class ThreadRecords {
 
-  explicit operator T *() const { return operator->(); }
+public:
+  static Record *first() { return head().load(std::memory_order_acquire); }
 
-  T &operator*() const & { return *instancePtr; }
-  T *operator->() const {
-    if (instancePtr == nullptr)
-      global::onNullPtrAccess<>();
-    return instancePtr;
+  // number of records created so far, the highest number of threads using them
+  // at once
+  static std::size_t created() {
+    return pool().count.load(std::memory_order_relaxed);
   }
 
-  template <typename Func> void ifAvailable(Func func) {
-    if (instancePtr != nullptr) {
-      func(*instancePtr);
-      return;
+  static Record &local() {
+    thread_local Owner owner;
+    return *owner.record;
+  }
+
+  // the record of the calling thread or nullptr if it has none yet, does not
+  // create one
+  static Record *localIfCreated() { return current(); }
+
+private:
+  struct Owner {
+    Owner() : record(acquire()) { current() = record; }
+    ~Owner() {
+      current() = nullptr;
+      record->used.store(false, std::memory_order_release);
     }
-    ifAvailableOps.emplace_back(func);
+    Record *record;
+  };
+
+  // constant-initialized, so reading it does not construct the Owner
+  static Record *&current() {
+    thread_local Record *record = nullptr;
+    return record;
   }
 
-  template <typename Func> void becomesUnavailable(Func func) {
-    becomesUnavailableOps.emplace_back(func); // never directly
+  static std::atomic<Record *> &head() {
+    return constantStaticValue<std::atomic<Record *>>();
   }
 
-private:
-  InstancePointer &operator=(T *t) {
-    if (instancePtr == t)
-      return *this; // nothing changed
-    auto before = instancePtr;
-    instancePtr = t;
+  static Record *acquire() {
 
-    if (instancePtr != nullptr) {
-      for (auto const &op : ifAvailableOps)
-        op(*instancePtr);
-      ifAvailableOps.clear();
+    for (Record *r = first(); r != nullptr; r = r->next) {
+      bool expected = false;
+      if (r->used.compare_exchange_strong(expected, true))
+        return r;
     }
-    if (before != nullptr && instancePtr == nullptr) {
-      for (auto const &op : becomesUnavailableOps)
-        op(*before);
-      becomesUnavailableOps.clear();
+
+    Record *r = new (allocate())
+        Record(); // zero initializes members without initializer
+    r->next = head().load(std::memory_order_relaxed);
+    while (!head().compare_exchange_weak(r->next, r)) {
     }
-    return *this;
+    return r;
   }
 
-  template <typename> friend class ReplacingInstanceRegistration;
+#ifdef GLOBAL_NO_HEAP
 
-  using ClassType = InstancePointer<T>;
+  struct Pool {
+    constexpr Pool() : records{}, count(0) {}
+    typename std::aligned_storage<sizeof(Record), alignof(Record)>::type
+        records[GLOBAL_THREAD_RECORD_CAPACITY];
+    std::atomic<std::size_t> count;
+  };
 
-  InstancePointer(ClassType const &) = delete;
-  ClassType const &operator=(ClassType const &) = delete;
+  static void *allocate() {
+    const std::size_t i = pool().count.fetch_add(1, std::memory_order_relaxed);
+    if (i >= GLOBAL_THREAD_RECORD_CAPACITY) {
+      pool().count.fetch_sub(1, std::memory_order_relaxed);
+      detail::throwImpl(CapacityExceeded{});
+    }
+    return &pool().records[i];
+  }
 
-  using DeferredOperation = std::list<std::function<void(T &)>>;
-  DeferredOperation ifAvailableOps;
-  DeferredOperation becomesUnavailableOps;
+#else
+
+  struct Pool {
+    constexpr Pool() : count(0) {}
+    std::atomic<std::size_t> count;
+  };
+
+  static void *allocate() {
+    pool().count.fetch_add(1, std::memory_order_relaxed);
+
+    // operator new does not respect the alignment before c++17
+    auto raw = reinterpret_cast<std::uintptr_t>(
+        ::operator new(sizeof(Record) + alignof(Record)));
+    auto aligned =
+        (raw + alignof(Record) - 1) & ~std::uintptr_t(alignof(Record) - 1);
+    return reinterpret_cast<void *>(aligned);
+  }
 
-  T *instancePtr = nullptr;
+#endif // GLOBAL_NO_HEAP
+
+  static Pool &pool() { return constantStaticValue<Pool>(); }
 };
 
 } // namespace detail
 
-template <typename T> detail::InstancePointer<T> &instance() {
-  return detail::staticValue<detail::InstancePointer<T>>();
+// allows thread local instances of T if specialized to be true,
+// in that case instance<T>() checks for a thread local instance first
+template <typename T> struct ThreadLocalAccess : std::false_type {};
+// override by spcializing
+// template<> struct ThreadLocalAccess<A> : std::true_type {};
+namespace detail {
+
+template <typename T> struct ThreadLocalPointer {
+  static thread_local T *value;
+};
+
+template <typename T> thread_local T *ThreadLocalPointer<T>::value = nullptr;
+
+} // namespace detail
+
+// replicates T per cpu if specialized to be true, in that case instance<T>()
+// returns the replica of the calling cpu and T has to be registered by a
+// PerCpuInstance<T>
+template <typename T> struct PerCpuAccess : std::false_type {};
+// override by spcializing
+// template<> struct PerCpuAccess<A> : std::true_type {};
+namespace detail {
+
+// cache line aligned so cpus never write to the same line
+template <typename T> struct alignas(64) Replica {
+  template <typename... Args>
+  explicit Replica(Args &&...args) : value(static_cast<Args &&>(args)...) {}
+  T value;
+};
+
+// set by cpuCount() before the first PerCpuInstance is registered, so querying
+// the cpu stays out of the translation units which only access instances
+struct Cpus {
+  constexpr Cpus() : count(0), current(nullptr) {}
+  std::atomic<std::size_t> count;         // number of replicas
+  std::atomic<std::size_t (*)()> current; // the cpu of the calling thread
+};
+
+inline Cpus &cpus() { return constantStaticValue<Cpus>(); }
+
+template <typename T> T *replica(T *first, std::size_t cpu) {
+  const std::size_t n = cpus().count.load(std::memory_order_relaxed);
+  if (cpu >= n)
+    cpu %= n; // cpus added after counting, or thread indices
+  return &(reinterpret_cast<Replica<T> *>(first) + cpu)->value;
 }
-template <typename T> T &instanceRef() {
-  return *detail::staticValue<detail::InstancePointer<T>>();
+
+// expects a PerCpuInstance to be registered
+template <typename T> T *localReplica(T *first) {
+  return replica(first, cpus().current.load(std::memory_order_relaxed)());
 }
 
-class InstanceReplacementNotAllowed : public std::exception {};
-class RegisteringNullNotAllowed : public std::exception {};
+} // namespace detail
+
+// allows lazy instances of T if specialized to be true, only then instance<T>()
+// looks for a LazyInstance<T> to construct if no instance is registered
+template <typename T> struct LazyAccess : std::false_type {};
+// override by spcializing
+// template<> struct LazyAccess<A> : std::true_type {};
+
+// number of distinct types accessed by instance<T>() which fit into the
+// statically allocated table, more types get heap allocated chunks of the same
+// size unless GLOBAL_NO_HEAP is defined
 namespace detail {
 
-// replaces existing for the time it exised
-template <typename T> class ReplacingInstanceRegistration {
+class InstanceRegistry;
+
+template <typename T> class InstancePointer;
+
+// the signature of this function names T, typeName<T>() trims it to the name
+template <typename T> char const *signature() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  return __FUNCSIG__;
+#else
+  return __PRETTY_FUNCTION__;
+#endif
+}
+
+} // namespace detail
+class TooManyInstanceTypes : public std::exception {};
+// the most deferred calls queued at once for a type and how many fit without
+// allocation
+struct DeferredCallUsage {
+  std::size_t highWatermark;
+  std::size_t capacity;
+};
+// instance pointer and queued deferred calls of one type, taken by a
+// RegistrySnapshot
+struct CapturedInstance {
+  void *instance;
+  void *parkedCalls; // owned, nullptr if no calls were queued
+  std::size_t endedRegistrations; // at the time of the capture
+};
+// the deferred calls of a type, installed by the first of them since the
+// translation units which only access instances do not compile them
+struct DeferredCallHooks {
+  DeferredCallUsage (*usage)();
+  CapturedInstance (*capture)();
+  void (*restore)(CapturedInstance);
+};
+struct TypeName;
+class RegistrySnapshot;
+// entry of the registry, describes one type accessed by instance<T>()
+class InstanceType {
 
 public:
-  ReplacingInstanceRegistration() {}
-  ReplacingInstanceRegistration(T *t) { registerInstance(t); }
-  void operator()(T *t) { registerInstance(t); }
-  virtual ~ReplacingInstanceRegistration() { deregisterInstance(); }
+  constexpr InstanceType()
+      : index(0), slot(nullptr), required(false), signatureOf(nullptr),
+        hooks(nullptr) {}
 
-  virtual void registerInstance(T *t) {
-    deregisterInstance();
-    replacedInstance = instance<T>().instancePtr;
-    instance<T>() = t; // possibly deregisters again
+  std::size_t id() const { return index; }
+  TypeName name() const; // defined in TypeName.h
+  bool registered() const {
+    return slot->load(std::memory_order_acquire) != nullptr;
   }
+  bool requiredOnFreeze() const {
+    return required;
+  } // false for lazy and thread local types
 
-  virtual void deregisterInstance() {
-    if (replacedInstance.has_value() == false)
-      return; // noting to do
-    T *tmp = static_cast<T *>(replacedInstance);
-    replacedInstance.reset();
-    instance<T>() = tmp; // possibly registers again
+  // zero if no deferred call of the type was made
+  DeferredCallUsage deferredCalls() const {
+    DeferredCallHooks const *h = hooks.load(std::memory_order_acquire);
+    return h != nullptr ? h->usage() : DeferredCallUsage{0, 0};
   }
 
 private:
-  ReplacingInstanceRegistration(ReplacingInstanceRegistration const &) =
-      delete; // no copy
+  friend class detail::InstanceRegistry;
+  friend class RegistrySnapshot;
 
-  detail::optional<T *> replacedInstance;
+  // without hooks no instance was registered and no call queued yet, so there
+  // is nothing to park
+  CapturedInstance capture() const {
+    DeferredCallHooks const *h = hooks.load(std::memory_order_acquire);
+    if (h != nullptr)
+      return h->capture();
+    return CapturedInstance{slot->load(std::memory_order_acquire), nullptr, 0};
+  }
+
+  void restore(CapturedInstance c) const {
+    DeferredCallHooks const *h = hooks.load(std::memory_order_acquire);
+    if (h != nullptr)
+      h->restore(c);
+  }
+
+  std::size_t index;
+  std::atomic<void *> const *slot;
+  bool required;
+  char const *(*signatureOf)();
+  std::atomic<DeferredCallHooks const *> hooks;
 };
+namespace detail {
+
+constexpr std::size_t unassignedTypeId = static_cast<std::size_t>(-1);
+
+template <typename T> struct TypeId { static std::atomic<std::size_t> value; };
 
-// expects nullptr to be registered beforehand
-// expects registration-target not to be null
 template <typename T>
-class InstanceRegistration : ReplacingInstanceRegistration<T> {
+std::atomic<std::size_t> TypeId<T>::value{unassignedTypeId};
+
+// array indexed by type id, the first chunk is part of the table so it can be
+// constant-initialized, the chunks for more types are allocated on first use
+// and stay valid until freeChunks()
+template <typename Item> class TypeIdTable {
+
 public:
-  using Superclass = ReplacingInstanceRegistration<T>;
-  using Superclass::operator();
+  static constexpr std::size_t chunkSize = GLOBAL_INSTANCE_TYPE_CAPACITY;
 
-  InstanceRegistration() : Superclass() {}
-  InstanceRegistration(T *t) : Superclass() { registerInstance(t); }
+  constexpr TypeIdTable() : first{}, more(nullptr) {}
 
-  void registerInstance(T *t) override {
+  // nullptr if no item for the id was allocated yet, lock-free
+  Item *find(std::size_t id) {
+    if (id < chunkSize)
+      return &first[id];
+    Chunk *c = more.load(std::memory_order_acquire);
+    for (std::size_t i = id / chunkSize - 1; i > 0 && c != nullptr; --i)
+      c = c->next.load(std::memory_order_acquire);
+    return c != nullptr ? &c->items[id % chunkSize] : nullptr;
+  }
 
-    if (instance<T>() != nullptr)
-      throwImpl(InstanceReplacementNotAllowed{});
-    if (t == nullptr)
-      throwImpl(RegisteringNullNotAllowed{});
+  Item const *find(std::size_t id) const {
+    return const_cast<TypeIdTable *>(this)->find(id);
+  }
+
+  // allocates the chunk of the id if needed
+  Item &at(std::size_t id) {
+    if (id < chunkSize)
+      return first[id];
+    std::atomic<Chunk *> *link = &more;
+    for (std::size_t i = id / chunkSize; i > 0; --i) {
+      Chunk *c = link->load(std::memory_order_acquire);
+      if (c == nullptr)
+        c = allocate(*link);
+      if (i == 1)
+        return c->items[id % chunkSize];
+      link = &c->next;
+    }
+    return first[id]; // not reached
+  }
+
+  // expects no concurrent access
+  void freeChunks() {
+    Chunk *c = more.exchange(nullptr, std::memory_order_relaxed);
+    while (c != nullptr) {
+      Chunk *next = c->next.load(std::memory_order_relaxed);
+      delete c;
+      c = next;
+    }
+  }
+
+private:
+  struct Chunk {
+    Item items[chunkSize];
+    std::atomic<Chunk *> next;
+  };
 
-    Superclass::registerInstance(t);
+  static Chunk *allocate(std::atomic<Chunk *> &link) {
+#ifdef GLOBAL_NO_HEAP
+    (void)link;
+    detail::throwImpl(TooManyInstanceTypes{});
+    return nullptr;
+#else
+    Chunk *c = new Chunk(); // value-initialized, so the items start zeroed
+    Chunk *expected = nullptr;
+    if (link.compare_exchange_strong(expected, c, std::memory_order_acq_rel))
+      return c;
+    delete c; // allocated by another thread meanwhile
+    return expected;
+#endif
   }
+
+  TypeIdTable(TypeIdTable const &) = delete;
+  TypeIdTable &operator=(TypeIdTable const &) = delete;
+
+  Item first[chunkSize];
+  std::atomic<Chunk *> more;
 };
 
-template <template <typename> class RegistrationType, typename AccessType,
-          typename InstanceType>
-class RegisterdInstanceT {
+// table of all types accessed by instance<T>(), ids are the indices into it and
+// entries are never removed
+class InstanceRegistry {
 
-  InstanceType t;
-  RegistrationType<AccessType> reg;
+public:
+  constexpr InstanceRegistry() : count(0) {}
+
+  // returns the id of T, assigns the next free one on the first call
+  template <typename T> std::size_t add() {
+
+    SpinLockGuard guard(lock);
+
+    std::atomic<std::size_t> &id = TypeId<T>::value;
+    if (id.load(std::memory_order_relaxed) != unassignedTypeId)
+      return id.load(std::memory_order_relaxed);
+
+    const std::size_t next = count.load(std::memory_order_relaxed);
+    InstanceType &e = entries.at(
+        next); // throws TooManyInstanceTypes if GLOBAL_NO_HEAP is defined
+
+    e.index = next;
+    e.slot = &constantStaticValue<InstancePointer<T>>().instancePtr;
+    e.required = !LazyAccess<T>::value && !ThreadLocalAccess<T>::value;
+    e.signatureOf = &signature<T>;
+    count.store(next + 1, std::memory_order_release); // publishes the entry
+    id.store(next, std::memory_order_release);
+    return next;
+  }
+
+  std::size_t size() const { return count.load(std::memory_order_acquire); }
+
+  // expects id<size()
+  void installHooks(std::size_t id, DeferredCallHooks const *hooks) {
+    entries.find(id)->hooks.store(hooks, std::memory_order_release);
+  }
+
+  // expects id<size()
+  InstanceType const &operator[](std::size_t id) const {
+    return *entries.find(id);
+  }
+
+private:
+  InstanceRegistry(InstanceRegistry const &) = delete;
+  InstanceRegistry &operator=(InstanceRegistry const &) = delete;
+
+  TypeIdTable<InstanceType> entries;
+  std::atomic<std::size_t> count;
+  SpinLock lock;
+};
+
+inline InstanceRegistry &instanceRegistry() {
+  return constantStaticValue<InstanceRegistry>();
+}
+
+// its dynamic initialization enters T into the registry before main,
+// instance<T>() odr-uses it
+template <typename T> struct TypeIdRegistrar {
+  static const std::size_t value;
+};
+
+template <typename T>
+const std::size_t TypeIdRegistrar<T>::value = instanceRegistry().add<T>();
+
+} // namespace detail
+// dense id of T starting at 0, types accessed by instance<T>() get theirs
+// during static initialization
+template <typename T> std::size_t typeId() {
+  const std::size_t id =
+      detail::TypeId<T>::value.load(std::memory_order_acquire);
+  return id != detail::unassignedTypeId ? id
+                                        : detail::instanceRegistry().add<T>();
+}
+// number of types accessed by instance<T>()
+inline std::size_t instanceTypeCount() {
+  return detail::instanceRegistry().size();
+}
+// calls f(InstanceType const&) for all types accessed by instance<T>() in the
+// order of their ids
+template <typename Func> void forEachInstanceType(Func f) {
+  detail::InstanceRegistry const &r = detail::instanceRegistry();
+  for (std::size_t id = 0, size = r.size(); id < size; ++id)
+    f(r[id]);
+}
+// true if an instance is registered for all types accessed by instance<T>(),
+// except for the ones with LazyAccess or ThreadLocalAccess which might
+// legitimately have none
+inline bool allInstancesRegistered() {
+  detail::InstanceRegistry const &r = detail::instanceRegistry();
+  for (std::size_t id = 0, size = r.size(); id < size; ++id)
+    if (r[id].requiredOnFreeze() && !r[id].registered())
+      return false;
+  return true;
+}
+
+// true if an instance is registered for each of Ts
+template <typename... Ts> bool instancesRegistered() {
+  const bool registered[] = {
+      true, detail::instanceRegistry()[typeId<Ts>()].registered()...};
+  for (bool r : registered)
+    if (!r)
+      return false;
+  return true;
+}
+
+// define GLOBAL_TEST_CONTEXTS for the whole test program to let TestInstance
+// replace instances only within the test context bound to the registering
+// thread, otherwise contexts compile to nothing
+#ifdef GLOBAL_TEST_CONTEXTS
+class TestContext;
+namespace detail {
+
+template <typename T> class TestContextRegistration;
+
+// constant initialized, so the access needs no guard
+inline TestContext *&currentTestContext() {
+  static thread_local TestContext *context = nullptr;
+  return context;
+}
+
+// binds a context to the calling thread for its lifetime, the previous one is
+// restored afterwards
+class TestContextBinding {
 
 public:
-  template <typename... Args>
-  RegisterdInstanceT(Args &&... args)
-      : t(std::forward<Args>(args)...), reg(&t) {}
+  explicit TestContextBinding(TestContext *c) : previous(currentTestContext()) {
+    currentTestContext() = c;
+  }
+  ~TestContextBinding() { currentTestContext() = previous; }
+
+private:
+  TestContextBinding(TestContextBinding const &) = delete;
+  TestContextBinding &operator=(TestContextBinding const &) = delete;
+
+  TestContext *previous;
+};
+
+// overrides the registered instance by nullptr within a context
+struct NoInstanceOverride {
+  constexpr NoInstanceOverride() {}
 };
 
+inline void *noInstanceOverride() {
+  return &constantStaticValue<NoInstanceOverride>();
+}
+
 } // namespace detail
-template <typename AccessType, typename InstanceType = AccessType>
-using Instance = detail::RegisterdInstanceT<detail::InstanceRegistration,
-                                            AccessType, InstanceType>;
-template <typename AccessType, typename InstanceType = AccessType>
-using TestInstance =
-    detail::RegisterdInstanceT<detail::ReplacingInstanceRegistration,
-                               AccessType, InstanceType>;
-#define GLOBAL_INSTANCE_IS_FRIEND                                              \
-  template <template <typename, typename> class, typename, typename>           \
-  friend class ::global::detail::RegisterdInstanceT
+// instances replaced by TestInstance while the context is bound to the
+// registering thread are visible only to the threads the context is bound to,
+// so tests replacing the same type can run concurrently
+class TestContext {
+
+public:
+  // binds itself to the constructing thread until destruction, expects to be
+  // destructed on the same thread
+  TestContext() : binding(this) {}
+  ~TestContext() { overrides.freeChunks(); }
+
+  // the context bound to the calling thread or nullptr
+  static TestContext *current() { return detail::currentTestContext(); }
+
+  // the override of the type with the id or nullptr, lock-free
+  void *find(std::size_t id) const {
+    std::atomic<void *> const *o = overrides.find(id);
+    return o != nullptr ? o->load(std::memory_order_acquire) : nullptr;
+  }
+
+private:
+  template <typename> friend class detail::TestContextRegistration;
+
+  void *exchange(std::size_t id, void *o) {
+    return overrides.at(id).exchange(o, std::memory_order_acq_rel);
+  }
+
+  TestContext(TestContext const &) = delete;
+  TestContext &operator=(TestContext const &) = delete;
+
+  detail::TypeIdTable<std::atomic<void *>> overrides;
+  detail::TestContextBinding binding; // after the overrides
+};
+namespace detail {
+
+// the override of the context bound to the calling thread, nullptr if there is
+// none
+inline void *testContextOverride(std::size_t id) {
+  TestContext *c = currentTestContext();
+  return c != nullptr ? c->find(id) : nullptr;
+}
+
+} // namespace detail
+#endif // GLOBAL_TEST_CONTEXTS
+
+// define GLOBAL_COUNT_ACCESSES for the whole program to count the accesses of
+// each type by operator-> and operator*, otherwise the counting compiles to
+// nothing
+namespace detail {
+
+#ifdef GLOBAL_COUNT_ACCESSES
+
+// counters of one thread indexed by type id, only written by their thread
+struct alignas(64) AccessCounterShard {
+  TypeIdTable<std::atomic<std::uint64_t>> accesses;
+  TypeIdTable<std::atomic<std::uint64_t>> nullAccesses;
+  std::atomic<bool> used{true};
+  AccessCounterShard *next = nullptr;
+};
+
+// no read-modify-write is needed since there is a single writer
+inline void incrementCounter(std::atomic<std::uint64_t> &c) {
+  c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+template <typename T> void countAccess(bool isNull) {
+  AccessCounterShard &shard = ThreadRecords<AccessCounterShard>::local();
+  const std::size_t id = typeId<T>();
+  incrementCounter(shard.accesses.at(id));
+  if (isNull)
+    incrementCounter(shard.nullAccesses.at(id));
+}
+
+#else
+
+template <typename T> void countAccess(bool) {}
+
+#endif // GLOBAL_COUNT_ACCESSES
+
+} // namespace detail
+
+// keeps rarely taken paths out of the accessing functions
+class RegistryNotFrozen : public std::exception {};
+template <typename T> class Pinned;
+struct InlineExecutor;
+template <typename, typename> class LazyInstance;
+namespace detail {
+
+class InstanceRegistry;
+
+// registrations, deferred calls and pins of instance<T>(), defined by
+// globalInstances.h only
+template <typename T> class InstanceSlot;
+
+template <typename Func, typename... Ts> class WhenAll;
+
+#ifdef COROUTINES_AVAILABLE
+template <typename, typename> class AvailableAwaiter;
+
+template <typename, typename> class UnavailableAwaiter;
+#endif
+
+// set by freeze(), kept apart from the other freeze state since unchecked()
+// reads it
+struct FrozenFlag {
+  constexpr FrozenFlag() : value(false) {}
+  std::atomic<bool> value;
+};
+
+inline std::atomic<bool> &frozenFlag() {
+  return constantStaticValue<FrozenFlag>().value;
+}
+
+inline bool isFrozen() { return frozenFlag().load(std::memory_order_acquire); }
+
+template <typename T> class InstancePointer {
+
+public:
+  constexpr explicit InstancePointer() : instancePtr(nullptr) {}
+
+  operator bool() const { return get() != nullptr; }
+
+  bool operator==(T const *t) const { return get() == t; }
+  bool operator!=(T const *t) const { return get() != t; }
+
+  explicit operator T *() const { return operator->(); }
+
+  T &operator*() const & {
+    T *t = get();
+    if (t == nullptr)
+      t = constructLazily(LazyAccess<T>{});
+    countAccess<T>(t == nullptr);
+    return *t;
+  }
+  T *operator->() const {
+    T *t = get();
+    if (t == nullptr)
+      t = constructLazily(LazyAccess<T>{});
+    countAccess<T>(t == nullptr);
+    if (t == nullptr)
+      global::onNullPtrAccess<>();
+    return t;
+  }
+
+  // the returned guard keeps the instance from being deregistered until it is
+  // destructed, pinning and unpinning only write to memory of the calling
+  // thread; does not construct lazy instances
+  Pinned<T> pin() const { return InstanceSlot<T>::pin(); }
+
+  // for hot paths after freeze(), the instance is not checked if NDEBUG is
+  // defined
+  T &unchecked() const {
+#ifdef NDEBUG
+    return *get();
+#else
+    if (!isFrozen())
+      throwImpl(RegistryNotFrozen{});
+    return *operator->();
+#endif
+  }
+
+  template <typename Func> void ifAvailable(Func func) {
+    InstanceSlot<T>::ifAvailable(static_cast<Func &&>(func));
+  }
+
+  template <typename Func> void becomesUnavailable(Func func) {
+    InstanceSlot<T>::becomesUnavailable(static_cast<Func &&>(func));
+  }
+
+  // func is passed to executor.execute(), it is skipped if no instance
+  // is registered anymore when the executor runs it
+  template <typename Executor, typename Func>
+  void ifAvailable(Executor &executor, Func func) {
+    InstanceSlot<T>::ifAvailable(executor, static_cast<Func &&>(func));
+  }
+
+  // func is passed to executor.execute(), the deregistration waits until it is
+  // finished and calls it itself if the executor has not started it yet
+  template <typename Executor, typename Func>
+  void becomesUnavailable(Executor &executor, Func func) {
+    InstanceSlot<T>::becomesUnavailable(executor, static_cast<Func &&>(func));
+  }
+
+#ifdef COROUTINES_AVAILABLE
+
+  AvailableAwaiter<T, InlineExecutor> available() {
+    return available(InstanceSlot<T>::inlineExecutor());
+  }
+
+  template <typename Executor>
+  AvailableAwaiter<T, Executor> available(Executor &e) {
+    return {*this, e};
+  }
+
+  UnavailableAwaiter<T, InlineExecutor> unavailable() {
+    return unavailable(InstanceSlot<T>::inlineExecutor());
+  }
+
+  template <typename Executor>
+  UnavailableAwaiter<T, Executor> unavailable(Executor &e) {
+    return {*this, e};
+  }
+
+#endif // COROUTINES_AVAILABLE
+
+private:
+#ifdef GLOBAL_TEST_CONTEXTS
+  // an override of the test context bound to the calling thread comes first
+  T *get() const {
+    void *o = testContextOverride(typeId<T>());
+    if (o != nullptr)
+      return o != noInstanceOverride() ? static_cast<T *>(o) : nullptr;
+    return get(ThreadLocalAccess<T>{});
+  }
+#else
+  T *get() const { return get(ThreadLocalAccess<T>{}); }
+#endif
+
+  T *get(std::false_type /*thread local*/) const {
+    return local(static_cast<T *>(instancePtr.load(std::memory_order_acquire)));
+  }
+
+  // touches only thread local memory if a thread local instance is registered
+  T *get(std::true_type /*thread local*/) const {
+    T *t = ThreadLocalPointer<T>::value;
+    return t != nullptr ? t : get(std::false_type{});
+  }
+
+  // the replica of the calling cpu if T is replicated per cpu, otherwise t
+  static T *local(T *t) { return local(t, PerCpuAccess<T>{}); }
+  static T *local(T *t, std::false_type /*per cpu*/) { return t; }
+  static T *local(T *t, std::true_type /*per cpu*/) {
+    return t != nullptr ? localReplica(t) : nullptr;
+  }
+
+  // folded away, so the null branch of types without lazy access is unchanged
+  static T *constructLazily(std::false_type /*lazy*/) { return nullptr; }
+
+  // only called if no instance is registered, returns the lazily constructed
+  // one if a LazyInstance is declared; kept out of line since it runs at most a
+  // few times
+  GLOBAL_COLD T *constructLazily(std::true_type /*lazy*/) const {
+    LazySlot &l = lazySlot();
+    LazyConstructor lazy;
+    {
+      SpinLockGuard guard(l.lock);
+      lazy = l.constructor;
+      if (lazy.construct == nullptr)
+        return nullptr;
+      l.constructing.fetch_add(
+          1, std::memory_order_relaxed); // keeps the owner alive, see
+                                         // ~LazyInstance
+    }
+    struct Finished {
+      std::atomic<unsigned> &constructing;
+      ~Finished() { constructing.fetch_sub(1, std::memory_order_release); }
+    } finished{l.constructing};
+    return lazy.construct(lazy.owner);
+  }
+
+  friend class InstanceSlot<T>;
+
+  template <typename, typename> friend class ::global::LazyInstance;
+
+  friend class InstanceRegistry;
+
+  template <typename Func, typename... Ts> friend class WhenAll;
+
+  template <typename> friend struct PerCpuReplicas;
+
+#ifdef COROUTINES_AVAILABLE
+  template <typename, typename> friend class AvailableAwaiter;
+#endif
+
+  using ClassType = InstancePointer<T>;
+
+  InstancePointer(ClassType const &) = delete;
+  ClassType const &operator=(ClassType const &) = delete;
+
+  struct LazyConstructor {
+    T *(*construct)(void *owner);
+    void *owner;
+  };
+
+  // constant-initialized so the inlined null path of operator-> needs no guard
+  struct LazySlot {
+    constexpr LazySlot() : constructor{nullptr, nullptr}, constructing(0) {}
+    LazyConstructor constructor;
+    std::atomic<unsigned>
+        constructing; // number of calls of constructor.construct in progress
+    SpinLock lock;
+  };
+
+  static LazySlot &lazySlot() { return constantStaticValue<LazySlot>(); }
+
+  // type erased so the registry can check all slots without knowing their types
+  std::atomic<void *> instancePtr;
+};
+
+} // namespace detail
+
+template <typename T> detail::InstancePointer<T> &instance() {
+  (void)&detail::TypeIdRegistrar<T>::value; // enters T into the registry,
+                                            // generates no code here
+  return detail::constantStaticValue<detail::InstancePointer<T>>();
+}
+template <typename T> T &instanceRef() { return *instance<T>(); }
+template <typename T> const T &instanceCRef() { return *instance<T>(); }
+// expects freeze() to be called, compiles to a single load if NDEBUG is defined
+template <typename T> T &frozenInstance() { return instance<T>().unchecked(); }
+
+#endif // GLOBAL_INSTANCE_ACCESS_INCLUDED
+
+// name of a type as written by the compiler, not null terminated
+struct TypeName {
+  char const *data;
+  std::size_t size;
+
+  std::string str() const { return std::string(data, size); }
+};
+namespace detail {
+
+// returns the part of the signature between the first 'begin' and the last
+// 'end'
+inline TypeName trimSignature(char const *signature, char const *begin,
+                              char const *end) {
+
+  char const *first = std::strstr(signature, begin);
+  if (first == nullptr)
+    return TypeName{signature, std::strlen(signature)};
+  first += std::strlen(begin);
+
+  const std::size_t endSize = std::strlen(end);
+  std::size_t size = std::strlen(first);
+  while (size >= endSize &&
+         std::strncmp(first + size - endSize, end, endSize) != 0)
+    --size;
+  if (size < endSize)
+    return TypeName{first, std::strlen(first)};
+
+  return TypeName{first, size - endSize};
+}
+
+// the type name within the signature returned by signature<T>()
+inline TypeName nameInSignature(char const *signature) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  return trimSignature(signature, "signature<", ">(void)");
+#else
+  return trimSignature(signature, "T = ", "]");
+#endif
+}
+
+} // namespace detail
+// works without rtti, e.g. "A" or "ns::B<int>"
+template <typename T> TypeName typeName() {
+  return detail::nameInSignature(detail::signature<T>());
+}
+inline TypeName InstanceType::name() const {
+  return detail::nameInSignature(signatureOf());
+}
+
+namespace detail {
+
+// move-only replacement for std::function, callables up to 'Size' bytes are
+// stored inline
+template <typename Signature, std::size_t Size = 4 * sizeof(void *)>
+class SmallFunction;
+
+template <typename R, typename... Args, std::size_t Size>
+class SmallFunction<R(Args...), Size> {
+
+  using Storage = typename std::aligned_storage<Size>::type;
+
+  struct Operations {
+    R (*invoke)(Storage &s, Args... args);
+    void (*move)(Storage &from, Storage &to); // leaves 'from' destroyed
+    void (*destroy)(Storage &s);
+  };
+
+  template <typename F> struct Inline {
+    static F &get(Storage &s) { return *reinterpret_cast<F *>(&s); }
+    static R invoke(Storage &s, Args... args) {
+      return get(s)(std::forward<Args>(args)...);
+    }
+    static void move(Storage &from, Storage &to) {
+      new (&to) F(std::move(get(from)));
+      get(from).~F();
+    }
+    static void destroy(Storage &s) { get(s).~F(); }
+  };
+
+  template <typename F> struct Allocated {
+    static F *&get(Storage &s) { return *reinterpret_cast<F **>(&s); }
+    static R invoke(Storage &s, Args... args) {
+      return (*get(s))(std::forward<Args>(args)...);
+    }
+    static void move(Storage &from, Storage &to) { new (&to) F *(get(from)); }
+    static void destroy(Storage &s) { delete get(s); }
+  };
+
+  template <typename F>
+  using fitsInline =
+      std::integral_constant<bool,
+                             sizeof(F) <= Size &&
+                                 std::alignment_of<Storage>::value %
+                                         std::alignment_of<F>::value ==
+                                     0 &&
+                                 std::is_nothrow_move_constructible<F>::value>;
+
+  template <typename Handler> static Operations const *operations() {
+    static constexpr Operations ops{&Handler::invoke, &Handler::move,
+                                    &Handler::destroy};
+    return &ops;
+  }
+
+public:
+  template <typename F>
+  using storedInline = fitsInline<typename std::decay<F>::type>;
+
+  SmallFunction() {}
+
+  template <typename F,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<F>::type, SmallFunction>::value>::type>
+  SmallFunction(F &&f) {
+    using Func = typename std::decay<F>::type;
+    construct<Func>(std::forward<F>(f), fitsInline<Func>{});
+  }
+
+  SmallFunction(SmallFunction &&other) noexcept { takeFrom(other); }
+
+  SmallFunction &operator=(SmallFunction &&other) noexcept {
+    if (this == &other)
+      return *this;
+    reset();
+    takeFrom(other);
+    return *this;
+  }
+
+  ~SmallFunction() { reset(); }
+
+  explicit operator bool() const { return ops != nullptr; }
+
+  R operator()(Args... args) {
+    return ops->invoke(storage, std::forward<Args>(args)...);
+  }
+
+  void reset() {
+    if (ops == nullptr)
+      return;
+    ops->destroy(storage);
+    ops = nullptr;
+  }
+
+private:
+  template <typename Func, typename F>
+  void construct(F &&f, std::true_type /*inline*/) {
+    new (&storage) Func(std::forward<F>(f));
+    ops = operations<Inline<Func>>();
+  }
+
+  template <typename Func, typename F>
+  void construct(F &&f, std::false_type /*inline*/) {
+#ifdef GLOBAL_NO_HEAP
+    static_assert(sizeof(Func) == 0,
+                  "GLOBAL_NO_HEAP: the callable has to fit into the inline "
+                  "storage and be nothrow movable");
+#endif
+    new (&storage) Func *(new Func(std::forward<F>(f)));
+    ops = operations<Allocated<Func>>();
+  }
+
+  void takeFrom(SmallFunction &other) {
+    if (other.ops == nullptr)
+      return;
+    other.ops->move(other.storage, storage);
+    ops = other.ops;
+    other.ops = nullptr;
+  }
+
+  SmallFunction(SmallFunction const &) = delete;
+  SmallFunction &operator=(SmallFunction const &) = delete;
+
+  Storage storage;
+  Operations const *ops = nullptr;
+};
+
+// contiguous storage for move-only elements, the first N elements are stored
+// inline, more than N elements are an error if GLOBAL_NO_HEAP is defined
+template <typename T, std::size_t N> class SmallVector {
+
+#ifdef GLOBAL_NO_HEAP
+  static_assert(N > 0,
+                "GLOBAL_NO_HEAP: a capacity of 0 could never hold an element");
+#endif
+
+public:
+  SmallVector() {}
+
+  SmallVector(SmallVector &&other) noexcept { takeFrom(other); }
+
+  SmallVector &operator=(SmallVector &&other) noexcept {
+    if (this == &other)
+      return *this;
+    clear();
+    releaseHeap();
+    takeFrom(other);
+    return *this;
+  }
+
+  ~SmallVector() {
+    clear();
+    releaseHeap();
+  }
+
+  template <typename... Args> void emplace_back(Args &&...args) {
+    if (count == capacity)
+      grow();
+    new (data() + count) T(std::forward<Args>(args)...);
+    ++count;
+  }
+
+  void clear() {
+    for (std::size_t i = 0; i < count; ++i)
+      data()[i].~T();
+    count = 0;
+  }
+
+  void swap(SmallVector &other) {
+    SmallVector tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+  }
+
+  T *begin() { return data(); }
+  T *end() { return data() + count; }
+
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+private:
+  T *inlineData() { return reinterpret_cast<T *>(&inlineStorage); }
+  T *data() { return heap != nullptr ? heap : inlineData(); }
+
+  void grow() {
+#ifdef GLOBAL_NO_HEAP
+    detail::throwImpl(CapacityExceeded{});
+#endif
+    const std::size_t newCapacity = capacity != 0 ? capacity * 2 : 1;
+    T *newHeap = static_cast<T *>(::operator new(newCapacity * sizeof(T)));
+    moveElements(data(), newHeap, count);
+    releaseHeap();
+    heap = newHeap;
+    capacity = newCapacity;
+  }
+
+  static void moveElements(T *from, T *to, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      new (to + i) T(std::move(from[i]));
+      from[i].~T();
+    }
+  }
+
+  void releaseHeap() {
+    if (heap == nullptr)
+      return;
+    ::operator delete(heap);
+    heap = nullptr;
+    capacity = N;
+  }
+
+  // expects this to be empty
+  void takeFrom(SmallVector &other) {
+    if (other.heap != nullptr) {
+      heap = other.heap;
+      capacity = other.capacity;
+      other.heap = nullptr;
+      other.capacity = N;
+    } else {
+      moveElements(other.inlineData(), inlineData(), other.count);
+    }
+    count = other.count;
+    other.count = 0;
+  }
+
+  SmallVector(SmallVector const &) = delete;
+  SmallVector &operator=(SmallVector const &) = delete;
+
+  typename std::aligned_storage<sizeof(T) * (N != 0 ? N : 1),
+                                std::alignment_of<T>::value>::type
+      inlineStorage; // unused if N is 0
+  T *heap = nullptr;
+  std::size_t count = 0;
+  std::size_t capacity = N;
+};
+
+} // namespace detail
+
+// an executor is any type with a member execute(f) which calls f() eventually,
+// e.g. global::ThreadPool calls f() directly on the calling thread
+struct InlineExecutor {
+  template <typename F> void execute(F &&f) { f(); }
+};
+#ifdef GLOBAL_TEST_CONTEXTS
+namespace detail {
+
+template <typename Func> class BoundToTestContext {
+
+public:
+  BoundToTestContext(Func f, TestContext *c) : func(std::move(f)), context(c) {}
+
+  void operator()() {
+    TestContextBinding binding(context);
+    func();
+  }
+
+private:
+  Func func;
+  TestContext *context;
+};
+
+} // namespace detail
+// binds f() to the test context of the calling thread, so it sees the same
+// overrides on whatever thread it is called, ThreadPool and BatchingExecutor
+// bind the calls they execute by themselves
+template <typename Func>
+detail::BoundToTestContext<typename std::decay<Func>::type>
+bindTestContext(Func &&f) {
+  return {std::forward<Func>(f), TestContext::current()};
+}
+#else
+template <typename Func>
+typename std::decay<Func>::type bindTestContext(Func &&f) {
+  return std::forward<Func>(f);
+}
+#endif // GLOBAL_TEST_CONTEXTS
+
+namespace detail {
+
+#ifdef COROUTINES_AVAILABLE
+
+template <typename T> class InstancePointer;
+
+template <typename T> class InstanceSlot;
+
+// co_await instance<T>().available() suspends until an instance is registered
+// and returns it, the coroutine is resumed by the executor, by default on the
+// registering thread
+template <typename T, typename Executor> class AvailableAwaiter {
+
+public:
+  AvailableAwaiter(InstancePointer<T> &p, Executor &e)
+      : pointer(p), executor(e) {}
+
+  bool await_ready() {
+    t = pointer.get();
+    return t != nullptr;
+  }
+
+  // does not suspend if the instance was registered meanwhile; once queued,
+  // Resume may already run on another thread and destroy the frame, so t must
+  // not be written here afterwards
+  bool await_suspend(std::coroutine_handle<> h) {
+    Resume resume{this, h};
+    T *available = InstanceSlot<T>::availableOrQueue(resume);
+    if (available == nullptr)
+      return true;
+    t = available;
+    return false;
+  }
+
+  T &await_resume() { return *t; }
+
+private:
+  // small enough to be queued without allocation
+  struct Resume {
+    AvailableAwaiter *awaiter;
+    std::coroutine_handle<> handle;
+
+    void operator()(T &t) {
+      awaiter->t = &t;
+      std::coroutine_handle<> h = handle;
+      awaiter->executor.execute([h] { h.resume(); });
+    }
+  };
+
+  InstancePointer<T> &pointer;
+  Executor &executor;
+  T *t = nullptr;
+};
+
+// co_await instance<T>().unavailable() suspends until the instance is
+// deregistered, the coroutine is resumed by the executor, by default on the
+// deregistering thread
+template <typename T, typename Executor> class UnavailableAwaiter {
+
+public:
+  UnavailableAwaiter(InstancePointer<T> &p, Executor &e)
+      : pointer(p), executor(e) {}
+
+  bool await_ready() { return false; }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    Executor &e = executor;
+    pointer.becomesUnavailable(
+        [&e, h](T &) { e.execute([h] { h.resume(); }); });
+  }
+
+  void await_resume() {}
+
+private:
+  InstancePointer<T> &pointer;
+  Executor &executor;
+};
+
+#endif // COROUTINES_AVAILABLE
+
+} // namespace detail
+
+// define GLOBAL_TRACE for the whole program to record construction,
+// registration, deferred calls and destruction of instances, otherwise the
+// trace points compile to nothing
+namespace detail {
+
+#ifdef GLOBAL_TRACE
+
+struct TraceEvent {
+  char const *what;
+  TypeName name;
+  std::uint64_t begin;    // ns
+  std::uint64_t duration; // ns
+  unsigned thread;
+};
+
+class TraceLog {
+
+public:
+  void record(TraceEvent const &e) {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(e);
+  }
+
+  std::vector<TraceEvent> recorded() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.clear();
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+};
+
+// never destructed, so destructions during static destruction can still be
+// recorded
+inline TraceLog &traceLog() {
+  static TraceLog *log = new TraceLog;
+  return *log;
+}
+
+inline std::uint64_t traceNow() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// small ids starting at 1 in the order threads record their first event
+inline unsigned traceThread() {
+  static std::atomic<unsigned> next{1};
+  thread_local unsigned id = next++;
+  return id;
+}
+
+inline void traceRecord(char const *what, TypeName name, std::uint64_t begin) {
+  traceLog().record(
+      TraceEvent{what, name, begin, traceNow() - begin, traceThread()});
+}
+
+// records the time from its construction to its destruction
+template <typename T> class TraceSpan {
+
+public:
+  explicit TraceSpan(char const *w) : what(w), begin(traceNow()) {}
+  ~TraceSpan() { traceRecord(what, typeName<T>(), begin); }
+
+private:
+  TraceSpan(TraceSpan const &) = delete;
+  TraceSpan &operator=(TraceSpan const &) = delete;
+
+  char const *what;
+  std::uint64_t begin;
+};
+
+// base of an instance, records its construction and destruction
+template <typename T> class InstanceTrace {
+
+protected:
+  InstanceTrace() : begin(traceNow()) {}
+  ~InstanceTrace() { traceRecord("destruct", typeName<T>(), begin); }
+
+  template <typename U> U *constructed(U *u) {
+    traceRecord("construct", typeName<T>(), begin);
+    return u;
+  }
+
+  void destructing() { begin = traceNow(); }
+
+private:
+  std::uint64_t begin;
+};
+
+template <typename Stream> void writeTraceString(Stream &out, TypeName name) {
+  for (std::size_t i = 0; i < name.size; ++i) {
+    const char c = name.data[i];
+    if (c == '"' || c == '\\')
+      out << '\\';
+    out << c;
+  }
+}
+
+template <typename Stream>
+void writeTraceEvent(Stream &out, TraceEvent const &e) {
+  out << "{\"name\":\"";
+  writeTraceString(out, e.name);
+  out << "\",\"cat\":\"" << e.what << "\",\"ph\":\"X\""
+      << ",\"ts\":" << e.begin / 1000 << '.' << (e.begin % 1000) / 100
+      << (e.begin % 100) / 10 << e.begin % 10
+      << ",\"dur\":" << e.duration / 1000 << '.' << (e.duration % 1000) / 100
+      << (e.duration % 100) / 10 << e.duration % 10
+      << ",\"pid\":1,\"tid\":" << e.thread << '}';
+}
+
+#else
+
+template <typename T> struct TraceSpan {
+  explicit TraceSpan(char const *) {}
+};
+
+template <typename T> class InstanceTrace {
+
+protected:
+  template <typename U> U *constructed(U *u) { return u; }
+
+  void destructing() {}
+};
+
+#endif // GLOBAL_TRACE
+
+} // namespace detail
+// writes the recorded events in the chrome trace event format, which can be
+// opened by chrome://tracing or perfetto, the trace is empty if GLOBAL_TRACE is
+// not defined
+template <typename Stream> void writeTrace(Stream &out) {
+  out << "{\"traceEvents\":[";
+#ifdef GLOBAL_TRACE
+  bool first = true;
+  for (auto const &e : detail::traceLog().recorded()) {
+    if (!first)
+      out << ',';
+    first = false;
+    out << '\n';
+    detail::writeTraceEvent(out, e);
+  }
+#endif
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+inline void clearTrace() {
+#ifdef GLOBAL_TRACE
+  detail::traceLog().clear();
+#endif
+}
+
+class InstanceMissingOnFreeze : public std::exception {};
+class RegistrationWhileFrozen : public std::exception {};
+namespace detail {
+
+// frozenFlag() is kept with the instance pointer, which reads it
+struct FrozenState {
+  constexpr FrozenState() : freezing(false), changing(0) {}
+  std::atomic<bool>
+      freezing; // set by freeze() while it checks the registrations
+  std::atomic<std::size_t>
+      changing;  //(de)registrations in progress which found neither flag set
+  SpinLock lock; // held by freeze() and by (de)registrations only while a flag
+                 // is set
+};
+
+inline FrozenState &frozenState() { return constantStaticValue<FrozenState>(); }
+
+// spans a (de)registration, so no change completes after freeze() succeeded;
+// unless a freeze is in progress or active this only counts the change, so
+// registrations of different types do not wait for each other
+class FreezeCheck {
+
+public:
+  // throws RegistrationWhileFrozen if frozen, destructing registrations only
+  // report it since destructors cannot throw
+  explicit FreezeCheck(bool destructing) : locked(false), report(false) {
+    FrozenState &s = frozenState();
+    s.changing.fetch_add(
+        1, std::memory_order_seq_cst); // pairs with the flags set by freeze()
+    if (!frozenFlag().load(std::memory_order_seq_cst) &&
+        !s.freezing.load(std::memory_order_seq_cst))
+      return;
+    s.changing.fetch_sub(1, std::memory_order_release);
+
+    s.lock.lock(); // waits for a freeze in progress
+    if (!isFrozen()) {
+      locked = true;
+      return;
+    }
+    if (!destructing) {
+      s.lock.unlock();
+      throwImpl(RegistrationWhileFrozen{});
+    }
+    locked = true;
+    report = true;
+  }
+
+  ~FreezeCheck() {
+    if (locked)
+      frozenState().lock.unlock();
+    else
+      frozenState().changing.fetch_sub(1, std::memory_order_release);
+  }
+
+  // true if the change is to be reported by onDeregistrationWhileFrozen()
+  bool changeWhileFrozen() const { return report; }
+
+private:
+  FreezeCheck(FreezeCheck const &) = delete;
+  FreezeCheck &operator=(FreezeCheck const &) = delete;
+
+  bool locked;
+  bool report;
+};
+
+} // namespace detail
+// called instead of throwing RegistrationWhileFrozen if a registration of T is
+// destructed while frozen, the instance is deregistered anyway
+template <typename T> void onDeregistrationWhileFrozen() {
+  assert(!"registration destructed while frozen, call thaw() before");
+}
+// override by spcializing
+// template<> void onDeregistrationWhileFrozen<A>(){ exit(1); }
+namespace detail {
+
+// freezes if complete() holds once no (de)registration is in progress
+inline void freezeIf(bool (*complete)()) {
+  FrozenState &s = frozenState();
+  SpinLockGuard guard(
+      s.lock); //(de)registrations starting from now on wait for the outcome
+  s.freezing.store(true, std::memory_order_seq_cst);
+  while (s.changing.load(std::memory_order_seq_cst) != 0)
+    std::this_thread::yield(); // the ones started before
+
+  const bool registered = complete();
+  if (registered)
+    frozenFlag().store(true,
+                       std::memory_order_release); // before freezing is cleared
+  s.freezing.store(false, std::memory_order_release);
+  if (!registered)
+    throwImpl(InstanceMissingOnFreeze{});
+}
+
+} // namespace detail
+// declares the registrations complete, expects an instance to be registered for
+// all types accessed by instance<T>() except lazy and thread local ones,
+// afterwards (de)registering is an error until thaw() is called
+inline void freeze() { detail::freezeIf(&allInstancesRegistered); }
+// like freeze(), but only expects instances of Ts to be registered
+template <typename... Ts> void freeze() {
+  detail::freezeIf(&instancesRegistered<Ts...>);
+}
+// allows registrations again, e.g. before shutdown
+inline void thaw() {
+  detail::frozenFlag().store(false, std::memory_order_release);
+}
+inline bool frozen() { return detail::isFrozen(); }
+
+// maximum number of instances one thread can pin at once
+class TooManyPins : public std::exception {};
+class DeregisteringPinnedInstance : public std::exception {};
+namespace detail {
+
+template <typename T> class InstanceSlot;
+
+// hazard pointers of one thread, only written by their thread and on their own
+// cache line
+struct alignas(64) PinRecord {
+  std::atomic<void *> pinned[GLOBAL_PINS_PER_THREAD];
+  std::atomic<bool> used{true};
+  PinRecord *next = nullptr;
+};
+
+// publishes the registered pointer in a free slot of the calling thread and
+// checks that it is still registered afterwards, returns it or nullptr if none
+// is registered
+inline void *pinRegistered(std::atomic<void *> const &registered,
+                           std::atomic<void *> *&slot) {
+
+  PinRecord &r = ThreadRecords<PinRecord>::local();
+  slot = nullptr;
+  for (auto &s : r.pinned)
+    if (s.load(std::memory_order_relaxed) == nullptr) {
+      slot = &s;
+      break;
+    }
+  if (slot == nullptr)
+    throwImpl(TooManyPins{});
+
+  void *p = registered.load(std::memory_order_acquire);
+  while (p != nullptr) {
+    slot->store(p, std::memory_order_seq_cst);
+    void *again = registered.load(std::memory_order_seq_cst);
+    if (again == p)
+      return p;
+    p = again;
+  }
+
+  slot->store(nullptr, std::memory_order_relaxed);
+  slot = nullptr;
+  return nullptr;
+}
+
+// called before replacing p in the registry since waiting for the own pin would
+// never return, destructors cannot throw and only assert
+inline void checkNotPinnedByCallingThread(void const *p, bool destructing) {
+  PinRecord *own = ThreadRecords<PinRecord>::localIfCreated();
+  if (own == nullptr)
+    return; // the calling thread never pinned
+
+  for (auto const &s : own->pinned) {
+    if (s.load(std::memory_order_relaxed) != p)
+      continue;
+    if (!destructing)
+      throwImpl(DeregisteringPinnedInstance{});
+    assert(!"registration destructed while the destructing thread pins its "
+            "instance");
+  }
+}
+
+// expects p to be replaced in the registry already, returns once no other
+// thread has it pinned
+inline void waitForPins(void const *p) {
+
+  std::atomic_thread_fence(
+      std::memory_order_seq_cst); // orders the replacement before reading the
+                                  // pins
+
+  PinRecord const *own = ThreadRecords<
+      PinRecord>::localIfCreated(); // see checkNotPinnedByCallingThread()
+  for (PinRecord *r = ThreadRecords<PinRecord>::first(); r != nullptr;
+       r = r->next)
+    for (auto const &s : r->pinned)
+      while (r != own && s.load(std::memory_order_acquire) == p)
+        std::this_thread::yield();
+}
+
+} // namespace detail
+// returned by instance<T>().pin(), the instance is not deregistered before the
+// guard is destructed or unpinned, expects to be destructed on the pinning
+// thread
+template <typename T> class Pinned {
+
+public:
+  Pinned() : t(nullptr), slot(nullptr) {}
+
+  Pinned(Pinned &&o) noexcept : t(o.t), slot(o.slot) {
+    o.t = nullptr;
+    o.slot = nullptr;
+  }
+
+  Pinned &operator=(Pinned &&o) noexcept {
+    if (this == &o)
+      return *this;
+    unpin();
+    t = o.t;
+    slot = o.slot;
+    o.t = nullptr;
+    o.slot = nullptr;
+    return *this;
+  }
+
+  ~Pinned() { unpin(); }
+
+  explicit operator bool() const { return t != nullptr; }
+
+  T *get() const { return t; }
+
+  T &operator*() const { return *operator->(); }
+  T *operator->() const {
+    if (t == nullptr)
+      global::onNullPtrAccess<>();
+    return t;
+  }
+
+  void unpin() {
+    if (slot != nullptr)
+      slot->store(nullptr, std::memory_order_release);
+    slot = nullptr;
+    t = nullptr;
+  }
+
+private:
+
+  template <typename> friend class detail::InstanceSlot;
+
+  Pinned(T *t_, std::atomic<void *> *s) : t(t_), slot(s) {}
+
+  Pinned(Pinned const &) = delete;
+  Pinned &operator=(Pinned const &) = delete;
+
+  T *t;
+  std::atomic<void *> *slot; // nullptr if nothing needs to be pinned
+};
+
+// number of deferred calls per type which are queued without allocation,
+// more are an error if GLOBAL_NO_HEAP is defined
+// can be specialized to change the capacity for a single type
+template <typename T>
+struct DeferredCallCapacity
+    : std::integral_constant<std::size_t, GLOBAL_DEFERRED_CALL_CAPACITY> {};
+template <typename, typename> class SwappableInstance;
+namespace detail {
+
+// marks a registration without registered instance, nullptr is a valid replaced
+// instance
+struct Unregistered {
+  constexpr Unregistered() {}
+};
+
+inline void *unregistered() { return &constantStaticValue<Unregistered>(); }
+
+// an active registration; they form a stack per type, so a registration ending
+// while replaced by a later one hands the instance it replaced over to that one
+// instead of registering it again
+struct RegistrationLink {
+  RegistrationLink() : replaced(unregistered()), below(nullptr) {}
+
+  // changed when the registration below ends, but never to or from
+  // unregistered()
+  std::atomic<void *> replaced;
+  RegistrationLink *below;
+
+  bool active() const {
+    return replaced.load(std::memory_order_relaxed) != unregistered();
+  }
+
+  void push(RegistrationLink *&top, void *r) {
+    replaced.store(r, std::memory_order_relaxed);
+    below = top;
+    top = this;
+  }
+
+  // the registrations are rarely nested deeply, so the one above is searched
+  // from the top
+  void unlink(RegistrationLink *&top) {
+    RegistrationLink *above = nullptr;
+    for (RegistrationLink *l = top; l != this; l = l->below)
+      above = l;
+    if (above != nullptr) {
+      above->replaced.store(replaced.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+      above->below = below;
+    } else
+      top = below;
+    replaced.store(unregistered(), std::memory_order_relaxed);
+  }
+};
+
+// the slow paths of instance<T>(): registrations, deferred calls and pins,
+// kept apart from InstancePointer<T> so that accessing instances does not need
+// to parse them
+template <typename T> class InstanceSlot {
+
+public:
+  static Pinned<T> pin() {
+#ifdef GLOBAL_TEST_CONTEXTS
+    void *o = testContextOverride(typeId<T>());
+    if (o != nullptr)
+      return Pinned<T>(o != noInstanceOverride() ? static_cast<T *>(o)
+                                                 : nullptr,
+                       nullptr); // owned by the test
+#endif
+    return pin(ThreadLocalAccess<T>{});
+  }
+
+  template <typename Func> static void ifAvailable(Func func) {
+    T *t = availableOrQueue(func);
+    if (t != nullptr)
+      func(*t);
+  }
+
+  template <typename Func> static void becomesUnavailable(Func func) {
+    Deferred &d = deferred();
+    SpinLockGuard guard(d.lock);
+    d.becomesUnavailableOps.emplace_back(std::move(func)); // never directly
+    d.updateHighWatermark();
+  }
+
+  template <typename Executor, typename Func>
+  static void ifAvailable(Executor &executor, Func func) {
+    ExecuteIfAvailable<Executor, Func> op{&executor, std::move(func)};
+    T *t = availableOrQueue(op);
+    if (t != nullptr)
+      op(*t);
+  }
+
+  template <typename Executor, typename Func>
+  static void becomesUnavailable(Executor &executor, Func func) {
+    becomesUnavailable(
+        ExecuteUnavailable<Executor, Func>{&executor, std::move(func)});
+  }
+
+  static InlineExecutor &inlineExecutor() {
+    return constantStaticValue<InlineExecutor>();
+  }
+
+  // returns the instance if available, otherwise func is queued and nullptr
+  // returned
+  template <typename Func> static T *availableOrQueue(Func &func) {
+    T *t = pointer().get();
+    if (t != nullptr)
+      return t;
+
+    Deferred &d = deferred();
+    SpinLockGuard guard(d.lock);
+    t = pointer().get(); // might have been registered meanwhile
+    if (t == nullptr) {
+      d.ifAvailableOps.emplace_back(std::move(func));
+      d.updateHighWatermark();
+    }
+    return t;
+  }
+
+private:
+  static InstancePointer<T> &pointer() { return instance<T>(); }
+
+  static T *local(T *t) { return InstancePointer<T>::local(t); }
+
+  static Pinned<T> pin(std::false_type /*thread local*/) {
+    std::atomic<void *> *slot;
+    T *t = static_cast<T *>(pinRegistered(pointer().instancePtr, slot));
+    return Pinned<T>(local(t), slot);
+  }
+
+  // a thread local instance cannot be deregistered by other threads
+  static Pinned<T> pin(std::true_type /*thread local*/) {
+    T *t = ThreadLocalPointer<T>::value;
+    return t != nullptr ? Pinned<T>(t, nullptr) : pin(std::false_type{});
+  }
+
+  // registers t on top of the active registrations, link stores the replaced
+  // instance
+  static void beginRegistration(RegistrationLink &link, T *t) {
+    T *before = nullptr;
+    assign(t, before, false, false, &link);
+  }
+
+  // like beginRegistration() but only if no instance is registered
+  static bool beginRegistrationIfUnset(RegistrationLink &link, T *t) {
+    T *before = nullptr;
+    return assign(t, before, true, false, &link);
+  }
+
+  // puts back the instance replaced by link if it is the last active
+  // registration, otherwise the one above takes it over; destructing is set by
+  // the destructors of registrations, which cannot throw
+  static void endRegistration(RegistrationLink &link, bool destructing) {
+    T *before = nullptr;
+    assign(nullptr, before, false, destructing, nullptr, &link);
+  }
+
+  // replaces 'expected' without running deferred operations since the instance
+  // stays available
+  static bool exchangeIfEqual(T *expected, T *t) {
+    std::atomic<void *> &instancePtr = pointer().instancePtr;
+    {
+      SpinLockGuard guard(deferred().lock);
+      if (instancePtr.load(std::memory_order_relaxed) != expected)
+        return false;
+      checkNotPinnedByCallingThread(expected, false);
+      instancePtr.store(t, std::memory_order_release);
+      ++deferred().endedRegistrations; // expected is retired
+    }
+    waitForExecutedOperations(deferred());
+    waitForPins(expected);
+    return true;
+  }
+
+  static bool assign(T *t, T *&before, bool onlyIfUnset,
+                     bool destructing = false,
+                     RegistrationLink *registering = nullptr,
+                     RegistrationLink *ending = nullptr) {
+
+    std::atomic<void *> &instancePtr = pointer().instancePtr;
+    Deferred &d = deferred();
+    DeferredOperation available;
+    DeferredOperation unavailable;
+    bool reportFrozen;
+    {
+      FreezeCheck freezeCheck(destructing);
+      reportFrozen = freezeCheck.changeWhileFrozen();
+
+      SpinLockGuard guard(d.lock);
+      before = static_cast<T *>(instancePtr.load(std::memory_order_relaxed));
+      if (onlyIfUnset && before != nullptr)
+        return false;
+      if (ending != nullptr) {
+        ++d.endedRegistrations;
+        if (ending != d.topRegistration) { // replaced by a later registration,
+                                           // which now puts back the instance
+          ending->unlink(d.topRegistration);
+          return true;
+        }
+        t = static_cast<T *>(ending->replaced.load(std::memory_order_relaxed));
+      }
+      if (before != t && before != nullptr)
+        checkNotPinnedByCallingThread(before, destructing);
+      if (ending != nullptr)
+        ending->unlink(d.topRegistration);
+      if (registering != nullptr)
+        registering->push(d.topRegistration, before);
+      if (before == t)
+        return true; // nothing changed
+      instancePtr.store(t, std::memory_order_release);
+
+      if (t != nullptr)
+        available.swap(d.ifAvailableOps);
+      if (before != nullptr && t == nullptr)
+        unavailable.swap(d.becomesUnavailableOps);
+    }
+
+    if (reportFrozen)
+      onDeregistrationWhileFrozen<T>();
+    for (auto &op : available) {
+      TraceSpan<T> span("ifAvailable");
+      op(*local(t));
+    }
+    for (auto &op : unavailable) {
+      TraceSpan<T> span("becomesUnavailable");
+      op(*local(before));
+    }
+    if (before != nullptr)
+      waitForExecutedOperations(
+          d); // also when replaced, e.g. by restoring after a mock
+    if (before != nullptr)
+      waitForPins(before); // before might be destructed next
+    return true;
+  }
+
+  template <typename, typename> friend class BasicInstanceRegistration;
+
+  template <typename, typename> friend class ::global::SwappableInstance;
+
+  // queued calls up to this count and typical capture sizes do not allocate
+  static constexpr std::size_t inlineOperationCount =
+      DeferredCallCapacity<T>::value;
+  using DeferredOperation =
+      SmallVector<SmallFunction<void(T &)>, inlineOperationCount>;
+
+  struct HandedOverCall {
+    SmallFunction<void(T &)> func; // empty once the executor started it
+    T *t;
+  };
+
+  using HandedOverCalls = SmallVector<HandedOverCall, inlineOperationCount>;
+
+  // constructed by the first deferred call or registration, which installs the
+  // hooks through which the registry reaches it
+  struct Deferred {
+    Deferred() { instanceRegistry().installHooks(typeId<T>(), hooks()); }
+
+    DeferredOperation ifAvailableOps;
+    DeferredOperation becomesUnavailableOps;
+    SpinLock lock;
+    std::atomic<std::size_t> running{
+        0}; // ifAvailable calls being executed by an executor
+    std::atomic<std::size_t> runningUnavailable{
+        0}; // becomesUnavailable calls being executed by an executor
+    HandedOverCalls handedOver; // becomesUnavailable calls passed to an
+                                // executor but not started yet
+    std::size_t handedOverGeneration =
+        0; // incremented whenever handedOver is taken by the deregistration
+    std::size_t endedRegistrations =
+        0; // the instances of ended registrations might be destructed
+    RegistrationLink *topRegistration = nullptr; // the last active registration
+    std::size_t highWatermark = 0; // most calls queued in one of the lists
+
+    void updateHighWatermark() {
+      const std::size_t n = ifAvailableOps.size() > becomesUnavailableOps.size()
+                                ? ifAvailableOps.size()
+                                : becomesUnavailableOps.size();
+      if (n > highWatermark)
+        highWatermark = n;
+    }
+  };
+
+  static Deferred &deferred() { return staticValue<Deferred>(); }
+
+  static DeferredCallHooks const *hooks() {
+    static const DeferredCallHooks h{&deferredCallUsage, &capture, &restore};
+    return &h;
+  }
+
+  static DeferredCallUsage deferredCallUsage() {
+    Deferred &d = deferred();
+    SpinLockGuard guard(d.lock);
+    return DeferredCallUsage{d.highWatermark, inlineOperationCount};
+  }
+
+  struct ParkedCalls {
+    DeferredOperation ifAvailableOps;
+    DeferredOperation becomesUnavailableOps;
+  };
+
+  // moves the queued deferred calls out, so they are neither executed nor
+  // dropped until restored
+  static CapturedInstance capture() {
+    Deferred &d = deferred();
+    SpinLockGuard guard(d.lock);
+    CapturedInstance c{pointer().instancePtr.load(std::memory_order_relaxed),
+                       nullptr, d.endedRegistrations};
+    if (d.ifAvailableOps.empty() && d.becomesUnavailableOps.empty())
+      return c;
+
+    ParkedCalls *parked = new ParkedCalls;
+    parked->ifAvailableOps.swap(d.ifAvailableOps);
+    parked->becomesUnavailableOps.swap(d.becomesUnavailableOps);
+    c.parkedCalls = parked;
+    return c;
+  }
+
+  // sets the captured instance pointer without executing deferred calls, the
+  // calls queued meanwhile are replaced by the parked ones; if a registration
+  // ended since the capture the captured instance might be destructed, so
+  // unless it is still registered the pointer is kept
+  static void restore(CapturedInstance c) {
+    ParkedCalls *parked = static_cast<ParkedCalls *>(c.parkedCalls);
+    DeferredOperation dropped;
+    DeferredOperation droppedUnavailable;
+    {
+      Deferred &d = deferred();
+      SpinLockGuard guard(d.lock);
+      std::atomic<void *> &ptr = pointer().instancePtr;
+      if (c.endedRegistrations == d.endedRegistrations || c.instance == nullptr)
+        ptr.store(c.instance, std::memory_order_release);
+      dropped.swap(d.ifAvailableOps);
+      droppedUnavailable.swap(d.becomesUnavailableOps);
+      if (parked != nullptr) {
+        d.ifAvailableOps.swap(parked->ifAvailableOps);
+        d.becomesUnavailableOps.swap(parked->becomesUnavailableOps);
+      }
+    }
+    delete parked; // destructs the calls outside of the lock
+  }
+
+  // after deregistration or replacement no call passed to an executor may
+  // access the replaced instance anymore; the becomesUnavailable calls the
+  // executor has not started are called here, so an executor run later by the
+  // deregistering thread, e.g. a BatchingExecutor, does not make this wait
+  // forever
+  static void waitForExecutedOperations(Deferred &d) {
+    HandedOverCalls notStarted;
+    {
+      SpinLockGuard guard(d.lock);
+      notStarted.swap(d.handedOver);
+      ++d.handedOverGeneration; // the tickets of the taken calls do nothing
+                                // anymore
+    }
+    for (auto &c : notStarted)
+      if (c.func)
+        c.func(*c.t);
+
+    std::atomic_thread_fence(
+        std::memory_order_seq_cst); // pairs with the one in
+                                    // Executed::operator()
+    while (d.running.load(std::memory_order_acquire) != 0 ||
+           d.runningUnavailable.load(std::memory_order_acquire) != 0)
+      std::this_thread::yield();
+  }
+
+  struct Running {
+    explicit Running(std::atomic<std::size_t> &c) : count(c) {}
+    ~Running() { count.fetch_sub(1, std::memory_order_release); }
+    std::atomic<std::size_t> &count;
+  };
+
+  // the ifAvailable call handed to an executor, runs only if an instance is
+  // still registered
+  template <typename Func> struct Executed {
+    Func func;
+
+    void operator()() {
+      deferred().running.fetch_add(1, std::memory_order_relaxed);
+      Running running(deferred().running);
+      std::atomic_thread_fence(
+          std::memory_order_seq_cst); // pairs with the one in
+                                      // waitForExecutedOperations()
+      T *registered = static_cast<T *>(
+          pointer().instancePtr.load(std::memory_order_acquire));
+      if (registered != nullptr)
+        func(*local(registered));
+    }
+  };
+
+  // handed to an executor instead of a becomesUnavailable call, which is kept
+  // in Deferred::handedOver so the deregistration can call it itself if the
+  // executor has not started it yet
+  struct UnavailableTicket {
+    std::size_t generation;
+    std::size_t index;
+
+    void operator()() const {
+      Deferred &d = deferred();
+      SmallFunction<void(T &)> func;
+      T *t;
+      {
+        SpinLockGuard guard(d.lock);
+        if (generation != d.handedOverGeneration)
+          return; // called by the deregistration
+        HandedOverCall &c = *(d.handedOver.begin() + index);
+        func = std::move(c.func);
+        t = c.t;
+        d.runningUnavailable.fetch_add(
+            1, std::memory_order_relaxed); // the deregistration waits for it
+                                           // from here
+      }
+      Running running(d.runningUnavailable);
+      func(*t);
+    }
+  };
+
+  template <typename Executor, typename Func> struct ExecuteIfAvailable {
+    Executor *executor;
+    Func func;
+    void operator()(T &) {
+      executor->execute(Executed<Func>{std::move(func)});
+    }
+  };
+
+  template <typename Executor, typename Func> struct ExecuteUnavailable {
+    Executor *executor;
+    Func func;
+    void operator()(T &t) {
+      Deferred &d = deferred();
+      UnavailableTicket ticket;
+      {
+        SpinLockGuard guard(d.lock);
+        ticket = UnavailableTicket{d.handedOverGeneration, d.handedOver.size()};
+        d.handedOver.emplace_back(HandedOverCall{std::move(func), &t});
+      }
+      executor->execute(ticket);
+    }
+  };
+};
+
+} // namespace detail
+// writes one line "<high watermark> <capacity> <type name>" per type with
+// queued deferred calls, the capacities can be sized by it before defining
+// GLOBAL_NO_HEAP
+template <typename Stream> void writeDeferredCallHighWatermarks(Stream &out) {
+  forEachInstanceType([&out](InstanceType const &t) {
+    DeferredCallUsage u = t.deferredCalls();
+    if (u.highWatermark == 0)
+      return;
+    TypeName n = t.name();
+    out << u.highWatermark << ' ' << u.capacity << ' ';
+    out.write(n.data, static_cast<std::ptrdiff_t>(n.size)) << '\n';
+  });
+}
+
+namespace detail {
+
+class bad_optional_access_impl : public std::exception {};
+
+using bad_optional_access =
+    bad_optional_access_impl; // use c++17 version if available
+
+template <typename T> class OptionalValueImpl {
+
+public:
+  explicit OptionalValueImpl() {}
+
+  OptionalValueImpl &operator=(T const &t) {
+    val = t;
+    m_hasValue = true;
+    return *this;
+  }
+
+  explicit operator T() const {
+    if (!m_hasValue)
+      throwImpl(bad_optional_access{});
+    return val;
+  }
+
+  bool has_value() const { return m_hasValue; }
+  void reset() { m_hasValue = false; }
+
+private:
+  T val;
+  bool m_hasValue = false;
+};
+
+template <typename T>
+using optional = OptionalValueImpl<T>; // use c++17 version if available
+
+} // namespace detail
+
+// collects the calls until run() is called, e.g. by an event loop
+class BatchingExecutor {
+
+public:
+  BatchingExecutor() {}
+
+  template <typename F> void execute(F &&f) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.emplace_back(bindTestContext(std::forward<F>(f)));
+  }
+
+  // calls the collected calls on the calling thread, returns their number
+  std::size_t run() {
+    std::vector<Task> batch;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      batch.swap(tasks);
+    }
+    for (auto &t : batch)
+      t();
+    return batch.size();
+  }
+
+  std::size_t pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tasks.size();
+  }
+
+private:
+  BatchingExecutor(BatchingExecutor const &) = delete;
+  BatchingExecutor &operator=(BatchingExecutor const &) = delete;
+
+  using Task = detail::SmallFunction<void()>;
+
+  std::mutex mutex;
+  std::vector<Task> tasks;
+};
+
+#ifndef GLOBAL_NO_HEAP
+// captures the instance pointers of all types accessed by instance<T>()
+// together with their queued deferred calls and restores them on destruction,
+// e.g. to reset a test fixture without constructing or destructing instances;
+// thread local, keyed and lazy instances are not captured
+class RegistrySnapshot {
+
+public:
+  // the queued deferred calls are parked in the snapshot, so the following code
+  // starts without any
+  RegistrySnapshot() {
+    forEachInstanceType(
+        [this](InstanceType const &t) { captured.push_back(t.capture()); });
+  }
+
+  ~RegistrySnapshot() { restore(); }
+
+  // sets all instance pointers back without executing deferred calls, drops the
+  // calls queued since the capture and queues the parked ones again; types
+  // added since then are left untouched, as are the pointers of types with a
+  // registration ended since then, since the captured instance might be
+  // destructed; expects no executor to run deferred calls meanwhile and the
+  // registrations not to be frozen
+  void restore() {
+    if (restored)
+      return;
+    restored = true;
+
+    detail::InstanceRegistry const &types = detail::instanceRegistry();
+    for (std::size_t i = 0; i < captured.size(); ++i)
+      types[i].restore(captured[i]);
+  }
+
+  std::size_t size() const { return captured.size(); }
+
+private:
+  RegistrySnapshot(RegistrySnapshot const &) = delete;
+  RegistrySnapshot &operator=(RegistrySnapshot const &) = delete;
+
+  std::vector<CapturedInstance> captured; // indexed by the type id
+  bool restored = false;
+};
+#endif // GLOBAL_NO_HEAP
+
+struct AccessCount {
+  TypeName name;
+  std::size_t id;
+  std::uint64_t accesses;
+  std::uint64_t nullAccesses;
+};
+namespace detail {
+
+#ifdef GLOBAL_COUNT_ACCESSES
+
+inline AccessCount accessCount(InstanceType const &t) {
+  AccessCount c{t.name(), t.id(), 0, 0};
+  for (AccessCounterShard *s = ThreadRecords<AccessCounterShard>::first();
+       s != nullptr; s = s->next) {
+    std::atomic<std::uint64_t> const *accesses = s->accesses.find(c.id);
+    std::atomic<std::uint64_t> const *nullAccesses = s->nullAccesses.find(c.id);
+    if (accesses != nullptr)
+      c.accesses += accesses->load(std::memory_order_relaxed);
+    if (nullAccesses != nullptr)
+      c.nullAccesses += nullAccesses->load(std::memory_order_relaxed);
+  }
+  return c;
+}
+
+#endif // GLOBAL_COUNT_ACCESSES
+
+} // namespace detail
+// totals over all threads of each type accessed by instance<T>(), most accessed
+// first, empty if GLOBAL_COUNT_ACCESSES is not defined
+inline std::vector<AccessCount> accessCounts() {
+  std::vector<AccessCount> counts;
+#ifdef GLOBAL_COUNT_ACCESSES
+  forEachInstanceType([&counts](InstanceType const &t) {
+    counts.push_back(detail::accessCount(t));
+  });
+  std::stable_sort(counts.begin(), counts.end(),
+                   [](AccessCount const &a, AccessCount const &b) {
+                     return a.accesses > b.accesses;
+                   });
+#endif
+  return counts;
+}
+// writes one line "<accesses> <null accesses> <type name>" per type, most
+// accessed first
+template <typename Stream> void writeAccessCounts(Stream &out) {
+  for (auto const &c : accessCounts())
+    out << c.accesses << ' ' << c.nullAccesses << ' ' << c.name.str() << '\n';
+}
+
+class InstanceReplacementNotAllowed : public std::exception {};
+class RegisteringNullNotAllowed : public std::exception {};
+namespace detail {
+
+// the registered instance is replaced for the lifetime of the registration
+struct ReplaceExisting {};
+
+// expects nullptr to be registered beforehand
+// expects registration-target not to be null
+struct RejectExisting {};
+
+// selects the behaviour by Policy at compile time, so it needs no vtable
+// and stores only its link in the stack of active registrations
+template <typename T, typename Policy> class BasicInstanceRegistration {
+
+public:
+  BasicInstanceRegistration() {}
+  BasicInstanceRegistration(T *t) { registerInstance(t); }
+  void operator()(T *t) { registerInstance(t); }
+  ~BasicInstanceRegistration() { deregisterInstance(true); }
+
+  void registerInstance(T *t) { registerInstance(t, Policy{}); }
+
+  // like registerInstance() but returns false instead of throwing if another
+  // instance is registered
+  bool tryRegisterInstance(T *t) { return tryRegisterInstance(t, Policy{}); }
+
+  // destructing reports deregistering while frozen by
+  // onDeregistrationWhileFrozen() instead of throwing
+  void deregisterInstance(bool destructing = false) {
+    if (!link.active())
+      return; // noting to do
+    TraceSpan<T> span("deregister");
+    InstanceSlot<T>::endRegistration(link,
+                                     destructing); // possibly registers again
+  }
+
+private:
+  void registerInstance(T *t, ReplaceExisting) {
+    deregisterInstance();
+    TraceSpan<T> span("register");
+    InstanceSlot<T>::beginRegistration(link, t); // possibly deregisters again
+  }
+
+  // registers t only if no other instance is registered, in one step
+  void registerInstance(T *t, RejectExisting) {
+    if (!tryRegisterInstance(t, RejectExisting{}))
+      throwImpl(InstanceReplacementNotAllowed{});
+  }
+
+  bool tryRegisterInstance(T *t, RejectExisting) {
+    TraceSpan<T> span("register");
+    if (t == nullptr)
+      throwImpl(RegisteringNullNotAllowed{});
+    if (link.active())
+      throwImpl(InstanceReplacementNotAllowed{});
+    return InstanceSlot<T>::beginRegistrationIfUnset(link, t);
+  }
+
+  BasicInstanceRegistration(BasicInstanceRegistration const &) =
+      delete; // no copy
+
+  RegistrationLink link;
+};
+
+template <typename T>
+using ReplacingInstanceRegistration =
+    BasicInstanceRegistration<T, ReplaceExisting>;
+
+template <typename T>
+using InstanceRegistration = BasicInstanceRegistration<T, RejectExisting>;
+
+// replaces existing for the registering thread only, expects
+// to be destructed on the same thread
+template <typename T> class ThreadLocalInstanceRegistration {
+
+  static_assert(ThreadLocalAccess<T>::value,
+                "thread local instances need to be allowed by specializing "
+                "global::ThreadLocalAccess<T>");
+
+public:
+  ThreadLocalInstanceRegistration() {}
+  ThreadLocalInstanceRegistration(T *t) { registerInstance(t); }
+  void operator()(T *t) { registerInstance(t); }
+  ~ThreadLocalInstanceRegistration() { deregisterInstance(); }
+
+  void registerInstance(T *t) {
+    deregisterInstance();
+    replacedInstance = ThreadLocalPointer<T>::value;
+    ThreadLocalPointer<T>::value = t;
+  }
+
+  void deregisterInstance() {
+    if (replacedInstance == unregistered())
+      return; // noting to do
+    ThreadLocalPointer<T>::value = static_cast<T *>(replacedInstance);
+    replacedInstance = unregistered();
+  }
+
+private:
+  ThreadLocalInstanceRegistration(ThreadLocalInstanceRegistration const &) =
+      delete; // no copy
+
+  void *replacedInstance = unregistered();
+};
+
+#ifdef GLOBAL_TEST_CONTEXTS
+
+// replaces existing only within the test context bound to the registering
+// thread, replaces existing for all threads if none is bound, expects to be
+// destructed on the same thread as the context; deferred calls are not
+// triggered by overrides
+template <typename T> class TestContextRegistration {
+
+public:
+  TestContextRegistration() {}
+  TestContextRegistration(T *t) { registerInstance(t); }
+  void operator()(T *t) { registerInstance(t); }
+  ~TestContextRegistration() { deregisterInstance(true); }
+
+  void registerInstance(T *t) {
+    deregisterInstance();
+    context = TestContext::current();
+    if (context == nullptr) {
+      processWide.registerInstance(t);
+      return;
+    }
+    TraceSpan<T> span("register");
+    replacedOverride =
+        context->exchange(typeId<T>(), t != nullptr ? static_cast<void *>(t)
+                                                    : noInstanceOverride());
+  }
+
+  void deregisterInstance(bool destructing = false) {
+    if (context == nullptr) {
+      processWide.deregisterInstance(destructing);
+      return;
+    }
+    TraceSpan<T> span("deregister");
+    context->exchange(typeId<T>(), replacedOverride);
+    context = nullptr;
+  }
+
+private:
+  TestContextRegistration(TestContextRegistration const &) = delete; // no copy
+
+  TestContext *context = nullptr;
+  void *replacedOverride = nullptr;
+  ReplacingInstanceRegistration<T> processWide;
+};
+
+#endif // GLOBAL_TEST_CONTEXTS
+
+template <template <typename> class RegistrationType, typename AccessType,
+          typename InstanceType>
+class RegisterdInstanceT : InstanceTrace<AccessType> {
+
+  static_assert(
+      !PerCpuAccess<AccessType>::value,
+      "per cpu instances have to be registered by global::PerCpuInstance<T>");
+
+  InstanceType t;
+  RegistrationType<AccessType> reg;
+
+public:
+  template <typename... Args>
+  RegisterdInstanceT(Args &&...args)
+      : t(std::forward<Args>(args)...), reg(this->constructed(&t)) {}
+
+  ~RegisterdInstanceT() { this->destructing(); }
+};
+
+} // namespace detail
+template <typename AccessType, typename InstanceType = AccessType>
+using Instance = detail::RegisterdInstanceT<detail::InstanceRegistration,
+                                            AccessType, InstanceType>;
+#ifdef GLOBAL_TEST_CONTEXTS
+template <typename AccessType, typename InstanceType = AccessType>
+using TestInstance = detail::RegisterdInstanceT<detail::TestContextRegistration,
+                                                AccessType, InstanceType>;
+#else
+template <typename AccessType, typename InstanceType = AccessType>
+using TestInstance =
+    detail::RegisterdInstanceT<detail::ReplacingInstanceRegistration,
+                               AccessType, InstanceType>;
+#endif
+template <typename AccessType, typename InstanceType = AccessType>
+using ThreadLocalInstance =
+    detail::RegisterdInstanceT<detail::ThreadLocalInstanceRegistration,
+                               AccessType, InstanceType>;
+#define GLOBAL_INSTANCE_IS_FRIEND                                              \
+  template <template <typename> class, typename, typename>                     \
+  friend class ::global::detail::RegisterdInstanceT
+
+namespace detail {
+
+// std::index_sequence is not available in c++11
+template <std::size_t...> struct IndexSequence {};
+
+template <std::size_t N, std::size_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+
+template <std::size_t... I> struct MakeIndexSequence<0, I...> {
+  using type = IndexSequence<I...>;
+};
+
+// shared by the deferred calls of all instances waited for, counts the missing
+// ones
+template <typename Func, typename... Ts>
+class WhenAll : public std::enable_shared_from_this<WhenAll<Func, Ts...>> {
+
+  using Indices = typename MakeIndexSequence<sizeof...(Ts)>::type;
+
+  template <std::size_t I>
+  using Type = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+public:
+  explicit WhenAll(Func f) : func(std::move(f)) {}
+
+  void start() {
+    if (missing == 0) {
+      done = true;
+      call(Indices{});
+      return;
+    }
+    armAll(Indices{});
+  }
+
+private:
+  template <std::size_t... I> void armAll(IndexSequence<I...>) {
+    int expand[] = {0, (arm<I>(), 0)...};
+    (void)expand;
+  }
+
+  template <std::size_t I> void arm() {
+    auto self = this->shared_from_this();
+    instance<Type<I>>().ifAvailable(
+        [self](Type<I> &t) { self->template available<I>(t); });
+  }
+
+  // nothing is queued for deregistrations, instead the instances which arrived
+  // earlier are checked to be still registered once the last one arrives, and
+  // waited for again if not
+  template <std::size_t I> void available(Type<I> &) {
+    bool rearm[sizeof...(Ts)] = {};
+    {
+      SpinLockGuard guard(lock);
+      if (done || --missing != 0)
+        return;
+      collectAll(rearm, Indices{});
+      done = missing == 0;
+    }
+
+    if (done) {
+      call(Indices{});
+      return;
+    }
+    rearmAll(rearm, Indices{});
+  }
+
+  template <std::size_t... I>
+  void collectAll(bool *rearm, IndexSequence<I...>) {
+    int expand[] = {0, (collect<I>(rearm[I]), 0)...};
+    (void)expand;
+  }
+
+  // takes the instance seen by the calling thread, including thread local and
+  // test context overrides, which is also the one ifAvailable() calls with, so
+  // an instance found by it is never waited for again
+  template <std::size_t I> void collect(bool &rearm) {
+    Type<I> *t = instance<Type<I>>().get();
+    std::get<I>(instances) = t;
+    rearm = t == nullptr;
+    if (rearm)
+      ++missing;
+  }
+
+  template <std::size_t... I>
+  void rearmAll(bool const *rearm, IndexSequence<I...>) {
+    int expand[] = {0, (rearm[I] ? arm<I>() : void(), 0)...};
+    (void)expand;
+  }
+
+  template <std::size_t... I> void call(IndexSequence<I...>) {
+    func(*std::get<I>(instances)...);
+  }
+
+  Func func;
+  std::tuple<Ts *...> instances;
+  std::size_t missing = sizeof...(Ts);
+  bool done = false;
+  SpinLock lock;
+};
+
+} // namespace detail
+// calls func(A&, B&, ...) once when the last of the instances is registered,
+// waits again for an instance which is deregistered before that
+template <typename... Ts, typename Func> void whenAllAvailable(Func func) {
+#ifdef GLOBAL_NO_HEAP
+  static_assert(sizeof(Func) == 0,
+                "GLOBAL_NO_HEAP: whenAllAvailable allocates its shared state");
+#endif
+  std::make_shared<detail::WhenAll<Func, Ts...>>(std::move(func))->start();
+}
+
+class SwapOfReplacedInstanceNotAllowed : public std::exception {};
+namespace detail {
+
+// initial value 1 since 0 marks threads not within a read section
+template <typename = void> struct EpochStorage {
+  static std::atomic<std::uint64_t> value;
+};
+
+template <typename T> std::atomic<std::uint64_t> EpochStorage<T>::value{1};
+
+class Epoch {
+
+public:
+  // smallest epoch of all threads within a read section
+  static std::uint64_t oldestReader() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::uint64_t oldest = UINT64_MAX;
+    for (ThreadRecord *r = ThreadRecords<>::first(); r != nullptr;
+         r = r->next) {
+      const std::uint64_t e = r->epoch.load(std::memory_order_acquire);
+      if (e != 0 && e < oldest)
+        oldest = e;
+    }
+    return oldest;
+  }
+
+  // returns the epoch whose readers cannot see anything published before
+  static std::uint64_t advance() {
+    return EpochStorage<>::value.fetch_add(1) + 1;
+  }
+
+  static void waitForReaders(std::uint64_t e) {
+    while (oldestReader() < e)
+      std::this_thread::yield();
+  }
+};
+
+} // namespace detail
+// instances of SwappableInstance which are accessed within the scope of
+// a ReadSection are not destructed until the scope is left
+class ReadSection {
+
+public:
+  ReadSection() : record(detail::ThreadRecords<>::local()) {
+    if (depth()++ != 0)
+      return;
+    record.epoch.store(
+        detail::EpochStorage<>::value.load(std::memory_order_acquire),
+        std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  ~ReadSection() {
+    if (--depth() != 0)
+      return;
+    record.epoch.store(0, std::memory_order_release);
+  }
+
+private:
+  static unsigned &depth() {
+    static thread_local unsigned d = 0;
+    return d;
+  }
+
+  ReadSection(ReadSection const &) = delete;
+  ReadSection &operator=(ReadSection const &) = delete;
+
+  detail::ThreadRecord &record;
+};
+// registers an instance of InstanceType which can be replaced by a new version
+// while being accessed; old versions are destructed once no ReadSection can
+// access them anymore
+template <typename AccessType, typename InstanceType = AccessType>
+class SwappableInstance {
+
+public:
+  template <typename... Args>
+  SwappableInstance(Args &&...args)
+      : current(new InstanceType(std::forward<Args>(args)...)),
+        reg(current.get()) {}
+
+  ~SwappableInstance() {
+    reg.deregisterInstance(true);
+    retired.emplace_back(detail::Epoch::advance(), std::move(current));
+    synchronize();
+  }
+
+  // publishes 'next' without triggering deferred calls
+  void replace(std::unique_ptr<InstanceType> next) {
+    if (next == nullptr)
+      detail::throwImpl(RegisteringNullNotAllowed{});
+
+    AccessType *expected = current.get();
+    if (detail::InstanceSlot<AccessType>::exchangeIfEqual(expected,
+                                                          next.get()) == false)
+      detail::throwImpl(SwapOfReplacedInstanceNotAllowed{});
+
+    retired.emplace_back(detail::Epoch::advance(), std::move(current));
+    current = std::move(next);
+    reclaim();
+  }
+
+  template <typename... Args> void emplace(Args &&...args) {
+    replace(std::unique_ptr<InstanceType>(
+        new InstanceType(std::forward<Args>(args)...)));
+  }
+
+  // destructs the old versions which cannot be accessed anymore, without
+  // waiting
+  void reclaim() {
+    const std::uint64_t oldest = detail::Epoch::oldestReader();
+    retired.erase(std::remove_if(
+                      retired.begin(), retired.end(),
+                      [oldest](Retired const &r) { return r.first <= oldest; }),
+                  retired.end());
+  }
+
+  // waits until all old versions can be destructed and destructs them
+  void synchronize() {
+    if (retired.empty())
+      return;
+    detail::Epoch::waitForReaders(retired.back().first);
+    retired.clear();
+  }
+
+  std::size_t retiredCount() const { return retired.size(); }
+
+private:
+  SwappableInstance(SwappableInstance const &) = delete;
+
+  using Retired = std::pair<std::uint64_t, std::unique_ptr<InstanceType>>;
+
+  std::unique_ptr<InstanceType> current;
+  detail::InstanceRegistration<AccessType> reg;
+  std::vector<Retired> retired;
+};
+
+class LazyInstanceAlreadyDeclared : public std::exception {};
+namespace detail {
+
+template <typename InstanceType, typename... Args> struct LazyConstruction {
+
+  std::tuple<Args...> args;
+
+  void operator()(void *at) {
+    construct(at, typename MakeIndexSequence<sizeof...(Args)>::type{});
+  }
+
+  template <std::size_t... I> void construct(void *at, IndexSequence<I...>) {
+    new (at) InstanceType(argument(std::get<I>(args))...);
+  }
+
+  // copies are passed so the arguments are still there if construction throws
+  // and is retried, arguments which cannot be copied are moved
+  template <typename A>
+  static typename std::enable_if<std::is_copy_constructible<A>::value, A>::type
+  argument(A &a) {
+    return a;
+  }
+
+  template <typename A>
+  static
+      typename std::enable_if<!std::is_copy_constructible<A>::value, A &&>::type
+      argument(A &a) {
+    return std::move(a);
+  }
+};
+
+} // namespace detail
+// constructs an instance of InstanceType on the first access by
+// instance<AccessType>() and registers it, the accesses after that are not
+// affected; the constructor arguments are copied on declaration and kept until
+// a construction succeeds; needs LazyAccess<AccessType> to be specialized
+template <typename AccessType, typename InstanceType = AccessType>
+class LazyInstance {
+
+  static_assert(LazyAccess<AccessType>::value,
+                "lazy instances need to be allowed by specializing "
+                "global::LazyAccess<T>");
+
+public:
+  template <typename... Args>
+  explicit LazyInstance(Args &&...args)
+      : construction(
+            detail::LazyConstruction<InstanceType,
+                                     typename std::decay<Args>::type...>{
+                std::tuple<typename std::decay<Args>::type...>(
+                    std::forward<Args>(args)...)}) {
+
+    auto &l = Pointer::lazySlot();
+    detail::SpinLockGuard guard(l.lock);
+    if (l.constructor.construct != nullptr)
+      detail::throwImpl(LazyInstanceAlreadyDeclared{});
+    l.constructor.construct = &constructFor;
+    l.constructor.owner = this;
+  }
+
+  ~LazyInstance() {
+    {
+      auto &l = Pointer::lazySlot();
+      detail::SpinLockGuard guard(l.lock);
+      l.constructor.construct = nullptr;
+      l.constructor.owner = nullptr;
+    }
+    while (Pointer::lazySlot().constructing.load(std::memory_order_acquire) !=
+           0)
+      std::this_thread::yield(); // accesses which already found this
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!built.load(std::memory_order_relaxed))
+      return;
+    reg.deregisterInstance(true);
+    object()->~InstanceType();
+  }
+
+  bool constructed() const { return built.load(std::memory_order_acquire); }
+
+private:
+  using Pointer = detail::InstancePointer<AccessType>;
+
+  InstanceType *object() { return reinterpret_cast<InstanceType *>(&storage); }
+
+  // called by each thread that finds no instance, the first one constructs it
+  static AccessType *constructFor(void *owner) {
+
+    LazyInstance &self = *static_cast<LazyInstance *>(owner);
+    std::lock_guard<std::mutex> lock(self.mutex);
+
+    if (self.built.load(std::memory_order_relaxed))
+      return self.object();
+
+    AccessType *registered = instance<AccessType>().get();
+    if (registered != nullptr)
+      return registered; // registered by someone else meanwhile
+
+    self.construction(&self.storage);
+    if (!self.reg.tryRegisterInstance(
+            self.object())) { // lost the race against another registration
+      self.object()->~InstanceType();
+      return instance<AccessType>().get();
+    }
+    self.construction.reset(); // the arguments are not needed anymore
+    self.built.store(true, std::memory_order_release);
+    return self.object();
+  }
+
+  LazyInstance(LazyInstance const &) = delete;
+  LazyInstance &operator=(LazyInstance const &) = delete;
+
+  detail::SmallFunction<void(void *)> construction;
+  std::mutex mutex;
+  std::atomic<bool> built{false};
+  typename std::aligned_storage<sizeof(InstanceType),
+                                std::alignment_of<InstanceType>::value>::type
+      storage;
+  detail::InstanceRegistration<AccessType> reg;
+};
+
+// key of a KeyedInstance, an integer or a string which is only referenced, the
+// hash is computed once
+class InstanceKey {
+
+public:
+  template <typename Integer, typename = typename std::enable_if<
+                                  std::is_integral<Integer>::value>::type>
+  InstanceKey(Integer i)
+      : integer(static_cast<std::uint64_t>(i)), data(nullptr), size(0),
+        hashValue(mix(integer)) {}
+
+  InstanceKey(char const *s) : InstanceKey(s, std::strlen(s)) {}
+  InstanceKey(std::string const &s) : InstanceKey(s.data(), s.size()) {}
+  InstanceKey(char const *s, std::size_t n)
+      : integer(0), data(s), size(n), hashValue(fnv1a(s, n)) {}
+
+  std::uint64_t hash() const { return hashValue; }
+  bool isString() const { return data != nullptr; }
+  std::string str() const {
+    return isString() ? std::string(data, size) : std::to_string(integer);
+  }
+
+  std::uint64_t integerValue() const { return integer; }
+  char const *chars() const { return data; }
+  std::size_t length() const { return size; }
+
+  // an integer never equals a string
+  bool operator==(InstanceKey const &o) const {
+    if (hashValue != o.hashValue || isString() != o.isString())
+      return false;
+    return isString() ? size == o.size && std::memcmp(data, o.data, size) == 0
+                      : integer == o.integer;
+  }
+
+private:
+  static std::uint64_t mix(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  static std::uint64_t fnv1a(char const *s, std::size_t n) {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (std::size_t i = 0; i < n; ++i)
+      h = (h ^ static_cast<unsigned char>(s[i])) * 0x100000001b3ULL;
+    return h;
+  }
+
+  std::uint64_t integer;
+  char const *data;
+  std::size_t size;
+  std::uint64_t hashValue;
+};
+namespace detail {
+
+template <typename T> class KeyedSlots;
+template <typename T> KeyedSlots<T> &keyedSlots();
+
+// the instance registered for one key together with its deferred calls, never
+// freed
+template <typename T> class KeyedSlot {
+
+public:
+  explicit KeyedSlot(InstanceKey const &k)
+      : keyCopy(k.isString() ? k.str() : std::string()),
+        slotKey(k.isString() ? InstanceKey(keyCopy) : k) {}
+
+  T *get() const { return instancePtr.load(std::memory_order_acquire); }
+  InstanceKey const &key() const { return slotKey; }
+
+  template <typename Func> void ifAvailable(Func func) {
+    T *t = get();
+    if (t == nullptr) {
+      SpinLockGuard guard(lock);
+      t = get(); // might have been registered meanwhile
+      if (t == nullptr)
+        ifAvailableOps.emplace_back(std::move(func));
+    }
+    if (t != nullptr)
+      func(*t);
+  }
+
+  template <typename Func> void becomesUnavailable(Func func) {
+    SpinLockGuard guard(lock);
+    becomesUnavailableOps.emplace_back(std::move(func)); // never directly
+  }
+
+  // expects no instance to be registered for the key and t not to be null
+  void registerInstance(T *t) {
+    TraceSpan<T> span("register");
+    if (t == nullptr)
+      throwImpl(RegisteringNullNotAllowed{});
+
+    DeferredOperation available;
+    {
+      FreezeCheck freezeCheck(false);
+      SpinLockGuard guard(lock);
+      if (instancePtr.load(std::memory_order_relaxed) != nullptr)
+        throwImpl(InstanceReplacementNotAllowed{});
+      instancePtr.store(t, std::memory_order_release);
+      available.swap(ifAvailableOps);
+    }
+    keyedSlots<T>().publish(
+        *this); // before the calls, so they can look the key up
+    for (auto &op : available)
+      op(*t);
+  }
+
+  // only called on destruction, so deregistering while frozen is reported
+  // instead of thrown
+  void deregisterInstance() {
+    TraceSpan<T> span("deregister");
+
+    T *before;
+    DeferredOperation unavailable;
+    bool reportFrozen;
+    {
+      FreezeCheck freezeCheck(true);
+      reportFrozen = freezeCheck.changeWhileFrozen();
+      SpinLockGuard guard(lock);
+      before = instancePtr.exchange(nullptr, std::memory_order_release);
+      unavailable.swap(becomesUnavailableOps);
+    }
+    keyedSlots<T>().publish(*this);
+    if (reportFrozen)
+      onDeregistrationWhileFrozen<T>();
+    for (auto &op : unavailable)
+      op(*before);
+  }
+
+private:
+  KeyedSlot(KeyedSlot const &) = delete;
+  KeyedSlot &operator=(KeyedSlot const &) = delete;
+
+  using DeferredOperation =
+      SmallVector<SmallFunction<void(T &)>, DeferredCallCapacity<T>::value>;
+
+  std::atomic<T *> instancePtr{nullptr};
+  std::string keyCopy; // owns the characters of a string key
+  InstanceKey slotKey;
+  DeferredOperation ifAvailableOps;
+  DeferredOperation becomesUnavailableOps;
+  SpinLock lock;
+};
+
+// one entry of the index, holds the key and a copy of the instance pointer so
+// a lookup of an integer key or a string key of up to inlineKeyCapacity
+// characters reads only this cache line
+template <typename T> struct alignas(64) KeyedCell {
+
+  static constexpr std::size_t inlineKeyCapacity = 24;
+
+  bool holds(InstanceKey const &k) const {
+    if (hash != k.hash() || isString != k.isString())
+      return false;
+    if (!isString)
+      return integer == k.integerValue();
+    if (size != k.length())
+      return false;
+    if (size <= inlineKeyCapacity)
+      return std::memcmp(chars, k.chars(), size) == 0;
+    return slot.load(std::memory_order_relaxed)->key() ==
+           k; // longer keys are compared on the slot
+  }
+
+  std::atomic<KeyedSlot<T> *> slot{
+      nullptr}; // published after the key, which is not changed afterwards
+  std::atomic<T *> instance{
+      nullptr}; // the instance of the slot, updated by KeyedSlots::publish
+  std::uint64_t hash = 0;
+  std::uint64_t integer = 0;
+  std::uint32_t size = 0;
+  bool isString = false;
+  char chars[inlineKeyCapacity];
+};
+
+// flat open-addressing index from the keys to the cells of T, filled at most
+// half so a lookup mostly reads a single cell, replaced by a twice as large
+// copy on growth
+template <typename T> class KeyedSlots {
+
+public:
+  using Cell = KeyedCell<T>;
+
+  constexpr KeyedSlots() : current(nullptr), count(0) {}
+
+  // lock-free and allocation-free
+  Cell const *find(InstanceKey const &key) const {
+    Index const *index = current.load(std::memory_order_acquire);
+    if (index == nullptr)
+      return nullptr;
+
+    for (std::size_t i = key.hash() & index->mask;; i = (i + 1) & index->mask) {
+      Cell const &c = index->cells[i];
+      if (c.slot.load(std::memory_order_acquire) == nullptr)
+        return nullptr;
+      if (c.holds(key))
+        return &c;
+    }
+  }
+
+  Cell const &findOrCreate(InstanceKey const &key) {
+
+    Cell const *c = find(key);
+    if (c != nullptr)
+      return *c;
+
+    SpinLockGuard guard(lock);
+    c = find(key); // might have been created meanwhile
+    if (c != nullptr)
+      return *c;
+
+    KeyedSlot<T> *s = new KeyedSlot<T>(key);
+    Index *index = current.load(std::memory_order_relaxed);
+    if (index == nullptr || 2 * (count + 1) > index->mask + 1)
+      index = grow(index);
+    ++count;
+    return insert(*index, s);
+  }
+
+  // copies the instance pointer of s to its cells, also to the ones of
+  // replaced indices since handles might still point to them
+  void publish(KeyedSlot<T> &s) {
+    SpinLockGuard guard(lock);
+    for (Index *index = current.load(std::memory_order_relaxed);
+         index != nullptr; index = index->replaced) {
+      Cell *c = cellOf(*index, &s);
+      if (c == nullptr)
+        break; // s was created after this index was replaced
+      c->instance.store(s.get(), std::memory_order_release);
+    }
+  }
+
+private:
+  // replaced indices are kept since lookups and handles might still read them
+  struct Index {
+    std::size_t mask;
+    Cell *cells;
+    Index *replaced;
+  };
+
+  static Cell &insert(Index &index, KeyedSlot<T> *s) {
+    InstanceKey const &key = s->key();
+    std::size_t i = key.hash() & index.mask;
+    while (index.cells[i].slot.load(std::memory_order_relaxed) != nullptr)
+      i = (i + 1) & index.mask;
+
+    Cell &c = index.cells[i];
+    c.hash = key.hash();
+    c.isString = key.isString();
+    if (key.isString()) {
+      c.size = static_cast<std::uint32_t>(key.length());
+      if (key.length() <= Cell::inlineKeyCapacity)
+        std::memcpy(c.chars, key.chars(), key.length());
+    } else
+      c.integer = key.integerValue();
+    c.instance.store(s->get(), std::memory_order_relaxed);
+    c.slot.store(s, std::memory_order_release);
+    return c;
+  }
+
+  static Cell *cellOf(Index &index, KeyedSlot<T> *s) {
+    for (std::size_t i = s->key().hash() & index.mask;;
+         i = (i + 1) & index.mask) {
+      KeyedSlot<T> *found = index.cells[i].slot.load(std::memory_order_relaxed);
+      if (found == s)
+        return &index.cells[i];
+      if (found == nullptr)
+        return nullptr;
+    }
+  }
+
+  static Cell *allocateCells(std::size_t size) {
+    // operator new does not respect the alignment before c++17
+    auto raw = reinterpret_cast<std::uintptr_t>(
+        ::operator new(size * sizeof(Cell) + alignof(Cell)));
+    auto aligned =
+        (raw + alignof(Cell) - 1) & ~std::uintptr_t(alignof(Cell) - 1);
+    Cell *cells = reinterpret_cast<Cell *>(aligned);
+    for (std::size_t i = 0; i < size; ++i)
+      new (&cells[i]) Cell();
+    return cells;
+  }
+
+  Index *grow(Index *old) {
+    const std::size_t size = old == nullptr ? 8 : 2 * (old->mask + 1);
+    Index *index = new Index{size - 1, allocateCells(size), old};
+    if (old != nullptr)
+      for (std::size_t i = 0; i <= old->mask; ++i) {
+        KeyedSlot<T> *s = old->cells[i].slot.load(std::memory_order_relaxed);
+        if (s != nullptr)
+          insert(*index, s);
+      }
+    current.store(index, std::memory_order_release);
+    return index;
+  }
+
+  KeyedSlots(KeyedSlots const &) = delete;
+  KeyedSlots &operator=(KeyedSlots const &) = delete;
+
+  std::atomic<Index *> current;
+  std::size_t count;
+  SpinLock lock;
+};
+
+template <typename T> KeyedSlots<T> &keyedSlots() {
+#ifdef GLOBAL_NO_HEAP
+  static_assert(
+      sizeof(T) == 0,
+      "GLOBAL_NO_HEAP: keyed instances allocate their slots and index");
+#endif
+  return constantStaticValue<KeyedSlots<T>>();
+}
+
+// returned by instance<T>(key), looks the key up once on construction
+template <typename T> class KeyedInstancePointer {
+
+public:
+  explicit KeyedInstancePointer(InstanceKey const &k)
+      : key(k), cell(keyedSlots<T>().find(k)) {
+    if (cell == nullptr && k.isString())
+      keyCopy.assign(k.chars(),
+                     k.length()); // the characters of k might be gone before
+                                  // the slot is created
+  }
+
+  operator bool() const { return get() != nullptr; }
+
+  bool operator==(T const *t) const { return get() == t; }
+  bool operator!=(T const *t) const { return get() != t; }
+
+  explicit operator T *() const { return operator->(); }
+
+  T &operator*() const { return *operator->(); }
+  T *operator->() const {
+    T *t = get();
+    if (t == nullptr)
+      global::onNullPtrAccess<>();
+    return t;
+  }
+
+  template <typename Func> void ifAvailable(Func func) {
+    createdSlot().ifAvailable(std::move(func));
+  }
+
+  template <typename Func> void becomesUnavailable(Func func) {
+    createdSlot().becomesUnavailable(std::move(func));
+  }
+
+private:
+  T *get() const {
+    return cell != nullptr ? cell->instance.load(std::memory_order_acquire)
+                           : nullptr;
+  }
+
+  // the slot holds the deferred calls of a key not registered yet
+  KeyedSlot<T> &createdSlot() {
+    if (cell == nullptr)
+      cell = &keyedSlots<T>().findOrCreate(key.isString() ? InstanceKey(keyCopy)
+                                                          : key);
+    return *cell->slot.load(std::memory_order_acquire);
+  }
+
+  InstanceKey key; // the characters of a string key are only read through
+                   // keyCopy
+  std::string keyCopy;
+  typename KeyedSlots<T>::Cell const *cell;
+};
+
+} // namespace detail
+// the instance registered as KeyedInstance<T> for key, deferred calls behave
+// like the ones of instance<T>()
+template <typename T>
+detail::KeyedInstancePointer<T> instance(InstanceKey const &key) {
+  return detail::KeyedInstancePointer<T>(key);
+}
+// constructs an instance of InstanceType and registers it for the key, more
+// than one instance per key is an error
+template <typename AccessType, typename InstanceType = AccessType>
+class KeyedInstance {
+
+public:
+  template <typename... Args>
+  explicit KeyedInstance(InstanceKey const &key, Args &&...args)
+      : t(std::forward<Args>(args)...),
+        reg(detail::keyedSlots<AccessType>().findOrCreate(key).slot.load(
+                std::memory_order_acquire),
+            &t) {}
+
+private:
+  struct Registration {
+    Registration(detail::KeyedSlot<AccessType> *s, AccessType *t) : slot(s) {
+      slot->registerInstance(t);
+    }
+    ~Registration() { slot->deregisterInstance(); }
+    detail::KeyedSlot<AccessType> *slot;
+  };
+
+  KeyedInstance(KeyedInstance const &) = delete;
+  KeyedInstance &operator=(KeyedInstance const &) = delete;
+
+  InstanceType t;
+  Registration reg;
+};
+
+namespace detail {
+
+// configured cpus, so cpus which are offline or not in the affinity mask yet
+// get a replica as well
+inline std::size_t possibleCpuCount() {
+#ifdef __linux__
+  const long n = sysconf(_SC_NPROCESSORS_CONF);
+  if (n > 0)
+    return static_cast<std::size_t>(n);
+#endif
+  return std::thread::hardware_concurrency();
+}
+
+// used if the cpu cannot be queried, spreads the threads over the replicas
+inline std::size_t threadIndex() {
+  static std::atomic<std::size_t> next{0};
+  thread_local std::size_t index = next.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+// glibc reads it from the rseq area registered for each thread if available
+inline std::size_t currentCpu() {
+#ifdef __linux__
+  const int cpu = sched_getcpu();
+  if (cpu >= 0)
+    return static_cast<std::size_t>(cpu);
+#endif
+  return threadIndex();
+}
+
+// number of replicas, set before the first PerCpuInstance is registered
+inline std::size_t cpuCount() {
+  Cpus &c = cpus();
+  std::size_t n = c.count.load(std::memory_order_acquire);
+  if (n != 0)
+    return n;
+  n = possibleCpuCount();
+  if (n == 0)
+    n = 1;
+  c.current.store(&currentCpu, std::memory_order_relaxed);
+  c.count.store(n, std::memory_order_release); // publishes current as well
+  return n;
+}
+
+template <typename T> struct PerCpuReplicas {
+
+  // replica of cpu 0, the others follow at the distance of a Replica<T>
+  static T *first() {
+    return static_cast<T *>(
+        instance<T>().instancePtr.load(std::memory_order_acquire));
+  }
+};
+
+} // namespace detail
+// constructs one replica of T per cpu and registers them, instance<T>() then
+// returns the replica of the calling cpu; needs PerCpuAccess<T> to be
+// specialized
+template <typename T> class PerCpuInstance {
+
+  static_assert(PerCpuAccess<T>::value,
+                "per cpu instances need to be allowed by specializing "
+                "global::PerCpuAccess<T>");
+  static_assert(!ThreadLocalAccess<T>::value,
+                "a type cannot be accessed both thread local and per cpu");
+
+public:
+  // each replica is constructed from the same arguments
+  template <typename... Args> explicit PerCpuInstance(Args const &...args) {
+    for (std::size_t i = 0; i < replicas.size; ++i) {
+      new (replicas.at(i)) detail::Replica<T>(args...);
+      ++replicas.constructed;
+    }
+    reg.registerInstance(&replicas.at(0)->value);
+  }
+
+  std::size_t size() const { return replicas.size; }
+
+private:
+  // operator new does not respect the alignment before c++17
+  struct Replicas {
+    using ReplicaType = detail::Replica<T>;
+
+    Replicas()
+        : size(detail::cpuCount()),
+          memory(::operator new(size * sizeof(detail::Replica<T>) +
+                                alignof(detail::Replica<T>))) {}
+
+    ~Replicas() {
+      for (std::size_t i = 0; i < constructed; ++i)
+        at(i)->~ReplicaType();
+      ::operator delete(memory);
+    }
+
+    detail::Replica<T> *at(std::size_t i) {
+      auto aligned = (reinterpret_cast<std::uintptr_t>(memory) +
+                      alignof(detail::Replica<T>) - 1) &
+                     ~std::uintptr_t(alignof(detail::Replica<T>) - 1);
+      return reinterpret_cast<detail::Replica<T> *>(aligned) + i;
+    }
+
+    std::size_t size;
+    void *memory;
+    std::size_t constructed = 0;
+  };
+
+  PerCpuInstance(PerCpuInstance const &) = delete;
+  PerCpuInstance &operator=(PerCpuInstance const &) = delete;
+
+  Replicas replicas;
+  detail::InstanceRegistration<T>
+      reg; // deregisters before the replicas are destructed
+};
+// calls f(T&) for every replica of the registered PerCpuInstance<T>, if any
+template <typename T, typename Func> void forEachReplica(Func f) {
+  T *first = detail::PerCpuReplicas<T>::first();
+  if (first == nullptr)
+    return;
+  for (std::size_t i = 0, n = detail::cpuCount(); i < n; ++i)
+    f(*detail::replica(first, i));
+}
+// combines the replicas of the registered PerCpuInstance<T> by result =
+// f(result, replica), starting with init
+template <typename T, typename R, typename Func> R reduce(R init, Func f) {
+  forEachReplica<T>([&init, &f](T &t) { init = f(std::move(init), t); });
+  return init;
+}
+
+// executes tasks on a fixed number of threads, the destructor
+// waits for all queued tasks to be finished
+class ThreadPool {
+
+public:
+  explicit ThreadPool(unsigned threadCount = defaultThreadCount()) {
+    if (threadCount == 0)
+      threadCount = 1;
+    for (unsigned i = 0; i < threadCount; ++i)
+      threads.emplace_back([this] { work(); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    for (auto &t : threads)
+      t.join();
+  }
+
+  template <typename Func> void execute(Func &&func) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.emplace_back(bindTestContext(std::forward<Func>(func)));
+    }
+    condition.notify_one();
+  }
+
+  std::size_t threadCount() const { return threads.size(); }
+
+  static unsigned defaultThreadCount() {
+    return std::thread::hardware_concurrency();
+  }
+
+private:
+  void work() {
+    for (;;) {
+      Task task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+          return; // stopping
+        task = std::move(tasks.front());
+        tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  ThreadPool(ThreadPool const &) = delete;
+  ThreadPool &operator=(ThreadPool const &) = delete;
+
+  using Task = detail::SmallFunction<void()>;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<Task> tasks;
+  bool stopping = false;
+  std::vector<std::thread> threads;
+};
+
+template <typename... AccessTypes> struct DependsOn {};
+class CyclicDependency : public std::exception {};
+class UnresolvedDependency : public std::exception {};
+// destruction time of one instance during a parallel shutdown
+struct ShutdownTime {
+  TypeName name;
+  std::chrono::nanoseconds duration;
+  bool deadlineExceeded;
+};
+struct ShutdownReport {
+  std::vector<ShutdownTime> instances; // longest destruction first
+  std::chrono::nanoseconds total{0};
+
+  bool deadlineExceeded() const {
+    for (auto const &i : instances)
+      if (i.deadlineExceeded)
+        return true;
+    return false;
+  }
+};
+// writes one line "<duration in us> <type name>" per instance, marked if its
+// deadline was exceeded
+template <typename Stream>
+void writeShutdownReport(Stream &out, ShutdownReport const &report) {
+  for (auto const &i : report.instances) {
+    out << std::chrono::duration_cast<std::chrono::microseconds>(i.duration)
+               .count()
+        << ' ';
+    out.write(i.name.data, static_cast<std::ptrdiff_t>(i.name.size));
+    if (i.deadlineExceeded)
+      out << " deadline exceeded";
+    out << '\n';
+  }
+}
+namespace detail {
+
+template <typename Registered> struct RegisteredAccessType;
+
+template <template <typename> class RegistrationType, typename AccessType,
+          typename InstanceType>
+struct RegisteredAccessType<
+    RegisterdInstanceT<RegistrationType, AccessType, InstanceType>> {
+  using type = AccessType;
+};
+
+// identifies an access type by the address of its instance pointer
+struct StartupDependency {
+  void const *key;
+  bool (*registered)();
+  TypeName (*name)();
+};
+
+template <typename T> bool isRegistered() {
+  return static_cast<bool>(instance<T>());
+}
+
+template <typename T> StartupDependency startupDependency() {
+  return StartupDependency{&instance<T>(), &isRegistered<T>, &typeName<T>};
+}
+
+template <typename... AccessTypes>
+std::vector<StartupDependency> startupDependencies(DependsOn<AccessTypes...>) {
+  return {startupDependency<AccessTypes>()...};
+}
+
+template <typename Registered, typename... Args> struct StartupConstruction {
+
+  std::tuple<Args...> args;
+
+  std::shared_ptr<void> operator()() {
+    return construct(typename MakeIndexSequence<sizeof...(Args)>::type{});
+  }
+
+  template <std::size_t... I>
+  std::shared_ptr<void> construct(IndexSequence<I...>) {
+    return std::make_shared<Registered>(argument(std::get<I>(args))...);
+  }
+
+  // copies are passed so the arguments are still there if construction throws
+  // and run() is called again, arguments which cannot be copied are moved
+  template <typename A>
+  static typename std::enable_if<std::is_copy_constructible<A>::value, A>::type
+  argument(A &a) {
+    return a;
+  }
+
+  template <typename A>
+  static
+      typename std::enable_if<!std::is_copy_constructible<A>::value, A &&>::type
+      argument(A &a) {
+    return std::move(a);
+  }
+};
+
+struct StartupNode {
+  StartupDependency provides;
+  std::vector<StartupDependency> dependencies;
+  SmallFunction<std::shared_ptr<void>()> construct;
+
+  std::shared_ptr<void> instance;
+  std::vector<std::size_t> dependents;
+  std::size_t missing = 0;
+};
+
+} // namespace detail
+// constructs registered instances concurrently, each one as soon as the
+// instances it depends on are registered; destructs them in the reverse order
+// of their construction or concurrently, each one as soon as the instances
+// depending on it are destructed
+class Startup {
+
+public:
+  explicit Startup() {}
+
+  ~Startup() { shutdown(); }
+
+  // eg. add<Instance<B>, DependsOn<A>>(args...)
+  template <typename Registered, typename Dependencies = DependsOn<>,
+            typename... Args>
+  void add(Args &&...args) {
+    using AccessType = typename detail::RegisteredAccessType<Registered>::type;
+    using Construction =
+        detail::StartupConstruction<Registered,
+                                    typename std::decay<Args>::type...>;
+
+    detail::StartupNode node;
+    node.provides = detail::startupDependency<AccessType>();
+    node.dependencies = detail::startupDependencies(Dependencies{});
+    node.construct =
+        Construction{std::tuple<typename std::decay<Args>::type...>(
+            std::forward<Args>(args)...)};
+    nodes.push_back(std::move(node));
+  }
+
+  // returns after all added instances are constructed
+  void run(unsigned threadCount = ThreadPool::defaultThreadCount()) {
+
+    const std::size_t pending = resolve();
+    if (pending == 0)
+      return;
+
+    State state;
+    ThreadPool pool(threadCount);
+    {
+      std::unique_lock<std::mutex> lock(state.mutex);
+      for (std::size_t i = 0; i < nodes.size(); ++i)
+        if (!nodes[i].instance && nodes[i].missing == 0)
+          schedule(i, pool, state);
+
+      state.idle.wait(lock, [&state] { return state.running == 0; });
+    }
+
+#ifndef EXCEPTIONS_DISABLED
+    if (state.error)
+      std::rethrow_exception(state.error);
+#endif
+  }
+
+  // destructs the instances in the reverse order of their construction and
+  // removes all added ones
+  void shutdown() {
+    for (auto i = constructionOrder.rbegin(); i != constructionOrder.rend();
+         ++i)
+      nodes[*i].instance.reset();
+    constructionOrder.clear();
+    nodes.clear();
+  }
+
+  // destructs the instances concurrently, each one after all constructed
+  // instances depending on it, and removes all added ones; returns the time
+  // each destruction took, which also includes the deregistration and the
+  // becomesUnavailable calls executed on the threads of the pool
+  ShutdownReport shutdown(
+      unsigned threadCount,
+      std::chrono::nanoseconds deadline = std::chrono::nanoseconds::max()) {
+
+    const auto begin = std::chrono::steady_clock::now();
+    ShutdownState state;
+    state.deadline = deadline;
+    if (!constructionOrder.empty()) {
+
+      for (auto &n : nodes)
+        n.missing = 0;
+      for (std::size_t i : constructionOrder)
+        forEachConstructedProvider(
+            i, [this](std::size_t p) { ++nodes[p].missing; });
+
+      ThreadPool pool(threadCount);
+      {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        for (std::size_t i : constructionOrder)
+          if (nodes[i].missing == 0)
+            scheduleDestruction(i, pool, state);
+
+        state.idle.wait(lock, [&state] { return state.running == 0; });
+      }
+    }
+
+    constructionOrder.clear();
+    nodes.clear();
+
+    ShutdownReport &report = state.report;
+    std::sort(report.instances.begin(), report.instances.end(),
+              [](ShutdownTime const &a, ShutdownTime const &b) {
+                return a.duration > b.duration;
+              });
+    report.total = std::chrono::steady_clock::now() - begin;
+    return std::move(report);
+  }
+
+private:
+  struct State {
+    std::mutex mutex;
+    std::condition_variable idle;
+    std::size_t running = 0;
+#ifndef EXCEPTIONS_DISABLED
+    std::exception_ptr error;
+#endif
+  };
+
+  struct ShutdownState : State {
+    std::chrono::nanoseconds deadline;
+    ShutdownReport report;
+  };
+
+  // links the unconstructed nodes, returns their count
+  std::size_t resolve() {
+
+    std::vector<std::size_t> unconstructed;
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      nodes[i].dependents.clear();
+      nodes[i].missing = 0;
+      if (!nodes[i].instance)
+        unconstructed.push_back(i);
+    }
+
+    for (std::size_t i : unconstructed) {
+      for (auto const &d : nodes[i].dependencies) {
+        const std::size_t provider = providerOf(d.key);
+        if (provider != nodes.size() && !nodes[provider].instance) {
+          nodes[provider].dependents.push_back(i);
+          ++nodes[i].missing;
+        } else if (provider == nodes.size() && !d.registered())
+          detail::throwImpl(UnresolvedDependency{});
+      }
+    }
+
+    if (hasCycle(unconstructed))
+      detail::throwImpl(CyclicDependency{});
+    return unconstructed.size();
+  }
+
+  std::size_t providerOf(void const *key) const {
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+      if (nodes[i].provides.key == key)
+        return i;
+    return nodes.size();
+  }
+
+  bool hasCycle(std::vector<std::size_t> const &unconstructed) const {
+    std::vector<std::size_t> missing(nodes.size());
+    std::vector<std::size_t> ready;
+    for (std::size_t i : unconstructed) {
+      missing[i] = nodes[i].missing;
+      if (missing[i] == 0)
+        ready.push_back(i);
+    }
+
+    std::size_t visited = 0;
+    while (!ready.empty()) {
+      const std::size_t i = ready.back();
+      ready.pop_back();
+      ++visited;
+      for (std::size_t d : nodes[i].dependents)
+        if (--missing[d] == 0)
+          ready.push_back(d);
+    }
+    return visited != unconstructed.size();
+  }
+
+  // expects state.mutex to be locked
+  void schedule(std::size_t i, ThreadPool &pool, State &state) {
+    ++state.running;
+    pool.execute([this, i, &pool, &state] { construct(i, pool, state); });
+  }
+
+  void construct(std::size_t i, ThreadPool &pool, State &state) {
+
+    std::shared_ptr<void> instance;
+#ifndef EXCEPTIONS_DISABLED
+    std::exception_ptr error;
+    try {
+      instance = nodes[i].construct();
+    } catch (...) {
+      error = std::current_exception();
+    }
+#else
+    instance = nodes[i].construct();
+#endif
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    --state.running;
+
+#ifndef EXCEPTIONS_DISABLED
+    if (error && !state.error)
+      state.error = error;
+    if (state.error) {
+      if (instance)
+        finished(i, std::move(instance));
+      state.idle.notify_all();
+      return;
+    }
+#endif
+
+    finished(i, std::move(instance));
+    for (std::size_t d : nodes[i].dependents)
+      if (--nodes[d].missing == 0)
+        schedule(d, pool, state);
+    if (state.running == 0)
+      state.idle.notify_all();
+  }
+
+  // calls f(provider) for the constructed nodes node i depends on
+  template <typename Func>
+  void forEachConstructedProvider(std::size_t i, Func f) {
+    for (auto const &d : nodes[i].dependencies) {
+      const std::size_t provider = providerOf(d.key);
+      if (provider != nodes.size() && nodes[provider].instance)
+        f(provider);
+    }
+  }
+
+  // expects state.mutex to be locked
+  void scheduleDestruction(std::size_t i, ThreadPool &pool,
+                           ShutdownState &state) {
+    ++state.running;
+    pool.execute([this, i, &pool, &state] { destruct(i, pool, state); });
+  }
+
+  void destruct(std::size_t i, ThreadPool &pool, ShutdownState &state) {
+
+    std::shared_ptr<void> instance;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      instance.swap(nodes[i].instance);
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    instance.reset(); // deregisters before destructing
+    const std::chrono::nanoseconds duration =
+        std::chrono::steady_clock::now() - begin;
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    --state.running;
+    state.report.instances.push_back(ShutdownTime{
+        nodes[i].provides.name(), duration, duration > state.deadline});
+
+    forEachConstructedProvider(i, [&](std::size_t p) {
+      if (--nodes[p].missing == 0)
+        scheduleDestruction(p, pool, state);
+    });
+    if (state.running == 0)
+      state.idle.notify_all();
+  }
+
+  void finished(std::size_t i, std::shared_ptr<void> instance) {
+    nodes[i].instance = std::move(instance);
+    constructionOrder.push_back(i);
+  }
+
+  Startup(Startup const &) = delete;
+  Startup &operator=(Startup const &) = delete;
+
+  std::vector<detail::StartupNode> nodes;
+  std::vector<std::size_t> constructionOrder;
+};
 
 } // namespace global